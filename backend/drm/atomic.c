@@ -1,5 +1,7 @@
+#include <errno.h>
 #include <gbm.h>
 #include <stdlib.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -32,9 +34,14 @@ static bool atomic_commit(struct atomic *atom,
 
 	int ret = drmModeAtomicCommit(drm->fd, atom->req, flags, drm);
 	if (ret) {
-		wlr_drm_conn_log_errno(conn, WLR_ERROR, "Atomic %s failed (%s)",
+		int err = errno;
+		// Test failures are expected, e.g. when probing overlay planes
+		enum wlr_log_importance verbosity =
+			(flags & DRM_MODE_ATOMIC_TEST_ONLY) ? WLR_DEBUG : WLR_ERROR;
+		wlr_drm_conn_log_errno(conn, verbosity, "Atomic %s failed (%s)",
 			(flags & DRM_MODE_ATOMIC_TEST_ONLY) ? "test" : "commit",
 			(flags & DRM_MODE_ATOMIC_ALLOW_MODESET) ? "modeset" : "pageflip");
+		errno = err; // callers may check why the commit failed
 		return false;
 	}
 
@@ -153,6 +160,11 @@ static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
 	atomic_add(atom, id, props->crtc_id, crtc_id);
 	atomic_add(atom, id, props->crtc_x, (uint64_t)x);
 	atomic_add(atom, id, props->crtc_y, (uint64_t)y);
+	if (props->in_fence_fd != 0 && plane->pending_fb != NULL &&
+			plane->pending_in_fence_fd >= 0) {
+		atomic_add(atom, id, props->in_fence_fd,
+			(uint64_t)plane->pending_in_fence_fd);
+	}
 
 	return;
 
@@ -161,11 +173,53 @@ error:
 	atom->failed = true;
 }
 
+static void set_overlay_planes(struct atomic *atom,
+		struct wlr_drm_backend *drm, struct wlr_drm_connector *conn) {
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->pending_layer != NULL) {
+			set_plane_props(atom, drm, plane, conn->crtc->id,
+				plane->pending_layer->x, plane->pending_layer->y);
+		} else if (drm_connector_overlay_needs_disable(conn, plane)) {
+			plane_disable(atom, plane);
+		}
+	}
+}
+
+/**
+ * Async page-flips only change the primary plane's FB: drivers reject any
+ * other property, even if its value is unchanged. Without an IN_FENCE_FD, KMS
+ * relies on implicit synchronization to wait for rendering.
+ */
+static bool atomic_crtc_async_page_flip(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, uint32_t flags) {
+	struct wlr_drm_plane *plane = conn->crtc->primary;
+	struct wlr_drm_fb *fb = plane_get_next_fb(plane);
+	if (fb == NULL) {
+		wlr_log(WLR_ERROR, "Failed to acquire FB");
+		return false;
+	}
+
+	struct atomic atom;
+	atomic_begin(&atom);
+	atomic_add(&atom, plane->id, plane->props.fb_id, fb->id);
+
+	bool ok = atomic_commit(&atom, conn, flags | DRM_MODE_ATOMIC_NONBLOCK);
+	int err = errno;
+	atomic_finish(&atom);
+	errno = err;
+	return ok;
+}
+
 static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn, uint32_t flags) {
 	struct wlr_output *output = &conn->output;
 	struct wlr_drm_crtc *crtc = conn->crtc;
 
+	if (flags & DRM_MODE_PAGE_FLIP_ASYNC) {
+		return atomic_crtc_async_page_flip(drm, conn, flags);
+	}
+
 	uint32_t mode_id = crtc->mode_id;
 	if (crtc->pending_modeset) {
 		if (!create_mode_blob(drm, crtc, &mode_id)) {
@@ -177,9 +231,11 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 	if (output->pending.committed & WLR_OUTPUT_STATE_GAMMA_LUT) {
 		// Fallback to legacy gamma interface when gamma properties are not
 		// available (can happen on older Intel GPUs that support gamma but not
-		// degamma).
+		// degamma). The legacy interface can't be tested, so tests don't
+		// touch it.
 		if (crtc->props.gamma_lut == 0) {
-			if (!drm_legacy_crtc_set_gamma(drm, crtc,
+			if (!(flags & DRM_MODE_ATOMIC_TEST_ONLY) &&
+					!drm_legacy_crtc_set_gamma(drm, crtc,
 					output->pending.gamma_lut_size,
 					output->pending.gamma_lut)) {
 				return false;
@@ -204,10 +260,6 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
 	} else {
 		flags |= DRM_MODE_ATOMIC_NONBLOCK;
-		// AMS immediately rejects the commit if DRM_MODE_PAGE_FLIP_ASYNC is used..
-		//if (conn->output.present_mode == WLR_OUTPUT_PRESENT_MODE_IMMEDIATE) {
-		//	flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-		//}
 	}
 
 	struct atomic atom;
@@ -235,6 +287,7 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 			plane_disable(&atom, crtc->cursor);
 		}
 	}
+	set_overlay_planes(&atom, drm, conn);
 
 	bool ok = atomic_commit(&atom, conn, flags);
 	atomic_finish(&atom);
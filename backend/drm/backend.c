@@ -46,6 +46,10 @@ static void backend_destroy(struct wlr_backend *backend) {
 	wl_list_for_each_safe(fb, fb_tmp, &drm->fbs, link) {
 		drm_fb_destroy(fb);
 	}
+	if (drm->dead_fbs_idle != NULL) {
+		wl_event_source_remove(drm->dead_fbs_idle);
+	}
+	drm_fb_destroy_dead(drm);
 
 	wl_list_remove(&drm->display_destroy.link);
 	wl_list_remove(&drm->session_destroy.link);
@@ -99,6 +103,12 @@ bool wlr_backend_is_drm(struct wlr_backend *b) {
 	return b->impl == &backend_impl;
 }
 
+void wlr_drm_backend_get_fb_cache_stats(struct wlr_backend *backend,
+		struct wlr_drm_fb_cache_stats *stats) {
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(backend);
+	*stats = drm->fb_cache_stats;
+}
+
 static void handle_session_active(struct wl_listener *listener, void *data) {
 	struct wlr_drm_backend *drm =
 		wl_container_of(listener, drm, session_active);
@@ -164,6 +174,10 @@ struct wlr_backend *wlr_drm_backend_create(struct wl_display *display,
 
 	drm->session = session;
 	wl_list_init(&drm->fbs);
+	wl_list_init(&drm->dead_fbs);
+	for (size_t i = 0; i < WLR_DRM_FB_CACHE_BUCKETS; i++) {
+		wl_list_init(&drm->fb_buckets[i]);
+	}
 	wl_list_init(&drm->outputs);
 
 	drm->dev = dev;
@@ -11,12 +11,14 @@
 #include <string.h>
 #include <strings.h>
 #include <time.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/backend/interface.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -26,6 +28,12 @@
 #include "backend/drm/util.h"
 #include "render/swapchain.h"
 #include "util/signal.h"
+#include "util/time.h"
+
+// Only defined in recent libdrm releases
+#ifndef DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP
+#define DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP 0x15
+#endif
 
 bool check_drm_features(struct wlr_drm_backend *drm) {
 	uint64_t cap;
@@ -82,24 +90,23 @@ bool check_drm_features(struct wlr_drm_backend *drm) {
 			drm->addfb2_modifiers ? "supported" : "unsupported");
 	}
 
+	if (drm->iface == &atomic_iface) {
+		ret = drmGetCap(drm->fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap);
+		drm->atomic_async_page_flip = ret == 0 && cap == 1;
+		wlr_log(WLR_DEBUG, "Atomic async page-flips %s",
+			drm->atomic_async_page_flip ? "supported" : "unsupported");
+	}
+
 	return true;
 }
 
-static bool add_plane(struct wlr_drm_backend *drm,
-		struct wlr_drm_crtc *crtc, const drmModePlane *drm_plane,
+static bool init_plane(struct wlr_drm_backend *drm,
+		struct wlr_drm_plane *p, const drmModePlane *drm_plane,
 		uint32_t type, union wlr_drm_plane_props *props) {
-	assert(!(type == DRM_PLANE_TYPE_PRIMARY && crtc->primary));
-	assert(!(type == DRM_PLANE_TYPE_CURSOR && crtc->cursor));
-
-	struct wlr_drm_plane *p = calloc(1, sizeof(*p));
-	if (!p) {
-		wlr_log_errno(WLR_ERROR, "Allocation failed");
-		return false;
-	}
-
 	p->type = type;
 	p->id = drm_plane->plane_id;
 	p->props = *props;
+	p->pending_in_fence_fd = -1;
 
 	for (size_t j = 0; j < drm_plane->count_formats; ++j) {
 		wlr_drm_format_set_add(&p->formats, drm_plane->formats[j],
@@ -142,6 +149,30 @@ static bool add_plane(struct wlr_drm_backend *drm,
 		}
 	}
 
+	return true;
+
+error:
+	wlr_drm_format_set_finish(&p->formats);
+	return false;
+}
+
+static bool add_plane(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc, const drmModePlane *drm_plane,
+		uint32_t type, union wlr_drm_plane_props *props) {
+	assert(!(type == DRM_PLANE_TYPE_PRIMARY && crtc->primary));
+	assert(!(type == DRM_PLANE_TYPE_CURSOR && crtc->cursor));
+
+	struct wlr_drm_plane *p = calloc(1, sizeof(*p));
+	if (!p) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	if (!init_plane(drm, p, drm_plane, type, props)) {
+		free(p);
+		return false;
+	}
+
 	switch (type) {
 	case DRM_PLANE_TYPE_PRIMARY:
 		crtc->primary = p;
@@ -154,10 +185,35 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	}
 
 	return true;
+}
 
-error:
-	free(p);
-	return false;
+static bool add_overlay_plane(struct wlr_drm_backend *drm,
+		const drmModePlane *drm_plane, union wlr_drm_plane_props *props) {
+	struct wlr_drm_plane *p = &drm->overlays[drm->num_overlays];
+	if (!init_plane(drm, p, drm_plane, DRM_PLANE_TYPE_OVERLAY, props)) {
+		return false;
+	}
+
+	p->possible_crtcs = drm_plane->possible_crtcs;
+
+	// Without a zpos property, assume overlays are stacked in the order the
+	// kernel enumerates them
+	p->zpos = drm->num_overlays;
+	if (p->props.zpos != 0 &&
+			!get_drm_prop(drm->fd, p->id, p->props.zpos, &p->zpos)) {
+		wlr_log(WLR_ERROR, "Failed to read zpos property");
+	}
+
+	drm->num_overlays++;
+	return true;
+}
+
+static int cmp_overlay_zpos(const void *arg1, const void *arg2) {
+	const struct wlr_drm_plane *p1 = arg1, *p2 = arg2;
+	if (p1->zpos != p2->zpos) {
+		return p1->zpos < p2->zpos ? -1 : 1;
+	}
+	return p1->id < p2->id ? -1 : (p1->id > p2->id);
 }
 
 static bool init_planes(struct wlr_drm_backend *drm) {
@@ -169,6 +225,15 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 
 	wlr_log(WLR_INFO, "Found %"PRIu32" DRM planes", plane_res->count_planes);
 
+	if (plane_res->count_planes > 0) {
+		drm->overlays = calloc(plane_res->count_planes,
+			sizeof(*drm->overlays));
+		if (!drm->overlays) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			goto error;
+		}
+	}
+
 	for (uint32_t i = 0; i < plane_res->count_planes; ++i) {
 		uint32_t id = plane_res->planes[i];
 
@@ -190,10 +255,14 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 			goto error;
 		}
 
-		// We don't really care about overlay planes, as we don't support them
-		// yet.
+		// Overlay planes aren't bound to a CRTC: they're handed out to
+		// output layers on demand
 		if (type == DRM_PLANE_TYPE_OVERLAY) {
+			bool ok = add_overlay_plane(drm, plane, &props);
 			drmModeFreePlane(plane);
+			if (!ok) {
+				goto error;
+			}
 			continue;
 		}
 
@@ -225,10 +294,23 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 		drmModeFreePlane(plane);
 	}
 
+	qsort(drm->overlays, drm->num_overlays, sizeof(*drm->overlays),
+		cmp_overlay_zpos);
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		wl_list_init(&drm->overlays[i].layer_destroy.link);
+	}
+	wlr_log(WLR_INFO, "Found %zu DRM overlay planes", drm->num_overlays);
+
 	drmModeFreePlaneResources(plane_res);
 	return true;
 
 error:
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		wlr_drm_format_set_finish(&drm->overlays[i].formats);
+	}
+	free(drm->overlays);
+	drm->overlays = NULL;
+	drm->num_overlays = 0;
 	drmModeFreePlaneResources(plane_res);
 	return false;
 }
@@ -303,6 +385,13 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 		}
 	}
 
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		wl_list_remove(&plane->layer_destroy.link);
+		wlr_drm_format_set_finish(&plane->formats);
+	}
+	free(drm->overlays);
+
 	free(drm->crtcs);
 }
 
@@ -318,8 +407,195 @@ static bool drm_connector_attach_render(struct wlr_output *output,
 	return drm_surface_make_current(&conn->crtc->primary->surf, buffer_age);
 }
 
+static void overlay_plane_handle_layer_destroy(struct wl_listener *listener,
+	void *data);
+
+static void overlay_plane_set_layer(struct wlr_drm_plane *plane,
+		struct wlr_output_layer *layer) {
+	wl_list_remove(&plane->layer_destroy.link);
+	wl_list_init(&plane->layer_destroy.link);
+	plane->layer = layer;
+	if (layer != NULL) {
+		plane->layer_destroy.notify = overlay_plane_handle_layer_destroy;
+		wl_signal_add(&layer->events.destroy, &plane->layer_destroy);
+	}
+}
+
+static void overlay_plane_handle_layer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_drm_plane *plane =
+		wl_container_of(listener, plane, layer_destroy);
+	// Keep displaying the buffer until the next commit disables the plane
+	overlay_plane_set_layer(plane, NULL);
+}
+
+void drm_overlay_plane_release(struct wlr_drm_plane *plane) {
+	drm_fb_clear(&plane->pending_fb);
+	drm_fb_clear(&plane->queued_fb);
+	drm_fb_clear(&plane->current_fb);
+	overlay_plane_set_layer(plane, NULL);
+	plane->pending_layer = NULL;
+	plane->release_pending = false;
+	plane->crtc = NULL;
+}
+
+static void drm_crtc_release_overlays(struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc) {
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->crtc == crtc) {
+			drm_overlay_plane_release(plane);
+		}
+	}
+}
+
+static void drm_crtc_clear_pending_overlays(struct wlr_drm_backend *drm) {
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->pending_layer != NULL) {
+			drm_fb_clear(&plane->pending_fb);
+			plane->pending_layer = NULL;
+		}
+	}
+}
+
+bool drm_connector_overlay_needs_disable(struct wlr_drm_connector *conn,
+		struct wlr_drm_plane *plane) {
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	if (plane->crtc != crtc || plane->pending_layer != NULL) {
+		return false;
+	}
+	// Planes are left untouched unless the layers are updated, the layer
+	// has been destroyed or the CRTC is disabled
+	return (conn->output.pending.committed & WLR_OUTPUT_STATE_LAYERS) ||
+		plane->layer == NULL || !crtc->pending.active;
+}
+
+static void drm_connector_set_overlays_committed(
+		struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->pending_layer != NULL) {
+			drm_fb_move(&plane->queued_fb, &plane->pending_fb);
+			plane->crtc = conn->crtc;
+			overlay_plane_set_layer(plane, plane->pending_layer->layer);
+			plane->pending_layer = NULL;
+			plane->release_pending = false;
+		} else if (drm_connector_overlay_needs_disable(conn, plane)) {
+			overlay_plane_set_layer(plane, NULL);
+			plane->release_pending = true;
+		}
+	}
+}
+
+static bool overlay_plane_is_available(struct wlr_drm_backend *drm,
+		struct wlr_drm_plane *plane, struct wlr_drm_crtc *crtc) {
+	uint32_t crtc_bit = 1 << (crtc - drm->crtcs);
+	return (plane->possible_crtcs & crtc_bit) &&
+		plane->pending_layer == NULL &&
+		(plane->crtc == NULL || plane->crtc == crtc);
+}
+
+static bool drm_connector_supports_layers(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	// Async page-flips can only update the primary plane
+	return drm->iface == &atomic_iface && drm->num_overlays > 0 &&
+		drm->session->active && crtc != NULL && crtc->pending.active && !crtc->pending_modeset &&
+		conn->output.present_mode == WLR_OUTPUT_PRESENT_MODE_NORMAL;
+}
+
+static bool drm_connector_layers_accepted(struct wlr_drm_connector *conn) {
+	struct wlr_output_state *pending = &conn->output.pending;
+	for (size_t i = 0; i < pending->layers_len; i++) {
+		struct wlr_output_layer_state *layer = &pending->layers[i];
+		if (layer->buffer != NULL && !layer->accepted) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Assign the pending output layers to overlay planes, from top to bottom.
+ *
+ * Overlay planes are stacked above the primary plane: once a layer can't be
+ * put on a plane, it needs to be composited along with all of the layers
+ * below it. When testing, each candidate layer is checked with a TEST_ONLY
+ * commit and marked as accepted on success. When committing, only the layers
+ * accepted by the last test are assigned.
+ *
+ * The assignments are stored in the planes' pending_layer.
+ */
+static bool drm_connector_assign_layers(struct wlr_drm_connector *conn,
+		bool test_only) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_crtc *crtc = conn->crtc;
+	struct wlr_output_state *pending = &conn->output.pending;
+
+	size_t plane_idx = drm->num_overlays;
+	for (size_t i = pending->layers_len; i-- > 0;) {
+		struct wlr_output_layer_state *layer = &pending->layers[i];
+		if (layer->buffer == NULL) {
+			continue;
+		}
+		if (test_only) {
+			layer->accepted = false;
+		} else if (!layer->accepted) {
+			continue;
+		}
+
+		// Planes are sorted by zpos: walk them downwards along with the
+		// layers
+		bool assigned = false;
+		while (!assigned && plane_idx > 0) {
+			struct wlr_drm_plane *plane = &drm->overlays[--plane_idx];
+			if (!overlay_plane_is_available(drm, plane, crtc)) {
+				continue;
+			}
+
+			if (!drm_fb_import(&plane->pending_fb, drm, layer->buffer,
+					&plane->formats)) {
+				continue;
+			}
+			plane->pending_layer = layer;
+
+			if (test_only && !drm->iface->crtc_commit(drm, conn,
+					DRM_MODE_ATOMIC_TEST_ONLY)) {
+				drm_fb_clear(&plane->pending_fb);
+				plane->pending_layer = NULL;
+				continue;
+			}
+
+			assigned = true;
+		}
+
+		if (!assigned) {
+			if (!test_only) {
+				wlr_drm_conn_log(conn, WLR_ERROR,
+					"Failed to assign an overlay plane to an accepted layer");
+				return false;
+			}
+			// Everything below needs to be composited
+			break;
+		}
+		layer->accepted = true;
+	}
+
+	return true;
+}
+
+void drm_plane_set_in_fence(struct wlr_drm_plane *plane, int fd) {
+	if (plane->pending_in_fence_fd >= 0) {
+		close(plane->pending_in_fence_fd);
+	}
+	plane->pending_in_fence_fd = fd;
+}
+
 static void drm_plane_set_committed(struct wlr_drm_plane *plane) {
 	drm_fb_move(&plane->queued_fb, &plane->pending_fb);
+	drm_plane_set_in_fence(plane, -1);
 
 	if (plane->queued_fb) {
 		wlr_swapchain_set_buffer_submitted(plane->surf.swapchain,
@@ -327,34 +603,227 @@ static void drm_plane_set_committed(struct wlr_drm_plane *plane) {
 	}
 }
 
+bool drm_connector_wants_async_page_flip(struct wlr_drm_connector *conn) {
+	switch (conn->output.present_mode) {
+	case WLR_OUTPUT_PRESENT_MODE_NORMAL:
+		return false;
+	case WLR_OUTPUT_PRESENT_MODE_IMMEDIATE:
+		return true;
+	case WLR_OUTPUT_PRESENT_MODE_ADAPTIVE:
+		return conn->adaptive_present.tear;
+	}
+	abort(); // unreachable
+}
+
+static int mhz_to_nsec(int mhz) {
+	return 1000000000000LL / mhz;
+}
+
+/**
+ * Decide whether the next page-flip should tear in the adaptive present mode.
+ *
+ * Frames committed before the vblank following the previous page-flip are
+ * displayed in sync. Vblanks are predicted from the last vsynced page-flip,
+ * since torn page-flips don't happen on a vblank. Late frames either wait for
+ * the next vblank or tear, depending on the slack left until that vblank:
+ * waiting a little is cheaper than a tear line, but waiting most of a refresh
+ * period stutters. Clients rendering slower than the refresh rate miss vblanks
+ * regularly, so they tolerate less waiting than clients which just had a
+ * hiccup. This keeps clients hovering around the refresh rate from oscillating
+ * between both. Frames committed more than a refresh period after the
+ * predicted vblank follow an idle period rather than being late.
+ */
+static void drm_connector_update_adaptive_present(
+		struct wlr_drm_connector *conn) {
+	struct wlr_drm_adaptive_present *adaptive = &conn->adaptive_present;
+	adaptive->tear = false;
+	adaptive->late = false;
+
+	if (conn->output.refresh <= 0) {
+		return;
+	}
+	int64_t refresh = mhz_to_nsec(conn->output.refresh);
+
+	struct timespec now_ts;
+	clock_gettime(conn->backend->clock, &now_ts);
+	int64_t now = timespec_to_nsec(&now_ts);
+
+	int64_t last_commit = timespec_to_nsec(&adaptive->last_commit);
+	adaptive->last_commit = now_ts;
+
+	int64_t last_vblank = timespec_to_nsec(&adaptive->last_vblank);
+	int64_t last_present = timespec_to_nsec(&adaptive->last_present);
+	int64_t next_vblank = last_vblank +
+		((last_present - last_vblank) / refresh + 1) * refresh;
+	if (last_vblank != 0 && now - next_vblank > refresh) {
+		// The prediction is stale: start over from the next vsynced
+		// page-flip, and keep the idle period out of the frame interval
+		adaptive->last_vblank = (struct timespec){0};
+		return;
+	}
+
+	if (last_commit != 0) {
+		int64_t interval = now - last_commit;
+		if (adaptive->frame_interval == 0) {
+			adaptive->frame_interval = interval;
+		} else {
+			adaptive->frame_interval +=
+				(interval - adaptive->frame_interval) / 8;
+		}
+	}
+
+	if (last_vblank == 0 || now <= next_vblank) {
+		return;
+	}
+	adaptive->late = true;
+
+	int64_t slack = refresh - (now - last_vblank) % refresh;
+	int64_t max_wait = adaptive->frame_interval > refresh ?
+		refresh / 4 : refresh / 2;
+	adaptive->tear = slack > max_wait;
+}
+
+static void drm_connector_record_adaptive_present(
+		struct wlr_drm_connector *conn) {
+	struct wlr_drm_adaptive_present *adaptive = &conn->adaptive_present;
+	struct wlr_output_adaptive_present_stats *stats =
+		&conn->output.adaptive_present_stats;
+	if (adaptive->tear) {
+		stats->tears++;
+	} else if (adaptive->late) {
+		stats->misses++;
+	} else {
+		stats->hits++;
+	}
+	adaptive->tear = false;
+}
+
+/**
+ * Atomic async page-flips can only change the primary plane's FB.
+ */
+static bool drm_connector_pending_fb_only(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	if (conn->crtc->pending_modeset || (conn->output.pending.committed &
+			(WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
+			WLR_OUTPUT_STATE_GAMMA_LUT))) {
+		return false;
+	}
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->pending_layer != NULL ||
+				drm_connector_overlay_needs_disable(conn, plane)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Check whether the pending state can be committed with an atomic async
+ * page-flip. Drivers may advertise the capability but reject async commits
+ * anyway: only then is the atomic interface given up on for async
+ * page-flips.
+ */
+static bool drm_crtc_test_atomic_async(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	if (!drm_connector_pending_fb_only(conn)) {
+		return false;
+	}
+
+	if (drm->iface->crtc_commit(drm, conn,
+			DRM_MODE_PAGE_FLIP_ASYNC | DRM_MODE_ATOMIC_TEST_ONLY)) {
+		return true;
+	}
+	if (errno == EINVAL) {
+		wlr_drm_conn_log(conn, WLR_INFO, "Atomic async page-flips "
+			"rejected, falling back to legacy interface");
+		drm->atomic_async_page_flip = false;
+	}
+	return false;
+}
+
 static bool drm_crtc_commit(struct wlr_drm_connector *conn, uint32_t flags) {
 	struct wlr_drm_backend *drm = conn->backend;
 	struct wlr_drm_crtc *crtc = conn->crtc;
+	bool async = !crtc->pending_modeset &&
+		drm_connector_wants_async_page_flip(conn);
+	// Async page-flips go through the legacy interface unless the driver
+	// supports them with atomic commits
+	bool legacy = conn->output.present_mode != WLR_OUTPUT_PRESENT_MODE_NORMAL &&
+		(drm->iface != &atomic_iface || !drm->atomic_async_page_flip);
+	if (async && !legacy && !drm_crtc_test_atomic_async(conn)) {
+		// Present this frame in sync, unless the test gave up on atomic
+		// async page-flips
+		legacy = !drm->atomic_async_page_flip;
+		async = legacy;
+	}
 	bool ok;
-	// Use legacy when not using normal present mode since AMS doesn't
-	// allow async pageflips..
-	if (conn->output.present_mode != WLR_OUTPUT_PRESENT_MODE_NORMAL) {
+	if (legacy) {
 		ok = drm_legacy_crtc_commit(drm, conn, flags);
 	} else {
+		if (async) {
+			flags |= DRM_MODE_PAGE_FLIP_ASYNC;
+		}
 		ok = drm->iface->crtc_commit(drm, conn, flags);
 	}
+	if (ok && (flags & DRM_MODE_PAGE_FLIP_EVENT)) {
+		conn->adaptive_present.flip_torn = async;
+	}
 	if (ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
 		memcpy(&crtc->current, &crtc->pending, sizeof(struct wlr_drm_crtc_state));
 		drm_plane_set_committed(crtc->primary);
 		if (crtc->cursor != NULL) {
 			drm_plane_set_committed(crtc->cursor);
 		}
+		drm_connector_set_overlays_committed(conn);
 	} else {
 		memcpy(&crtc->pending, &crtc->current, sizeof(struct wlr_drm_crtc_state));
 		drm_fb_clear(&crtc->primary->pending_fb);
+		drm_plane_set_in_fence(crtc->primary, -1);
 		if (crtc->cursor != NULL) {
 			drm_fb_clear(&crtc->cursor->pending_fb);
+			drm_plane_set_in_fence(crtc->cursor, -1);
 		}
+		drm_crtc_clear_pending_overlays(drm);
 	}
 	crtc->pending_modeset = false;
 	return ok;
 }
 
+/**
+ * On multi-GPU setups, check whether a buffer imported directly from the
+ * parent GPU can be scanned out. If not, fall back to copying it.
+ */
+static bool drm_crtc_test_mgpu_direct(struct wlr_drm_connector *conn) {
+	struct wlr_drm_backend *drm = conn->backend;
+	struct wlr_drm_plane *plane = conn->crtc->primary;
+	if (!plane->mgpu_pending_direct ||
+			plane->mgpu_path == WLR_DRM_MGPU_PATH_DIRECT) {
+		return true;
+	}
+
+	assert(drm->iface == &atomic_iface);
+	if (drm->iface->crtc_commit(drm, conn, DRM_MODE_ATOMIC_TEST_ONLY)) {
+		wlr_drm_conn_log(conn, WLR_DEBUG,
+			"Scanning out parent GPU buffers directly");
+		plane->mgpu_path = WLR_DRM_MGPU_PATH_DIRECT;
+		return true;
+	}
+
+	if (!drm_plane_mgpu_fallback_blit(plane, drm)) {
+		return false;
+	}
+
+	// The test may have failed because of another pending property, e.g. the
+	// mode: only stick to copies if they pass where the direct FB failed
+	if (drm->iface->crtc_commit(drm, conn, DRM_MODE_ATOMIC_TEST_ONLY)) {
+		wlr_drm_conn_log(conn, WLR_DEBUG, "Parent GPU buffers can't be "
+			"scanned out directly, copying across GPUs");
+		plane->mgpu_path = WLR_DRM_MGPU_PATH_BLIT;
+	}
+	return true;
+}
+
 static bool drm_crtc_page_flip(struct wlr_drm_connector *conn) {
 	struct wlr_drm_crtc *crtc = conn->crtc;
 	assert(crtc != NULL);
@@ -371,9 +840,23 @@ static bool drm_crtc_page_flip(struct wlr_drm_connector *conn) {
 
 	assert(crtc->pending.active);
 	assert(plane_get_next_fb(crtc->primary));
+	if (!drm_crtc_test_mgpu_direct(conn)) {
+		return false;
+	}
+	bool adaptive = conn->output.present_mode ==
+		WLR_OUTPUT_PRESENT_MODE_ADAPTIVE && !crtc->pending_modeset;
+	if (adaptive) {
+		drm_connector_update_adaptive_present(conn);
+	}
 	if (!drm_crtc_commit(conn, DRM_MODE_PAGE_FLIP_EVENT)) {
+		conn->adaptive_present.tear = false;
 		return false;
 	}
+	if (adaptive) {
+		// The page-flip may have been presented in sync after all
+		conn->adaptive_present.tear = conn->adaptive_present.flip_torn;
+		drm_connector_record_adaptive_present(conn);
+	}
 
 	conn->pending_page_flip_crtc = crtc->id;
 
@@ -439,8 +922,8 @@ static bool test_buffer(struct wlr_drm_connector *conn,
 	return true;
 }
 
-static bool drm_connector_test(struct wlr_output *output) {
-	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+static bool drm_connector_test_state(struct wlr_drm_connector *conn) {
+	struct wlr_output *output = &conn->output;
 
 	if ((output->pending.committed & WLR_OUTPUT_STATE_ENABLED) &&
 			output->pending.enabled) {
@@ -462,6 +945,31 @@ static bool drm_connector_test(struct wlr_output *output) {
 	return true;
 }
 
+static bool drm_connector_test(struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+
+	if (!drm_connector_test_state(conn)) {
+		return false;
+	}
+
+	if (output->pending.committed & WLR_OUTPUT_STATE_LAYERS) {
+		if (drm_connector_supports_layers(conn)) {
+			drm_connector_assign_layers(conn, true);
+			drm_crtc_clear_pending_overlays(conn->backend);
+		}
+		// Layers which can't be assigned are left to the compositor, which
+		// isn't possible without a new buffer
+		if (!(output->pending.committed & WLR_OUTPUT_STATE_BUFFER) &&
+				!drm_connector_layers_accepted(conn)) {
+			wlr_drm_conn_log(conn, WLR_DEBUG,
+				"Can't composite rejected layers without a buffer");
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static struct wlr_output_mode *drm_connector_get_pending_mode(
 		struct wlr_drm_connector *conn) {
 	struct wlr_output *output = &conn->output;
@@ -507,9 +1015,18 @@ static bool drm_connector_commit_buffer(struct wlr_output *output) {
 				&crtc->primary->formats)) {
 			return false;
 		}
+		plane->mgpu_pending_direct = false;
+		drm_plane_set_in_fence(plane, -1);
 		break;
 	}
 
+	if ((output->pending.committed & WLR_OUTPUT_STATE_LAYERS) &&
+			drm_connector_supports_layers(conn) &&
+			!drm_connector_assign_layers(conn, false)) {
+		drm_crtc_clear_pending_overlays(drm);
+		return false;
+	}
+
 	if (!drm_crtc_page_flip(conn)) {
 		return false;
 	}
@@ -517,6 +1034,37 @@ static bool drm_connector_commit_buffer(struct wlr_output *output) {
 	return true;
 }
 
+static bool drm_connector_commit_layers(struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_backend *drm = conn->backend;
+
+	assert(!(output->pending.committed & WLR_OUTPUT_STATE_BUFFER));
+	if (!drm_connector_layers_accepted(conn)) {
+		wlr_drm_conn_log(conn, WLR_ERROR,
+			"Can't composite rejected layers without a buffer");
+		return false;
+	}
+	if (!drm_connector_supports_layers(conn)) {
+		// No layer needs a plane and none can be on one, only apply the rest
+		// of the state
+		if (output->pending.committed &
+				(WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
+				WLR_OUTPUT_STATE_GAMMA_LUT)) {
+			return drm_crtc_commit(conn, 0);
+		}
+		return true;
+	}
+
+	// Gamma and adaptive sync changes are part of the page-flip
+	if (!drm_connector_assign_layers(conn, false)) {
+		drm_crtc_clear_pending_overlays(drm);
+		return false;
+	}
+
+	// Overlay FBs are only released on page-flip events
+	return drm_crtc_page_flip(conn);
+}
+
 bool drm_connector_supports_vrr(struct wlr_drm_connector *conn) {
 	struct wlr_drm_backend *drm = conn->backend;
 
@@ -547,7 +1095,7 @@ static bool drm_connector_commit(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 	struct wlr_drm_backend *drm = conn->backend;
 
-	if (!drm_connector_test(output)) {
+	if (!drm_connector_test_state(conn)) {
 		return false;
 	}
 
@@ -581,6 +1129,10 @@ static bool drm_connector_commit(struct wlr_output *output) {
 		if (!drm_connector_commit_buffer(output)) {
 			return false;
 		}
+	} else if (output->pending.committed & WLR_OUTPUT_STATE_LAYERS) {
+		if (!drm_connector_commit_layers(output)) {
+			return false;
+		}
 	} else if (output->pending.committed &
 			(WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED |
 			WLR_OUTPUT_STATE_GAMMA_LUT)) {
@@ -1057,6 +1609,15 @@ uint32_t wlr_drm_connector_get_id(struct wlr_output *output) {
 	return conn->id;
 }
 
+enum wlr_drm_mgpu_path wlr_drm_connector_get_mgpu_path(
+		struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	if (!conn->backend->parent || !conn->crtc) {
+		return WLR_DRM_MGPU_PATH_NONE;
+	}
+	return conn->crtc->primary->mgpu_path;
+}
+
 static const int32_t subpixel_map[] = {
 	[DRM_MODE_SUBPIXEL_UNKNOWN] = WL_OUTPUT_SUBPIXEL_UNKNOWN,
 	[DRM_MODE_SUBPIXEL_HORIZONTAL_RGB] = WL_OUTPUT_SUBPIXEL_HORIZONTAL_RGB,
@@ -1086,6 +1647,7 @@ static void dealloc_crtc(struct wlr_drm_connector *conn) {
 	if (conn->crtc->cursor != NULL) {
 		conn->crtc->cursor->cursor_enabled = false;
 	}
+	drm_crtc_release_overlays(drm, conn->crtc);
 
 	conn->crtc = NULL;
 }
@@ -1461,10 +2023,6 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 	attempt_enable_needs_modeset(drm);
 }
 
-static int mhz_to_nsec(int mhz) {
-	return 1000000000000LL / mhz;
-}
-
 static void page_flip_handler(int fd, unsigned seq,
 		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
 	struct wlr_drm_backend *drm = data;
@@ -1498,6 +2056,17 @@ static void page_flip_handler(int fd, unsigned seq,
 		drm_fb_move(&conn->crtc->cursor->current_fb,
 			&conn->crtc->cursor->queued_fb);
 	}
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *overlay = &drm->overlays[i];
+		if (overlay->crtc != conn->crtc) {
+			continue;
+		}
+		if (overlay->release_pending) {
+			drm_overlay_plane_release(overlay);
+		} else if (overlay->queued_fb) {
+			drm_fb_move(&overlay->current_fb, &overlay->queued_fb);
+		}
+	}
 	struct timespec present_time = {
 		.tv_sec = tv_sec,
 		.tv_nsec = tv_usec * 1000,
@@ -1506,16 +2075,12 @@ static void page_flip_handler(int fd, unsigned seq,
 	int refresh = mhz_to_nsec(conn->output.refresh);
 	uint32_t present_flags = WLR_OUTPUT_PRESENT_HW_CLOCK |
 		WLR_OUTPUT_PRESENT_HW_COMPLETION;
-	if (conn->output.present_mode == WLR_OUTPUT_PRESENT_MODE_NORMAL) {
+	if (!conn->adaptive_present.flip_torn) {
 		present_flags |= WLR_OUTPUT_PRESENT_VSYNC;
-	} else if (conn->output.present_mode == WLR_OUTPUT_PRESENT_MODE_ADAPTIVE) {
-		conn->next_present.tv_sec = tv_sec;
-		conn->next_present.tv_nsec = present_time.tv_nsec + refresh;
-		if (conn->next_present.tv_nsec > 1000000000) {
-			conn->next_present.tv_nsec -= 1000000000;
-			conn->next_present.tv_sec++;
-		}
+		// Async page-flips don't happen on a vblank, keep the previous phase
+		conn->adaptive_present.last_vblank = present_time;
 	}
+	conn->adaptive_present.last_present = present_time;
 	/* Don't report ZERO_COPY in multi-gpu situations, because we had to copy
 	 * data between the GPUs, even if we were using the direct scanout
 	 * interface.
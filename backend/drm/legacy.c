@@ -1,7 +1,7 @@
 #define _POSIX_C_SOURCE 200809L
 #include <assert.h>
-#include <time.h>
 #include <gbm.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
@@ -26,25 +26,8 @@ bool drm_legacy_crtc_commit(struct wlr_drm_backend *drm,
 		fb_id = fb->id;
 	}
 
-	switch (conn->output.present_mode) {
-		case WLR_OUTPUT_PRESENT_MODE_IMMEDIATE:
-			flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-			break;
-		case WLR_OUTPUT_PRESENT_MODE_ADAPTIVE: {
-			struct timespec cur;
-			clock_gettime(CLOCK_MONOTONIC, &cur);
-			// I'm sure this messy logic can be simplified..
-			if (cur.tv_sec == conn->next_present.tv_sec) {
-				if (cur.tv_nsec > conn->next_present.tv_nsec) {
-					// rats, we missed vblank, flip immediately!
-					flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-				}
-			} else if (cur.tv_sec > conn->next_present.tv_sec) {
-				flags |= DRM_MODE_PAGE_FLIP_ASYNC;
-			}
-			break;
-		}
-		default:break;
+	if (drm_connector_wants_async_page_flip(conn)) {
+		flags |= DRM_MODE_PAGE_FLIP_ASYNC;
 	}
 
 	if (crtc->pending_modeset) {
@@ -96,6 +79,22 @@ bool drm_legacy_crtc_commit(struct wlr_drm_backend *drm,
 			output->pending.adaptive_sync_enabled ? "enabled" : "disabled");
 	}
 
+	// Overlay planes are only driven through the atomic interface: make sure
+	// none is left enabled on this CRTC
+	for (size_t i = 0; i < drm->num_overlays; ++i) {
+		struct wlr_drm_plane *plane = &drm->overlays[i];
+		if (plane->crtc != crtc) {
+			continue;
+		}
+		if (drmModeSetPlane(drm->fd, plane->id, crtc->id, 0, 0,
+				0, 0, 0, 0, 0, 0, 0, 0) != 0) {
+			wlr_drm_conn_log_errno(conn, WLR_ERROR,
+				"Failed to disable overlay plane %"PRIu32, plane->id);
+			return false;
+		}
+		drm_overlay_plane_release(plane);
+	}
+
 	if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
 		if (drmModePageFlip(drm->fd, crtc->id, fb_id,
 				flags, drm)) {
@@ -3,6 +3,7 @@
 #include <drm_fourcc.h>
 #include <fcntl.h>
 #include <gbm.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
@@ -182,6 +183,7 @@ void drm_plane_finish_surface(struct wlr_drm_plane *plane) {
 	drm_fb_clear(&plane->pending_fb);
 	drm_fb_clear(&plane->queued_fb);
 	drm_fb_clear(&plane->current_fb);
+	drm_plane_set_in_fence(plane, -1);
 
 	finish_drm_surface(&plane->surf);
 	finish_drm_surface(&plane->mgpu_surf);
@@ -208,6 +210,45 @@ static struct wlr_drm_format *create_linear_format(uint32_t format) {
 	return fmt;
 }
 
+/**
+ * Intersect the parent GPU's render formats, the plane's formats and this
+ * GPU's texture formats. Buffers allocated with the resulting modifiers can
+ * be scanned out directly, or copied if the plane rejects them.
+ */
+static struct wlr_drm_format *create_mgpu_shared_format(
+		struct wlr_drm_backend *drm, const struct wlr_drm_format *plane_format) {
+	const struct wlr_drm_format_set *parent_formats =
+		wlr_renderer_get_dmabuf_render_formats(drm->parent->renderer.wlr_rend);
+	const struct wlr_drm_format_set *texture_formats =
+		wlr_renderer_get_dmabuf_texture_formats(drm->renderer.wlr_rend);
+	if (parent_formats == NULL || texture_formats == NULL) {
+		return NULL;
+	}
+
+	const struct wlr_drm_format *parent_format =
+		wlr_drm_format_set_get(parent_formats, plane_format->format);
+	const struct wlr_drm_format *texture_format =
+		wlr_drm_format_set_get(texture_formats, plane_format->format);
+	if (parent_format == NULL || texture_format == NULL) {
+		return NULL;
+	}
+
+	struct wlr_drm_format *scanout_format =
+		wlr_drm_format_intersect(parent_format, plane_format);
+	if (scanout_format == NULL) {
+		return NULL;
+	}
+	struct wlr_drm_format *shared_format =
+		wlr_drm_format_intersect(scanout_format, texture_format);
+	free(scanout_format);
+	// Implicit modifiers aren't meaningful across devices
+	if (shared_format != NULL && shared_format->len == 0) {
+		free(shared_format);
+		return NULL;
+	}
+	return shared_format;
+}
+
 bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 		struct wlr_drm_backend *drm, int32_t width, uint32_t height,
 		uint32_t format, bool with_modifiers) {
@@ -259,16 +300,29 @@ bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 		ok = init_drm_surface(&plane->surf, &drm->renderer,
 			width, height, drm_format);
 	} else {
-		struct wlr_drm_format *drm_format_linear = create_linear_format(format);
-		if (drm_format_linear == NULL) {
+		// Allocate buffers on the parent GPU with a modifier the plane can
+		// scan out, to avoid copies
+		struct wlr_drm_format *parent_format = NULL;
+		if (with_modifiers && plane->type == DRM_PLANE_TYPE_PRIMARY &&
+				drm->iface == &atomic_iface) {
+			parent_format = create_mgpu_shared_format(drm, plane_format);
+		}
+		// Surfaces are re-initialized on each modeset, so direct scan-out is
+		// probed again with the new mode
+		plane->mgpu_path = parent_format != NULL ?
+			WLR_DRM_MGPU_PATH_NONE : WLR_DRM_MGPU_PATH_BLIT;
+		if (parent_format == NULL) {
+			parent_format = create_linear_format(format);
+		}
+		if (parent_format == NULL) {
 			free(drm_format);
 			free(format_implicit_modifier);
 			return false;
 		}
 
 		ok = init_drm_surface(&plane->surf, &drm->parent->renderer,
-			width, height, drm_format_linear);
-		free(drm_format_linear);
+			width, height, parent_format);
+		free(parent_format);
 
 		if (ok && !init_drm_surface(&plane->mgpu_surf, &drm->renderer,
 				width, height, drm_format)) {
@@ -289,35 +343,93 @@ void drm_fb_clear(struct wlr_drm_fb **fb_ptr) {
 	}
 
 	struct wlr_drm_fb *fb = *fb_ptr;
+	assert(fb->n_refs > 0);
+	fb->n_refs--;
+	if (fb->n_refs == 0) {
+		fb->backend->unused_fbs++;
+	}
 	wlr_buffer_unlock(fb->wlr_buf); // may destroy the buffer
 
 	*fb_ptr = NULL;
 }
 
+static bool drm_plane_lock_blit(struct wlr_drm_plane *plane,
+		struct wlr_drm_backend *drm, struct wlr_buffer *buf) {
+	// Perform a copy across GPUs
+	struct wlr_buffer *local_buf = drm_surface_blit(&plane->mgpu_surf, buf);
+	if (!local_buf) {
+		wlr_log(WLR_ERROR, "Failed to blit buffer across GPUs");
+		return false;
+	}
+
+	bool ok = drm_fb_import(&plane->pending_fb, drm, local_buf, NULL);
+	wlr_buffer_unlock(local_buf);
+	return ok;
+}
+
 bool drm_plane_lock_surface(struct wlr_drm_plane *plane,
 		struct wlr_drm_backend *drm) {
 	assert(plane->surf.back_buffer != NULL);
 	struct wlr_buffer *buf = wlr_buffer_lock(plane->surf.back_buffer);
 
+	// With explicit synchronization, KMS waits for rendering to complete
+	// before scanning out the buffer. Copies across GPUs keep relying on
+	// implicit synchronization, and so does the cursor plane, which is
+	// always updated via the legacy interface.
+	int fence_fd = -1;
+	if (plane->props.in_fence_fd != 0 && drm->iface == &atomic_iface &&
+			plane->type != DRM_PLANE_TYPE_CURSOR) {
+		fence_fd = wlr_renderer_create_fence_fd(plane->surf.renderer->wlr_rend);
+	}
+
 	// Unset the current EGL context ASAP, because other operations may require
 	// making another context current.
 	drm_surface_unset_current(&plane->surf);
 
-	struct wlr_buffer *local_buf;
-	if (drm->parent) {
-		// Perform a copy across GPUs
-		local_buf = drm_surface_blit(&plane->mgpu_surf, buf);
-		if (!local_buf) {
-			wlr_log(WLR_ERROR, "Failed to blit buffer across GPUs");
-			return false;
+	bool ok;
+	plane->mgpu_pending_direct = false;
+	if (!drm->parent) {
+		ok = drm_fb_import(&plane->pending_fb, drm, buf, NULL);
+	} else if (plane->type == DRM_PLANE_TYPE_PRIMARY &&
+			plane->mgpu_path != WLR_DRM_MGPU_PATH_BLIT &&
+			drm_fb_import(&plane->pending_fb, drm, buf, &plane->formats)) {
+		// The parent GPU buffer could be imported on this device. Whether
+		// it can actually be scanned out is checked before the page-flip.
+		plane->mgpu_pending_direct = true;
+		ok = true;
+	} else {
+		if (plane->mgpu_path != WLR_DRM_MGPU_PATH_BLIT &&
+				plane->type == DRM_PLANE_TYPE_PRIMARY) {
+			wlr_log(WLR_DEBUG, "Failed to import parent GPU buffer on "
+				"plane %"PRIu32", copying across GPUs", plane->id);
+			plane->mgpu_path = WLR_DRM_MGPU_PATH_BLIT;
 		}
+		ok = drm_plane_lock_blit(plane, drm, buf);
+	}
+
+	if (ok && (!drm->parent || plane->mgpu_pending_direct)) {
+		drm_plane_set_in_fence(plane, fence_fd);
 	} else {
-		local_buf = wlr_buffer_lock(buf);
+		drm_plane_set_in_fence(plane, -1);
+		if (fence_fd >= 0) {
+			close(fence_fd);
+		}
 	}
+
 	wlr_buffer_unlock(buf);
+	return ok;
+}
 
-	bool ok = drm_fb_import(&plane->pending_fb, drm, local_buf, NULL);
-	wlr_buffer_unlock(local_buf);
+bool drm_plane_mgpu_fallback_blit(struct wlr_drm_plane *plane,
+		struct wlr_drm_backend *drm) {
+	assert(plane->mgpu_pending_direct && plane->pending_fb != NULL);
+
+	plane->mgpu_pending_direct = false;
+	drm_plane_set_in_fence(plane, -1);
+
+	struct wlr_buffer *buf = wlr_buffer_lock(plane->pending_fb->wlr_buf);
+	bool ok = drm_plane_lock_blit(plane, drm, buf);
+	wlr_buffer_unlock(buf);
 	return ok;
 }
 
@@ -358,10 +470,99 @@ static struct gbm_bo *get_bo_for_dmabuf(struct gbm_device *gbm,
 	}
 }
 
+// Maximum number of cached framebuffers not referenced by any plane
+#define DRM_FB_CACHE_MAX_UNUSED 32
+
+static struct wl_list *drm_fb_bucket(struct wlr_drm_backend *drm,
+		struct wlr_buffer *buf) {
+	uint64_t hash = (uintptr_t)buf;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return &drm->fb_buckets[hash % WLR_DRM_FB_CACHE_BUCKETS];
+}
+
+static void drm_fb_remove(struct wlr_drm_fb *fb) {
+	wl_list_remove(&fb->link);
+	wl_list_remove(&fb->bucket_link);
+	wl_list_remove(&fb->wlr_buf_destroy.link);
+	fb->backend->fb_cache_stats.size--;
+	if (fb->n_refs == 0) {
+		fb->backend->unused_fbs--;
+	}
+}
+
+static void drm_fb_finish(struct wlr_drm_fb *fb) {
+	struct gbm_device *gbm = gbm_bo_get_device(fb->bo);
+	if (drmModeRmFB(gbm_device_get_fd(gbm), fb->id) != 0) {
+		wlr_log(WLR_ERROR, "drmModeRmFB failed");
+	}
+
+	gbm_bo_destroy(fb->bo);
+	free(fb);
+}
+
+void drm_fb_destroy_dead(struct wlr_drm_backend *drm) {
+	struct wlr_drm_fb *fb, *tmp;
+	wl_list_for_each_safe(fb, tmp, &drm->dead_fbs, link) {
+		wl_list_remove(&fb->link);
+		drm_fb_finish(fb);
+	}
+}
+
+static void handle_dead_fbs_idle(void *data) {
+	struct wlr_drm_backend *drm = data;
+	drm->dead_fbs_idle = NULL;
+	drm_fb_destroy_dead(drm);
+}
+
+/**
+ * Remove a framebuffer from the cache and schedule its destruction. RmFB
+ * ioctls are batched in an idle callback to keep them off the commit path.
+ */
+static void drm_fb_release(struct wlr_drm_fb *fb) {
+	struct wlr_drm_backend *drm = fb->backend;
+	drm_fb_remove(fb);
+	fb->wlr_buf = NULL;
+	wl_list_insert(&drm->dead_fbs, &fb->link);
+
+	if (drm->dead_fbs_idle == NULL) {
+		struct wl_event_loop *event_loop =
+			wl_display_get_event_loop(drm->display);
+		drm->dead_fbs_idle =
+			wl_event_loop_add_idle(event_loop, handle_dead_fbs_idle, drm);
+		if (drm->dead_fbs_idle == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create idle event source");
+			drm_fb_destroy_dead(drm);
+		}
+	}
+}
+
 static void drm_fb_handle_wlr_buf_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_drm_fb *fb = wl_container_of(listener, fb, wlr_buf_destroy);
-	drm_fb_destroy(fb);
+	drm_fb_release(fb);
+}
+
+/**
+ * Evict the least recently used framebuffers which aren't referenced by any
+ * plane, until the number of such framebuffers is within bounds.
+ */
+static void drm_fb_cache_evict(struct wlr_drm_backend *drm) {
+	if (drm->unused_fbs <= DRM_FB_CACHE_MAX_UNUSED) {
+		return;
+	}
+
+	struct wlr_drm_fb *fb, *tmp;
+	wl_list_for_each_reverse_safe(fb, tmp, &drm->fbs, link) {
+		if (drm->unused_fbs <= DRM_FB_CACHE_MAX_UNUSED) {
+			break;
+		}
+		if (fb->n_refs == 0) {
+			drm_fb_release(fb);
+			drm->fb_cache_stats.evictions++;
+		}
+	}
 }
 
 static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
@@ -403,12 +604,16 @@ static struct wlr_drm_fb *drm_fb_create(struct wlr_drm_backend *drm,
 		goto error_get_fb_for_bo;
 	}
 
+	fb->backend = drm;
 	fb->wlr_buf = buf;
 
 	fb->wlr_buf_destroy.notify = drm_fb_handle_wlr_buf_destroy;
 	wl_signal_add(&buf->events.destroy, &fb->wlr_buf_destroy);
 
 	wl_list_insert(&drm->fbs, &fb->link);
+	wl_list_insert(drm_fb_bucket(drm, buf), &fb->bucket_link);
+	drm->fb_cache_stats.size++;
+	drm->unused_fbs++;
 
 	return fb;
 
@@ -420,23 +625,18 @@ error_get_dmabuf:
 }
 
 void drm_fb_destroy(struct wlr_drm_fb *fb) {
-	wl_list_remove(&fb->link);
-	wl_list_remove(&fb->wlr_buf_destroy.link);
-
-	struct gbm_device *gbm = gbm_bo_get_device(fb->bo);
-	if (drmModeRmFB(gbm_device_get_fd(gbm), fb->id) != 0) {
-		wlr_log(WLR_ERROR, "drmModeRmFB failed");
-	}
-
-	gbm_bo_destroy(fb->bo);
-	free(fb);
+	drm_fb_remove(fb);
+	drm_fb_finish(fb);
 }
 
 static struct wlr_drm_fb *drm_fb_get(struct wlr_drm_backend *drm,
 		struct wlr_buffer *local_buf) {
 	struct wlr_drm_fb *fb;
-	wl_list_for_each(fb, &drm->fbs, link) {
+	wl_list_for_each(fb, drm_fb_bucket(drm, local_buf), bucket_link) {
 		if (fb->wlr_buf == local_buf) {
+			// Move to the front of the most-recently-used list
+			wl_list_remove(&fb->link);
+			wl_list_insert(&drm->fbs, &fb->link);
 			return fb;
 		}
 	}
@@ -446,7 +646,10 @@ static struct wlr_drm_fb *drm_fb_get(struct wlr_drm_backend *drm,
 bool drm_fb_import(struct wlr_drm_fb **fb_ptr, struct wlr_drm_backend *drm,
 		struct wlr_buffer *buf, const struct wlr_drm_format_set *formats) {
 	struct wlr_drm_fb *fb = drm_fb_get(drm, buf);
-	if (!fb) {
+	if (fb) {
+		drm->fb_cache_stats.hits++;
+	} else {
+		drm->fb_cache_stats.misses++;
 		fb = drm_fb_create(drm, buf, formats);
 		if (!fb) {
 			return false;
@@ -454,7 +657,13 @@ bool drm_fb_import(struct wlr_drm_fb **fb_ptr, struct wlr_drm_backend *drm,
 	}
 
 	wlr_buffer_lock(buf);
+	if (fb->n_refs == 0) {
+		drm->unused_fbs--;
+	}
+	fb->n_refs++;
 	drm_fb_move(fb_ptr, &fb);
+
+	drm_fb_cache_evict(drm);
 	return true;
 }
 
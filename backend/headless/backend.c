@@ -6,12 +6,14 @@
 #include <unistd.h>
 #include <wlr/interfaces/wlr_input_device.h>
 #include <wlr/interfaces/wlr_output.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include "backend/headless.h"
 #include "render/drm_format_set.h"
 #include "render/gbm_allocator.h"
+#include "render/shm_allocator.h"
 #include "render/wlr_renderer.h"
 #include "util/signal.h"
 
@@ -75,7 +77,9 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 	}
 
 	wlr_allocator_destroy(backend->allocator);
-	close(backend->drm_fd);
+	if (backend->drm_fd >= 0) {
+		close(backend->drm_fd);
+	}
 	free(backend);
 }
 
@@ -111,18 +115,54 @@ static void handle_renderer_destroy(struct wl_listener *listener, void *data) {
 	backend_destroy(&backend->backend);
 }
 
+static struct wlr_allocator *create_allocator(
+		struct wlr_headless_backend *backend) {
+	// The pixman renderer can only render into buffers mapped in our address
+	// space, and doesn't need a DRM device
+	if (wlr_renderer_is_pixman(backend->renderer)) {
+		struct wlr_shm_allocator *shm_alloc = wlr_shm_allocator_create();
+		if (shm_alloc == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create shared memory allocator");
+			return NULL;
+		}
+		return &shm_alloc->base;
+	}
+
+	if (backend->drm_fd < 0) {
+		wlr_log(WLR_ERROR, "Cannot create GBM allocator without DRM device");
+		return NULL;
+	}
+
+	int drm_fd = fcntl(backend->drm_fd, F_DUPFD_CLOEXEC, 0);
+	if (drm_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
+		return NULL;
+	}
+
+	struct wlr_gbm_allocator *gbm_alloc = wlr_gbm_allocator_create(drm_fd);
+	if (gbm_alloc == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create GBM allocator");
+		close(drm_fd);
+		return NULL;
+	}
+	return &gbm_alloc->base;
+}
+
 static bool backend_init(struct wlr_headless_backend *backend,
-		struct wl_display *display, struct wlr_allocator *allocator,
-		struct wlr_renderer *renderer) {
+		struct wl_display *display, struct wlr_renderer *renderer) {
 	wlr_backend_init(&backend->backend, &backend_impl);
 	backend->display = display;
 	wl_list_init(&backend->outputs);
 	wl_list_init(&backend->input_devices);
 
-	backend->allocator = allocator;
-
 	if (renderer == NULL) {
-		renderer = wlr_renderer_autocreate(&backend->backend);
+		if (backend->drm_fd >= 0) {
+			renderer = wlr_renderer_autocreate(&backend->backend);
+		} else {
+			wlr_log(WLR_INFO, "No DRM render node available, "
+				"falling back to software rendering");
+			renderer = wlr_pixman_renderer_create();
+		}
 		if (!renderer) {
 			wlr_log(WLR_ERROR, "Failed to create renderer");
 			return false;
@@ -144,6 +184,12 @@ static bool backend_init(struct wlr_headless_backend *backend,
 	}
 	backend->format = wlr_drm_format_dup(format);
 
+	backend->allocator = create_allocator(backend);
+	if (backend->allocator == NULL) {
+		free(backend->format);
+		return false;
+	}
+
 	backend->display_destroy.notify = handle_display_destroy;
 	wl_display_add_destroy_listener(display, &backend->display_destroy);
 
@@ -208,36 +254,20 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display) {
 		return NULL;
 	}
 
+	// Without a render node, fall back to software rendering into shared
+	// memory buffers
 	backend->drm_fd = open_drm_render_node();
-	if (backend->drm_fd < 0) {
-		wlr_log(WLR_ERROR, "Failed to open DRM render node");
-		goto error_drm_fd;
-	}
-
-	int drm_fd = fcntl(backend->drm_fd, F_DUPFD_CLOEXEC, 0);
-	if (drm_fd < 0) {
-		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
-		goto error_dup;
-	}
 
-	struct wlr_gbm_allocator *gbm_alloc = wlr_gbm_allocator_create(drm_fd);
-	if (gbm_alloc == NULL) {
-		wlr_log(WLR_ERROR, "Failed to create GBM allocator");
-		close(drm_fd);
-		goto error_dup;
-	}
-
-	if (!backend_init(backend, display, &gbm_alloc->base, NULL)) {
+	if (!backend_init(backend, display, NULL)) {
 		goto error_init;
 	}
 
 	return &backend->backend;
 
 error_init:
-	wlr_allocator_destroy(&gbm_alloc->base);
-error_dup:
-	close(backend->drm_fd);
-error_drm_fd:
+	if (backend->drm_fd >= 0) {
+		close(backend->drm_fd);
+	}
 	free(backend);
 	return NULL;
 }
@@ -254,26 +284,16 @@ struct wlr_backend *wlr_headless_backend_create_with_renderer(
 	}
 	backend->has_parent_renderer = true;
 
-	backend->drm_fd = wlr_renderer_get_drm_fd(renderer);
-	if (backend->drm_fd < 0) {
-		wlr_log(WLR_ERROR, "Failed to get DRM device FD from renderer");
-		goto error_drm_fd;
-	}
-
-	int drm_fd = fcntl(backend->drm_fd, F_DUPFD_CLOEXEC, 0);
-	if (drm_fd < 0) {
-		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
-		goto error_dup;
-	}
-
-	struct wlr_gbm_allocator *gbm_alloc = wlr_gbm_allocator_create(drm_fd);
-	if (gbm_alloc == NULL) {
-		wlr_log(WLR_ERROR, "Failed to create GBM allocator");
-		close(drm_fd);
-		goto error_dup;
+	backend->drm_fd = -1;
+	if (!wlr_renderer_is_pixman(renderer)) {
+		backend->drm_fd = wlr_renderer_get_drm_fd(renderer);
+		if (backend->drm_fd < 0) {
+			wlr_log(WLR_ERROR, "Failed to get DRM device FD from renderer");
+			goto error_init;
+		}
 	}
 
-	if (!backend_init(backend, display, &gbm_alloc->base, renderer)) {
+	if (!backend_init(backend, display, renderer)) {
 		goto error_init;
 	}
 
@@ -283,10 +303,6 @@ struct wlr_backend *wlr_headless_backend_create_with_renderer(
 	return &backend->backend;
 
 error_init:
-	wlr_allocator_destroy(&gbm_alloc->base);
-error_dup:
-	close(backend->drm_fd);
-error_drm_fd:
 	free(backend);
 	return NULL;
 }
@@ -14,9 +14,8 @@ static struct wlr_libinput_backend *get_libinput_backend_from_backend(
 	return (struct wlr_libinput_backend *)wlr_backend;
 }
 
-static int libinput_open_restricted(const char *path,
-		int flags, void *_backend) {
-	struct wlr_libinput_backend *backend = _backend;
+int libinput_backend_open_file(struct wlr_libinput_backend *backend,
+		const char *path) {
 	struct wlr_device *dev = wlr_session_open_file(backend->session, path);
 	if (dev == NULL) {
 		return -1;
@@ -24,9 +23,8 @@ static int libinput_open_restricted(const char *path,
 	return dev->fd;
 }
 
-static void libinput_close_restricted(int fd, void *_backend) {
-	struct wlr_libinput_backend *backend = _backend;
-
+void libinput_backend_close_file(struct wlr_libinput_backend *backend,
+		int fd) {
 	struct wlr_device *dev;
 	bool found = false;
 	wl_list_for_each(dev, &backend->session->devices, link) {
@@ -40,6 +38,27 @@ static void libinput_close_restricted(int fd, void *_backend) {
 	}
 }
 
+static int libinput_open_restricted(const char *path,
+		int flags, void *_backend) {
+	struct wlr_libinput_backend *backend = _backend;
+	// The session belongs to the main thread
+	if (backend->input_thread != NULL &&
+			input_thread_is_current(backend->input_thread)) {
+		return input_thread_forward_request(backend->input_thread, path, -1);
+	}
+	return libinput_backend_open_file(backend, path);
+}
+
+static void libinput_close_restricted(int fd, void *_backend) {
+	struct wlr_libinput_backend *backend = _backend;
+	if (backend->input_thread != NULL &&
+			input_thread_is_current(backend->input_thread)) {
+		input_thread_forward_request(backend->input_thread, NULL, fd);
+		return;
+	}
+	libinput_backend_close_file(backend, fd);
+}
+
 static const struct libinput_interface libinput_impl = {
 	.open_restricted = libinput_open_restricted,
 	.close_restricted = libinput_close_restricted
@@ -118,6 +137,19 @@ static bool backend_start(struct wlr_backend *wlr_backend) {
 		}
 	}
 
+	char *thread = getenv("WLR_LIBINPUT_THREAD");
+	if (thread != NULL && strcmp(thread, "1") == 0) {
+		if (backend->input_thread == NULL) {
+			backend->input_thread = input_thread_create(backend);
+			if (backend->input_thread == NULL) {
+				return false;
+			}
+		}
+		wlr_log(WLR_DEBUG, "libinput successfully initialized, "
+			"reading events on a separate thread");
+		return true;
+	}
+
 	struct wl_event_loop *event_loop =
 		wl_display_get_event_loop(backend->display);
 	if (backend->input_event) {
@@ -140,6 +172,11 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 	struct wlr_libinput_backend *backend =
 		get_libinput_backend_from_backend(wlr_backend);
 
+	if (backend->input_thread) {
+		input_thread_destroy(backend->input_thread);
+		backend->input_thread = NULL;
+	}
+
 	for (size_t i = 0; i < backend->wlr_device_lists.length; i++) {
 		struct wl_list *wlr_devices = backend->wlr_device_lists.items[i];
 		struct wlr_input_device *wlr_dev, *next;
@@ -181,11 +218,17 @@ static void session_signal(struct wl_listener *listener, void *data) {
 		return;
 	}
 
+	if (backend->input_thread) {
+		input_thread_lock_context(backend->input_thread);
+	}
 	if (session->active) {
 		libinput_resume(backend->libinput_context);
 	} else {
 		libinput_suspend(backend->libinput_context);
 	}
+	if (backend->input_thread) {
+		input_thread_unlock_context(backend->input_thread);
+	}
 }
 
 static void handle_session_destroy(struct wl_listener *listener, void *data) {
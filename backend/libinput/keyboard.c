@@ -23,7 +23,17 @@ static struct wlr_libinput_keyboard *get_libinput_keyboard_from_keyboard(
 static void keyboard_set_leds(struct wlr_keyboard *wlr_kb, uint32_t leds) {
 	struct wlr_libinput_keyboard *kb =
 		get_libinput_keyboard_from_keyboard(wlr_kb);
+	// LEDs can be updated by the compositor at any time, while the input
+	// thread dispatches libinput
+	struct wlr_libinput_backend *backend = libinput_get_user_data(
+		libinput_device_get_context(kb->libinput_dev));
+	if (backend->input_thread) {
+		input_thread_lock_context(backend->input_thread);
+	}
 	libinput_device_led_update(kb->libinput_dev, leds);
+	if (backend->input_thread) {
+		input_thread_unlock_context(backend->input_thread);
+	}
 }
 
 static void keyboard_destroy(struct wlr_keyboard *wlr_kb) {
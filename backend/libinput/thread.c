@@ -0,0 +1,356 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <inttypes.h>
+#include <libinput.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "backend/libinput.h"
+#include "util/time.h"
+
+// Events handed over later than this are reported as delayed
+#define HANDOFF_DELAY_WARN_MS 16
+
+static _Thread_local struct wlr_libinput_input_thread *current_thread = NULL;
+
+bool input_thread_is_current(struct wlr_libinput_input_thread *thread) {
+	return current_thread == thread;
+}
+
+static void eventfd_signal(int fd) {
+	uint64_t one = 1;
+	if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "Failed to write eventfd");
+	}
+}
+
+static void eventfd_drain(int fd) {
+	uint64_t count;
+	if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		wlr_log_errno(WLR_ERROR, "Failed to read eventfd");
+	}
+}
+
+static void ring_push(struct wlr_libinput_event_ring *ring,
+		const struct wlr_libinput_queued_event *item) {
+	size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	ring->items[head % WLR_LIBINPUT_RING_SIZE] = *item;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void ring_destroy_events(struct wlr_libinput_event_ring *ring) {
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	for (; tail != head; tail++) {
+		libinput_event_destroy(ring->items[tail % WLR_LIBINPUT_RING_SIZE].event);
+	}
+	atomic_store_explicit(&ring->tail, tail, memory_order_release);
+}
+
+int input_thread_forward_request(struct wlr_libinput_input_thread *thread,
+		const char *path, int fd) {
+	pthread_mutex_lock(&thread->lock);
+	thread->request.pending = true;
+	thread->request.path = path;
+	thread->request.fd = fd;
+	// The main thread is either idle or waiting for the context
+	eventfd_signal(thread->notify_fd);
+	pthread_cond_broadcast(&thread->cond);
+	while (thread->request.pending && !atomic_load(&thread->stop)) {
+		pthread_cond_wait(&thread->cond, &thread->lock);
+	}
+	int ret = thread->request.pending ? -1 : thread->request.fd;
+	thread->request.pending = false;
+	pthread_mutex_unlock(&thread->lock);
+	return ret;
+}
+
+static void handle_request_locked(struct wlr_libinput_input_thread *thread) {
+	if (!thread->request.pending) {
+		return;
+	}
+	if (thread->request.path != NULL) {
+		thread->request.fd = libinput_backend_open_file(thread->backend,
+			thread->request.path);
+	} else {
+		libinput_backend_close_file(thread->backend, thread->request.fd);
+		thread->request.fd = 0;
+	}
+	thread->request.pending = false;
+	pthread_cond_broadcast(&thread->cond);
+}
+
+static void handle_request(struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	handle_request_locked(thread);
+	pthread_mutex_unlock(&thread->lock);
+}
+
+void input_thread_lock_context(struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	if (thread->context_main_depth == 0) {
+		// The input thread may own the context while it waits for us to
+		// open a device: serve its requests until it lets go
+		while (thread->context_input_owned) {
+			if (thread->request.pending) {
+				handle_request_locked(thread);
+			} else {
+				pthread_cond_wait(&thread->cond, &thread->lock);
+			}
+		}
+	}
+	thread->context_main_depth++;
+	pthread_mutex_unlock(&thread->lock);
+}
+
+void input_thread_unlock_context(struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	if (--thread->context_main_depth == 0) {
+		pthread_cond_broadcast(&thread->cond);
+	}
+	pthread_mutex_unlock(&thread->lock);
+}
+
+static void input_thread_acquire_context(
+		struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	while (thread->context_main_depth > 0) {
+		pthread_cond_wait(&thread->cond, &thread->lock);
+	}
+	thread->context_input_owned = true;
+	pthread_mutex_unlock(&thread->lock);
+}
+
+static void input_thread_release_context(
+		struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	thread->context_input_owned = false;
+	pthread_cond_broadcast(&thread->cond);
+	pthread_mutex_unlock(&thread->lock);
+}
+
+static bool event_needs_context_lock(enum libinput_event_type type) {
+	switch (type) {
+	case LIBINPUT_EVENT_DEVICE_ADDED:
+	case LIBINPUT_EVENT_DEVICE_REMOVED:
+		// Devices get configured, referenced and released
+	case LIBINPUT_EVENT_TABLET_TOOL_AXIS:
+	case LIBINPUT_EVENT_TABLET_TOOL_PROXIMITY:
+	case LIBINPUT_EVENT_TABLET_TOOL_TIP:
+	case LIBINPUT_EVENT_TABLET_TOOL_BUTTON:
+	case LIBINPUT_EVENT_TABLET_PAD_BUTTON:
+	case LIBINPUT_EVENT_TABLET_PAD_RING:
+	case LIBINPUT_EVENT_TABLET_PAD_STRIP:
+		// Tools and pad mode groups are reference-counted by the context
+		return true;
+	default:
+		// Keyboard events may update the LEDs: the keyboard locks the
+		// context itself, only when they change
+		return false;
+	}
+}
+
+static int handle_notify(int fd, uint32_t mask, void *data) {
+	struct wlr_libinput_input_thread *thread = data;
+	eventfd_drain(fd);
+
+	handle_request(thread);
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t max_delay_ms = 0;
+
+	struct wlr_libinput_event_ring *ring = &thread->events;
+	size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+	for (; tail != head; tail++) {
+		struct wlr_libinput_queued_event *item =
+			&ring->items[tail % WLR_LIBINPUT_RING_SIZE];
+
+		struct timespec delay;
+		timespec_sub(&delay, &now, &item->read_time);
+		if (timespec_to_msec(&delay) > max_delay_ms) {
+			max_delay_ms = timespec_to_msec(&delay);
+		}
+
+		bool lock = event_needs_context_lock(
+			libinput_event_get_type(item->event));
+		if (lock) {
+			input_thread_lock_context(thread);
+		}
+		handle_libinput_event(thread->backend, item->event);
+		if (lock) {
+			input_thread_unlock_context(thread);
+		}
+
+		// Only the input thread may destroy events
+		ring_push(&thread->done, item);
+		atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+	}
+
+	if (max_delay_ms > HANDOFF_DELAY_WARN_MS) {
+		wlr_log(WLR_DEBUG, "libinput events handled up to %"PRId64" ms "
+			"after being read", max_delay_ms);
+	}
+
+	if (atomic_exchange(&thread->ring_full, false)) {
+		eventfd_signal(thread->wake_fd);
+	}
+	return 0;
+}
+
+static void *input_thread_run(void *data) {
+	struct wlr_libinput_input_thread *thread = data;
+	struct libinput *context = thread->backend->libinput_context;
+	current_thread = thread;
+
+	struct pollfd fds[] = {
+		{ .fd = libinput_get_fd(context), .events = POLLIN },
+		{ .fd = thread->wake_fd, .events = POLLIN },
+	};
+
+	while (true) {
+		input_thread_acquire_context(thread);
+
+		// Free the slots of the events the main thread is done with
+		ring_destroy_events(&thread->done);
+		size_t done_tail =
+			atomic_load_explicit(&thread->done.tail, memory_order_relaxed);
+
+		if (libinput_dispatch(context) != 0) {
+			wlr_log(WLR_ERROR, "Failed to dispatch libinput");
+		}
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		// Events still in the done ring occupy a slot too, so that the main
+		// thread never overflows it
+		struct wlr_libinput_event_ring *ring = &thread->events;
+		size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+		size_t queued = 0;
+		while (head - done_tail < WLR_LIBINPUT_RING_SIZE) {
+			struct libinput_event *event = libinput_get_event(context);
+			if (event == NULL) {
+				break;
+			}
+			ring->items[head % WLR_LIBINPUT_RING_SIZE] =
+				(struct wlr_libinput_queued_event){
+					.event = event,
+					.read_time = now,
+				};
+			head++;
+			queued++;
+		}
+		bool full = head - done_tail == WLR_LIBINPUT_RING_SIZE;
+		if (full) {
+			// Set before publishing, the main thread wakes us up once it
+			// has handled the events below
+			atomic_store(&thread->ring_full, true);
+		}
+		atomic_store_explicit(&ring->head, head, memory_order_release);
+
+		input_thread_release_context(thread);
+
+		if (queued > 0 || full) {
+			eventfd_signal(thread->notify_fd);
+		}
+
+		if (poll(fds, sizeof(fds) / sizeof(fds[0]), -1) < 0 &&
+				errno != EINTR) {
+			wlr_log_errno(WLR_ERROR, "Failed to poll libinput");
+			break;
+		}
+		if (atomic_load(&thread->stop)) {
+			break;
+		}
+		if (fds[1].revents & POLLIN) {
+			eventfd_drain(thread->wake_fd);
+		}
+	}
+
+	return NULL;
+}
+
+struct wlr_libinput_input_thread *input_thread_create(
+		struct wlr_libinput_backend *backend) {
+	struct wlr_libinput_input_thread *thread =
+		calloc(1, sizeof(struct wlr_libinput_input_thread));
+	if (thread == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	thread->backend = backend;
+	atomic_init(&thread->stop, false);
+	atomic_init(&thread->ring_full, false);
+	atomic_init(&thread->events.head, 0);
+	atomic_init(&thread->events.tail, 0);
+	atomic_init(&thread->done.head, 0);
+	atomic_init(&thread->done.tail, 0);
+
+	pthread_mutex_init(&thread->lock, NULL);
+	pthread_cond_init(&thread->cond, NULL);
+
+	thread->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (thread->wake_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create eventfd");
+		goto error_sync;
+	}
+	thread->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (thread->notify_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create eventfd");
+		goto error_wake;
+	}
+
+	struct wl_event_loop *event_loop =
+		wl_display_get_event_loop(backend->display);
+	thread->notify_source = wl_event_loop_add_fd(event_loop, thread->notify_fd,
+		WL_EVENT_READABLE, handle_notify, thread);
+	if (thread->notify_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create input event on event loop");
+		goto error_notify;
+	}
+
+	int ret = pthread_create(&thread->thread, NULL, input_thread_run, thread);
+	if (ret != 0) {
+		wlr_log(WLR_ERROR, "Failed to start input thread: %s", strerror(ret));
+		goto error_source;
+	}
+
+	return thread;
+
+error_source:
+	wl_event_source_remove(thread->notify_source);
+error_notify:
+	close(thread->notify_fd);
+error_wake:
+	close(thread->wake_fd);
+error_sync:
+	pthread_cond_destroy(&thread->cond);
+	pthread_mutex_destroy(&thread->lock);
+	free(thread);
+	return NULL;
+}
+
+void input_thread_destroy(struct wlr_libinput_input_thread *thread) {
+	pthread_mutex_lock(&thread->lock);
+	atomic_store(&thread->stop, true);
+	pthread_cond_broadcast(&thread->cond);
+	pthread_mutex_unlock(&thread->lock);
+	eventfd_signal(thread->wake_fd);
+	pthread_join(thread->thread, NULL);
+
+	// The input thread is gone, events can be destroyed from here
+	ring_destroy_events(&thread->events);
+	ring_destroy_events(&thread->done);
+
+	wl_event_source_remove(thread->notify_source);
+	close(thread->notify_fd);
+	close(thread->wake_fd);
+	pthread_cond_destroy(&thread->cond);
+	pthread_mutex_destroy(&thread->lock);
+	free(thread);
+}
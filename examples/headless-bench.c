@@ -0,0 +1,362 @@
+#define _POSIX_C_SOURCE 200809L
+#include <drm_fourcc.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/backend/headless.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/**
+ * Measures the cost of the upload/render/commit hot path on the headless
+ * backend. Each frame, every synthetic surface gets a damaged region of its
+ * pixels updated and uploaded, then all surfaces are rendered and the output
+ * is committed. Per-frame timings are reported as percentiles on exit.
+ */
+
+struct bench_surface {
+	struct wlr_texture *texture;
+	uint32_t *pixels;
+	int x, y;
+};
+
+struct bench_samples {
+	double *values; // ms
+	size_t len;
+};
+
+struct bench_state {
+	struct wl_display *display;
+	struct wlr_renderer *renderer;
+	struct wl_listener new_output;
+
+	int surface_width, surface_height;
+	int damage_width, damage_height;
+	int output_width, output_height;
+	size_t surfaces_len;
+	struct bench_surface *surfaces;
+
+	size_t frames, frame;
+	struct bench_samples upload, render, commit;
+	uint64_t upload_bytes;
+};
+
+struct bench_output {
+	struct bench_state *state;
+	struct wlr_output *output;
+	struct wl_listener frame;
+	struct wl_listener destroy;
+};
+
+static double timespec_diff_ms(const struct timespec *start,
+		const struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000.0 +
+		(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static int compare_double(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void print_samples(const char *name, struct bench_samples *samples) {
+	if (samples->len == 0) {
+		return;
+	}
+	qsort(samples->values, samples->len, sizeof(double), compare_double);
+	double sum = 0;
+	for (size_t i = 0; i < samples->len; ++i) {
+		sum += samples->values[i];
+	}
+	printf("%-8s mean %8.3f ms  p50 %8.3f ms  p90 %8.3f ms  "
+		"p99 %8.3f ms  max %8.3f ms\n", name, sum / samples->len,
+		samples->values[samples->len * 50 / 100],
+		samples->values[samples->len * 90 / 100],
+		samples->values[samples->len * 99 / 100],
+		samples->values[samples->len - 1]);
+}
+
+static void upload_surfaces(struct bench_state *state) {
+	for (size_t i = 0; i < state->surfaces_len; ++i) {
+		struct bench_surface *surface = &state->surfaces[i];
+
+		// Move the damaged rectangle across the surface every frame, like a
+		// client animating part of its window would
+		int max_x = state->surface_width - state->damage_width;
+		int max_y = state->surface_height - state->damage_height;
+		int dx = max_x > 0 ? (int)((state->frame * 7 + i) % (max_x + 1)) : 0;
+		int dy = max_y > 0 ? (int)((state->frame * 5 + i) % (max_y + 1)) : 0;
+
+		uint32_t color = 0xFF000000 | (uint32_t)(state->frame * 2654435761u);
+		for (int y = dy; y < dy + state->damage_height; ++y) {
+			uint32_t *row = &surface->pixels[y * state->surface_width];
+			for (int x = dx; x < dx + state->damage_width; ++x) {
+				row[x] = color;
+			}
+		}
+
+		pixman_region32_t damage;
+		pixman_region32_init_rect(&damage, dx, dy,
+			state->damage_width, state->damage_height);
+		size_t uploaded = 0;
+		wlr_texture_write_pixels_region(surface->texture,
+			state->surface_width * 4, &damage, surface->pixels, &uploaded);
+		pixman_region32_fini(&damage);
+
+		state->upload_bytes += uploaded;
+	}
+}
+
+static void output_frame_notify(struct wl_listener *listener, void *data) {
+	struct bench_output *bench_output =
+		wl_container_of(listener, bench_output, frame);
+	struct bench_state *state = bench_output->state;
+	struct wlr_output *wlr_output = bench_output->output;
+
+	if (state->frame == state->frames) {
+		wl_display_terminate(state->display);
+		return;
+	}
+
+	struct timespec t0, t1, t2, t3;
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	upload_surfaces(state);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	if (!wlr_output_attach_render(wlr_output, NULL)) {
+		wlr_log(WLR_ERROR, "Failed to attach renderer to output");
+		wl_display_terminate(state->display);
+		return;
+	}
+
+	float clear_color[4] = { 0.25f, 0.25f, 0.25f, 1.0f };
+	wlr_renderer_begin(state->renderer, wlr_output->width, wlr_output->height);
+	wlr_renderer_clear(state->renderer, clear_color);
+	for (size_t i = 0; i < state->surfaces_len; ++i) {
+		struct bench_surface *surface = &state->surfaces[i];
+		wlr_render_texture(state->renderer, surface->texture,
+			wlr_output->transform_matrix, surface->x, surface->y, 1.0f);
+	}
+	wlr_renderer_end(state->renderer);
+
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+
+	if (!wlr_output_commit(wlr_output)) {
+		wlr_log(WLR_ERROR, "Failed to commit output");
+		wl_display_terminate(state->display);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t3);
+
+	state->upload.values[state->upload.len++] = timespec_diff_ms(&t0, &t1);
+	state->render.values[state->render.len++] = timespec_diff_ms(&t1, &t2);
+	state->commit.values[state->commit.len++] = timespec_diff_ms(&t2, &t3);
+	state->frame++;
+}
+
+static void output_remove_notify(struct wl_listener *listener, void *data) {
+	struct bench_output *bench_output =
+		wl_container_of(listener, bench_output, destroy);
+	wl_list_remove(&bench_output->frame.link);
+	wl_list_remove(&bench_output->destroy.link);
+	free(bench_output);
+}
+
+static void new_output_notify(struct wl_listener *listener, void *data) {
+	struct wlr_output *output = data;
+	struct bench_state *state = wl_container_of(listener, state, new_output);
+	struct bench_output *bench_output = calloc(1, sizeof(*bench_output));
+	if (bench_output == NULL) {
+		return;
+	}
+	bench_output->output = output;
+	bench_output->state = state;
+	bench_output->frame.notify = output_frame_notify;
+	wl_signal_add(&output->events.frame, &bench_output->frame);
+	bench_output->destroy.notify = output_remove_notify;
+	wl_signal_add(&output->events.destroy, &bench_output->destroy);
+
+	// Run as fast as the headless backend allows (1 ms frame timer)
+	wlr_output_set_custom_mode(output, state->output_width,
+		state->output_height, 1000 * 1000);
+	wlr_output_commit(output);
+}
+
+static bool create_surfaces(struct bench_state *state) {
+	state->surfaces = calloc(state->surfaces_len, sizeof(*state->surfaces));
+	if (state->surfaces == NULL) {
+		return false;
+	}
+
+	size_t stride = state->surface_width * 4;
+	for (size_t i = 0; i < state->surfaces_len; ++i) {
+		struct bench_surface *surface = &state->surfaces[i];
+		surface->pixels = calloc(state->surface_height, stride);
+		if (surface->pixels == NULL) {
+			return false;
+		}
+		surface->texture = wlr_texture_from_pixels(state->renderer,
+			DRM_FORMAT_ARGB8888, stride, state->surface_width,
+			state->surface_height, surface->pixels);
+		if (surface->texture == NULL) {
+			return false;
+		}
+
+		// Cascade surfaces over the output
+		int max_x = state->output_width - state->surface_width;
+		int max_y = state->output_height - state->surface_height;
+		surface->x = max_x > 0 ? (int)(i * 32 % (max_x + 1)) : 0;
+		surface->y = max_y > 0 ? (int)(i * 32 % (max_y + 1)) : 0;
+	}
+
+	return true;
+}
+
+static void destroy_surfaces(struct bench_state *state) {
+	if (state->surfaces == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < state->surfaces_len; ++i) {
+		wlr_texture_destroy(state->surfaces[i].texture);
+		free(state->surfaces[i].pixels);
+	}
+	free(state->surfaces);
+}
+
+static bool parse_size(const char *str, int *width, int *height) {
+	return sscanf(str, "%dx%d", width, height) == 2 &&
+		*width > 0 && *height > 0;
+}
+
+static const char usage[] =
+	"usage: headless-bench [options]\n"
+	"  -n <count>   number of surfaces (default: 8)\n"
+	"  -f <count>   number of frames (default: 600)\n"
+	"  -s <WxH>     surface size (default: 512x512)\n"
+	"  -d <WxH>     damaged area per surface and frame (default: 64x64)\n"
+	"  -o <WxH>     output size (default: 1920x1080)\n";
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_ERROR, NULL);
+
+	struct bench_state state = {
+		.surfaces_len = 8,
+		.frames = 600,
+		.surface_width = 512,
+		.surface_height = 512,
+		.damage_width = 64,
+		.damage_height = 64,
+		.output_width = 1920,
+		.output_height = 1080,
+	};
+
+	int c;
+	while ((c = getopt(argc, argv, "n:f:s:d:o:h")) != -1) {
+		switch (c) {
+		case 'n':
+			state.surfaces_len = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			state.frames = strtoul(optarg, NULL, 10);
+			break;
+		case 's':
+			if (!parse_size(optarg, &state.surface_width,
+					&state.surface_height)) {
+				fprintf(stderr, "%s", usage);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'd':
+			if (!parse_size(optarg, &state.damage_width,
+					&state.damage_height)) {
+				fprintf(stderr, "%s", usage);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'o':
+			if (!parse_size(optarg, &state.output_width,
+					&state.output_height)) {
+				fprintf(stderr, "%s", usage);
+				return EXIT_FAILURE;
+			}
+			break;
+		default:
+			fprintf(stderr, "%s", usage);
+			return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (state.damage_width > state.surface_width) {
+		state.damage_width = state.surface_width;
+	}
+	if (state.damage_height > state.surface_height) {
+		state.damage_height = state.surface_height;
+	}
+
+	state.upload.values = calloc(state.frames, sizeof(double));
+	state.render.values = calloc(state.frames, sizeof(double));
+	state.commit.values = calloc(state.frames, sizeof(double));
+	if (state.upload.values == NULL || state.render.values == NULL ||
+			state.commit.values == NULL) {
+		return EXIT_FAILURE;
+	}
+
+	state.display = wl_display_create();
+	struct wlr_backend *backend = wlr_headless_backend_create(state.display);
+	if (backend == NULL) {
+		return EXIT_FAILURE;
+	}
+	state.renderer = wlr_backend_get_renderer(backend);
+
+	int ret = EXIT_FAILURE;
+	if (!create_surfaces(&state)) {
+		fprintf(stderr, "Failed to create surfaces\n");
+		goto out;
+	}
+
+	state.new_output.notify = new_output_notify;
+	wl_signal_add(&backend->events.new_output, &state.new_output);
+	wlr_headless_add_output(backend, state.output_width, state.output_height);
+
+	if (!wlr_backend_start(backend)) {
+		goto out;
+	}
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	wl_display_run(state.display);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double total_ms = timespec_diff_ms(&start, &end);
+	printf("%zu frames, %zu surfaces of %dx%d, %dx%d damage, "
+		"%dx%d output in %.1f ms\n", state.frame, state.surfaces_len,
+		state.surface_width, state.surface_height, state.damage_width,
+		state.damage_height, state.output_width, state.output_height,
+		total_ms);
+	print_samples("upload", &state.upload);
+	print_samples("render", &state.render);
+	print_samples("commit", &state.commit);
+	if (state.frame > 0) {
+		printf("uploaded %" PRIu64 " bytes (%" PRIu64 " per frame)\n",
+			state.upload_bytes, state.upload_bytes / state.frame);
+	}
+	ret = EXIT_SUCCESS;
+
+out:
+	destroy_surfaces(&state);
+	wl_display_destroy(state.display);
+	free(state.upload.values);
+	free(state.render.values);
+	free(state.commit.values);
+	return ret;
+}
@@ -16,6 +16,8 @@
 #include "properties.h"
 #include "renderer.h"
 
+#define WLR_DRM_FB_CACHE_BUCKETS 64
+
 struct wlr_drm_plane {
 	uint32_t type;
 	uint32_t id;
@@ -27,6 +29,8 @@ struct wlr_drm_plane {
 
 	/* Buffer to be submitted to the kernel on the next page-flip */
 	struct wlr_drm_fb *pending_fb;
+	/* Fence signalled when rendering to pending_fb completes, or -1 */
+	int pending_in_fence_fd;
 	/* Buffer submitted to the kernel, will be presented on next vblank */
 	struct wlr_drm_fb *queued_fb;
 	/* Buffer currently displayed on screen */
@@ -34,10 +38,30 @@ struct wlr_drm_plane {
 
 	struct wlr_drm_format_set formats;
 
+	// Only used on multi-GPU setups by primary planes
+	/* Whether parent GPU buffers are known to be scanned out directly, or need
+	 * to be copied. NONE if this hasn't been tested yet. */
+	enum wlr_drm_mgpu_path mgpu_path;
+	/* Whether pending_fb has been imported directly from the parent GPU */
+	bool mgpu_pending_direct;
+
 	// Only used by cursor
 	bool cursor_enabled;
 	int32_t cursor_hotspot_x, cursor_hotspot_y;
 
+	// Only used by overlays
+	uint32_t possible_crtcs;
+	uint64_t zpos;
+	/* CRTC the plane is used by, NULL if the plane is free */
+	struct wlr_drm_crtc *crtc;
+	/* Layer to be displayed on the next page-flip */
+	struct wlr_output_layer_state *pending_layer;
+	/* Layer currently displayed, NULL if the plane needs to be disabled */
+	struct wlr_output_layer *layer;
+	/* The plane has been disabled, release it on the next page-flip */
+	bool release_pending;
+	struct wl_listener layer_destroy;
+
 	union wlr_drm_plane_props props;
 };
 
@@ -72,6 +96,8 @@ struct wlr_drm_backend {
 	const struct wlr_drm_interface *iface;
 	clockid_t clock;
 	bool addfb2_modifiers;
+	// Whether atomic commits can use DRM_MODE_PAGE_FLIP_ASYNC
+	bool atomic_async_page_flip;
 
 	int fd;
 	char *name;
@@ -80,6 +106,10 @@ struct wlr_drm_backend {
 	size_t num_crtcs;
 	struct wlr_drm_crtc *crtcs;
 
+	// Sorted by increasing zpos
+	size_t num_overlays;
+	struct wlr_drm_plane *overlays;
+
 	struct wl_display *display;
 	struct wl_event_source *drm_event;
 
@@ -88,7 +118,15 @@ struct wlr_drm_backend {
 	struct wl_listener session_active;
 	struct wl_listener dev_change;
 
+	// Framebuffer cache: a hash table keyed by wlr_buffer, and a list sorted
+	// by most recent use for eviction
 	struct wl_list fbs; // wlr_drm_fb.link
+	struct wl_list fb_buckets[WLR_DRM_FB_CACHE_BUCKETS]; // wlr_drm_fb.bucket_link
+	struct wlr_drm_fb_cache_stats fb_cache_stats;
+	size_t unused_fbs; // cached FBs not referenced by any plane
+	// Framebuffers waiting for drmModeRmFB, released when idle
+	struct wl_list dead_fbs; // wlr_drm_fb.link
+	struct wl_event_source *dead_fbs_idle;
 	struct wl_list outputs;
 
 	struct wlr_drm_renderer renderer;
@@ -109,6 +147,19 @@ struct wlr_drm_mode {
 	drmModeModeInfo drm_mode;
 };
 
+/**
+ * Timing model used to decide whether to tear in the adaptive present mode.
+ */
+struct wlr_drm_adaptive_present {
+	struct timespec last_vblank; // last vsynced page-flip, backend clock
+	struct timespec last_present; // last page-flip, torn or not
+	struct timespec last_commit;
+	int64_t frame_interval; // nsec, moving average of page-flip intervals
+	bool late; // the last page-flip missed its vblank
+	bool tear; // whether the next page-flip should be async
+	bool flip_torn; // whether the pending page-flip is async
+};
+
 struct wlr_drm_connector {
 	struct wlr_output output; // only valid if state != DISCONNECTED
 
@@ -124,7 +175,7 @@ struct wlr_drm_connector {
 
 	union wlr_drm_connector_props props;
 
-	struct timespec next_present;
+	struct wlr_drm_adaptive_present adaptive_present;
 
 	int32_t cursor_x, cursor_y;
 	bool cursor_visible;
@@ -156,10 +207,15 @@ bool drm_connector_set_mode(struct wlr_drm_connector *conn,
 	struct wlr_output_mode *mode);
 bool drm_connector_is_cursor_visible(struct wlr_drm_connector *conn);
 bool drm_connector_supports_vrr(struct wlr_drm_connector *conn);
+bool drm_connector_wants_async_page_flip(struct wlr_drm_connector *conn);
 size_t drm_crtc_get_gamma_lut_size(struct wlr_drm_backend *drm,
 	struct wlr_drm_crtc *crtc);
 
 struct wlr_drm_fb *plane_get_next_fb(struct wlr_drm_plane *plane);
+void drm_plane_set_in_fence(struct wlr_drm_plane *plane, int fd);
+void drm_overlay_plane_release(struct wlr_drm_plane *plane);
+bool drm_connector_overlay_needs_disable(struct wlr_drm_connector *conn,
+	struct wlr_drm_plane *plane);
 
 #define wlr_drm_conn_log(conn, verb, fmt, ...) \
 	wlr_log(verb, "connector %s: " fmt, conn->name, ##__VA_ARGS__)
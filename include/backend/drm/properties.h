@@ -46,6 +46,7 @@ union wlr_drm_plane_props {
 		uint32_t type;
 		uint32_t rotation; // Not guaranteed to exist
 		uint32_t in_formats; // Not guaranteed to exist
+		uint32_t zpos; // Not guaranteed to exist
 
 		// atomic-modesetting only
 
@@ -59,8 +60,9 @@ union wlr_drm_plane_props {
 		uint32_t crtc_h;
 		uint32_t fb_id;
 		uint32_t crtc_id;
+		uint32_t in_fence_fd; // Not guaranteed to exist
 	};
-	uint32_t props[13];
+	uint32_t props[15];
 };
 
 bool get_drm_connector_props(int fd, uint32_t id,
@@ -30,8 +30,11 @@ struct wlr_drm_surface {
 };
 
 struct wlr_drm_fb {
+	struct wlr_drm_backend *backend;
 	struct wlr_buffer *wlr_buf;
-	struct wl_list link; // wlr_drm_backend.fbs
+	struct wl_list link; // wlr_drm_backend.fbs or wlr_drm_backend.dead_fbs
+	struct wl_list bucket_link; // wlr_drm_backend.fb_buckets
+	size_t n_refs; // number of plane slots referencing this FB
 
 	struct gbm_bo *bo;
 	uint32_t id;
@@ -49,6 +52,7 @@ void drm_surface_unset_current(struct wlr_drm_surface *surf);
 bool drm_fb_import(struct wlr_drm_fb **fb, struct wlr_drm_backend *drm,
 		struct wlr_buffer *buf, const struct wlr_drm_format_set *formats);
 void drm_fb_destroy(struct wlr_drm_fb *fb);
+void drm_fb_destroy_dead(struct wlr_drm_backend *drm);
 
 void drm_fb_clear(struct wlr_drm_fb **fb);
 void drm_fb_move(struct wlr_drm_fb **new, struct wlr_drm_fb **old);
@@ -59,6 +63,8 @@ bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 		struct wlr_drm_backend *drm, int32_t width, uint32_t height,
 		uint32_t format, bool with_modifiers);
 void drm_plane_finish_surface(struct wlr_drm_plane *plane);
+bool drm_plane_mgpu_fallback_blit(struct wlr_drm_plane *plane,
+	struct wlr_drm_backend *drm);
 bool drm_plane_lock_surface(struct wlr_drm_plane *plane,
 		struct wlr_drm_backend *drm);
 
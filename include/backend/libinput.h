@@ -2,6 +2,9 @@
 #define BACKEND_LIBINPUT_H
 
 #include <libinput.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/backend/interface.h>
 #include <wlr/backend/libinput.h>
@@ -9,6 +12,61 @@
 #include <wlr/types/wlr_input_device.h>
 #include <wlr/types/wlr_list.h>
 
+#define WLR_LIBINPUT_RING_SIZE 256
+
+struct wlr_libinput_queued_event {
+	struct libinput_event *event;
+	struct timespec read_time;
+};
+
+/**
+ * Single-producer single-consumer ring of libinput events.
+ */
+struct wlr_libinput_event_ring {
+	struct wlr_libinput_queued_event items[WLR_LIBINPUT_RING_SIZE];
+	atomic_size_t head; // written by the producer
+	atomic_size_t tail; // written by the consumer
+};
+
+/**
+ * Optional thread reading libinput, enabled with WLR_LIBINPUT_THREAD=1.
+ *
+ * The input thread dispatches the libinput context and hands the events over
+ * to the main thread through a lock-free ring. Events are handled on the main
+ * thread, then handed back to the input thread to be destroyed. Anything else
+ * touching the libinput context (device hotplug, LEDs, session changes) locks
+ * it with input_thread_lock_context.
+ */
+struct wlr_libinput_input_thread {
+	struct wlr_libinput_backend *backend;
+
+	pthread_t thread;
+	atomic_bool stop;
+
+	struct wlr_libinput_event_ring events; // input thread -> main thread
+	struct wlr_libinput_event_ring done; // main thread -> input thread
+	atomic_bool ring_full;
+
+	int wake_fd; // eventfd waking up the input thread
+	int notify_fd; // eventfd waking up the main thread
+	struct wl_event_source *notify_source;
+
+	// Protects the context ownership and the forwarded requests
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	// The input thread owns the context while it dispatches libinput, the
+	// main thread may lock it recursively
+	bool context_input_owned;
+	int context_main_depth;
+	// open_restricted/close_restricted calls forwarded to the main thread,
+	// which owns the session
+	struct {
+		bool pending;
+		const char *path; // NULL to close fd
+		int fd;
+	} request;
+};
+
 struct wlr_libinput_backend {
 	struct wlr_backend backend;
 
@@ -17,6 +75,7 @@ struct wlr_libinput_backend {
 
 	struct libinput *libinput_context;
 	struct wl_event_source *input_event;
+	struct wlr_libinput_input_thread *input_thread; // may be NULL
 
 	struct wl_listener display_destroy;
 	struct wl_listener session_destroy;
@@ -33,6 +92,29 @@ struct wlr_libinput_input_device {
 
 uint32_t usec_to_msec(uint64_t usec);
 
+int libinput_backend_open_file(struct wlr_libinput_backend *backend,
+	const char *path);
+void libinput_backend_close_file(struct wlr_libinput_backend *backend, int fd);
+
+struct wlr_libinput_input_thread *input_thread_create(
+	struct wlr_libinput_backend *backend);
+void input_thread_destroy(struct wlr_libinput_input_thread *thread);
+/**
+ * Returns true if called from the input thread.
+ */
+bool input_thread_is_current(struct wlr_libinput_input_thread *thread);
+/**
+ * Forward an open_restricted (path != NULL) or close_restricted call from the
+ * input thread to the main thread, and wait for the result.
+ */
+int input_thread_forward_request(struct wlr_libinput_input_thread *thread,
+	const char *path, int fd);
+/**
+ * Lock the libinput context from the main thread.
+ */
+void input_thread_lock_context(struct wlr_libinput_input_thread *thread);
+void input_thread_unlock_context(struct wlr_libinput_input_thread *thread);
+
 void handle_libinput_event(struct wlr_libinput_backend *state,
 		struct libinput_event *event);
 
@@ -21,6 +21,16 @@ struct wlr_gles2_pixel_format {
 	bool has_alpha;
 };
 
+// Uniform values last uploaded to a program. Programs keep their uniforms
+// until they are set again, so this outlives render passes.
+struct wlr_gles2_uniform_cache {
+	bool has_proj, has_color, has_alpha, has_invert_y;
+	GLfloat proj[9];
+	GLfloat color[4];
+	GLfloat alpha;
+	GLint invert_y;
+};
+
 struct wlr_gles2_tex_shader {
 	GLuint program;
 	GLint proj;
@@ -29,6 +39,7 @@ struct wlr_gles2_tex_shader {
 	GLint alpha;
 	GLint pos_attrib;
 	GLint tex_attrib;
+	struct wlr_gles2_uniform_cache uniforms;
 };
 
 struct wlr_gles2_renderer {
@@ -43,6 +54,7 @@ struct wlr_gles2_renderer {
 		bool debug_khr;
 		bool egl_image_external_oes;
 		bool egl_image_oes;
+		bool pixel_buffer_object; // GLES 3.0
 	} exts;
 
 	struct {
@@ -52,6 +64,8 @@ struct wlr_gles2_renderer {
 		PFNGLPOPDEBUGGROUPKHRPROC glPopDebugGroupKHR;
 		PFNGLPUSHDEBUGGROUPKHRPROC glPushDebugGroupKHR;
 		PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC glEGLImageTargetRenderbufferStorageOES;
+		PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange;
+		PFNGLUNMAPBUFFEROESPROC glUnmapBuffer;
 	} procs;
 
 	struct {
@@ -60,6 +74,7 @@ struct wlr_gles2_renderer {
 			GLint proj;
 			GLint color;
 			GLint pos_attrib;
+			struct wlr_gles2_uniform_cache uniforms;
 		} quad;
 		struct {
 			GLuint program;
@@ -67,6 +82,7 @@ struct wlr_gles2_renderer {
 			GLint color;
 			GLint pos_attrib;
 			GLint tex_attrib;
+			struct wlr_gles2_uniform_cache uniforms;
 		} ellipse;
 		struct wlr_gles2_tex_shader tex_rgba;
 		struct wlr_gles2_tex_shader tex_rgbx;
@@ -74,9 +90,32 @@ struct wlr_gles2_renderer {
 	} shaders;
 
 	struct wl_list buffers; // wlr_gles2_buffer.link
+	struct wl_list readbacks; // wlr_gles2_readback.link
+
+	struct wl_event_loop *event_loop; // set by init_wl_display
 
 	struct wlr_gles2_buffer *current_buffer;
 	uint32_t viewport_width, viewport_height;
+
+	// Vertices of region draws, see gles2_render_subtexture_region_with_matrix
+	GLuint region_vbo;
+	GLfloat *region_verts;
+	size_t region_verts_cap; // in floats
+
+	// GL state set by the renderer during a render pass, used to skip
+	// redundant state changes. Reset by gles2_begin, 0 means unknown.
+	struct {
+		GLuint program;
+		GLenum texture_target;
+		GLuint texture;
+		bool blend;
+		bool scissor;
+		struct wlr_box scissor_box;
+		uint32_t attribs; // bitmask of enabled vertex attrib arrays
+	} state;
+
+	size_t draw_calls; // since the last begin
+	size_t gl_calls; // since the last begin
 };
 
 struct wlr_gles2_buffer {
@@ -91,6 +130,21 @@ struct wlr_gles2_buffer {
 	struct wl_listener buffer_destroy;
 };
 
+struct wlr_gles2_readback {
+	struct wlr_renderer_readback base;
+	struct wlr_gles2_renderer *renderer;
+	struct wl_list link; // wlr_gles2_renderer.readbacks
+
+	GLuint pbo;
+	uint32_t stride, height;
+
+	int fence_fd;
+	struct wl_event_source *fence_source;
+
+	wlr_renderer_read_pixels_func_t done;
+	void *data;
+};
+
 struct wlr_gles2_texture {
 	struct wlr_texture wlr_texture;
 	struct wlr_gles2_renderer *renderer;
@@ -128,6 +182,22 @@ struct wlr_texture *gles2_texture_from_wl_drm(struct wlr_renderer *wlr_renderer,
 struct wlr_texture *gles2_texture_from_dmabuf(struct wlr_renderer *wlr_renderer,
 	struct wlr_dmabuf_attributes *attribs);
 
+/**
+ * Forget the cached texture binding, after binding or deleting textures
+ * behind the renderer's back.
+ */
+void gles2_invalidate_texture_state(struct wlr_gles2_renderer *renderer);
+
+/**
+ * Issue a GL call during a render pass, counted by
+ * wlr_gles2_renderer_get_gl_calls.
+ */
+#define gles2_call(renderer, call) \
+	do { \
+		call; \
+		(renderer)->gl_calls++; \
+	} while (0)
+
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
 	const char *file, const char *func);
 #define push_gles2_debug(renderer) push_gles2_debug_(renderer, _WLR_FILENAME, __func__)
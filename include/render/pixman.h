@@ -0,0 +1,54 @@
+#ifndef RENDER_PIXMAN_H
+#define RENDER_PIXMAN_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <wlr/render/drm_format_set.h>
+#include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/render/wlr_texture.h>
+
+struct wlr_pixman_pixel_format {
+	uint32_t drm_format;
+	pixman_format_code_t pixman_format;
+};
+
+struct wlr_pixman_renderer {
+	struct wlr_renderer wlr_renderer;
+
+	struct wl_list buffers; // wlr_pixman_buffer.link
+
+	struct wlr_pixman_buffer *current_buffer;
+	int32_t width, height;
+
+	struct wlr_drm_format_set render_formats;
+};
+
+struct wlr_pixman_buffer {
+	struct wlr_buffer *buffer;
+	struct wlr_pixman_renderer *renderer;
+	struct wl_list link; // wlr_pixman_renderer.buffers
+
+	pixman_image_t *image;
+	const struct wlr_pixman_pixel_format *format;
+
+	struct wl_listener buffer_destroy;
+};
+
+struct wlr_pixman_texture {
+	struct wlr_texture wlr_texture;
+	struct wlr_pixman_renderer *renderer;
+
+	pixman_image_t *image;
+	const struct wlr_pixman_pixel_format *format;
+	void *data;
+	uint32_t stride;
+};
+
+const struct wlr_pixman_pixel_format *get_pixman_format_from_drm(
+	uint32_t fmt);
+const uint32_t *get_pixman_shm_formats(size_t *len);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef RENDER_SHM_ALLOCATOR_H
+#define RENDER_SHM_ALLOCATOR_H
+
+#include <wlr/types/wlr_buffer.h>
+#include "render/allocator.h"
+
+struct wlr_shm_buffer {
+	struct wlr_buffer base;
+
+	int fd;
+	void *data;
+	size_t size;
+	uint32_t format;
+	size_t stride;
+};
+
+struct wlr_shm_allocator {
+	struct wlr_allocator base;
+};
+
+/**
+ * Creates a new shared memory allocator.
+ *
+ * Buffers are backed by anonymous shared memory files and mapped in the
+ * compositor's address space, see wlr_buffer_get_data_ptr.
+ */
+struct wlr_shm_allocator *wlr_shm_allocator_create(void);
+
+#endif
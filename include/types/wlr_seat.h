@@ -13,6 +13,17 @@ void seat_client_create_pointer(struct wlr_seat_client *seat_client,
 void seat_client_destroy_pointer(struct wl_resource *resource);
 void seat_client_send_pointer_leave_raw(struct wlr_seat_client *seat_client,
 	struct wlr_surface *surface);
+/**
+ * Send the pointer frame being coalesced, if any.
+ */
+void seat_pointer_flush(struct wlr_seat *seat);
+/**
+ * Add a relative motion event to the pointer frame being coalesced. Returns
+ * false if the seat doesn't coalesce motion: the event must be sent right
+ * away. Otherwise, the caller must send the accumulated motion when the
+ * pointer_state.batch.flush signal is emitted.
+ */
+bool seat_pointer_coalesce_relative_motion(struct wlr_seat *seat);
 
 void seat_client_create_keyboard(struct wlr_seat_client *seat_client,
 	uint32_t version, uint32_t id);
@@ -87,6 +87,12 @@ void add_tablet_tool_client(struct wlr_tablet_seat_client_v2 *seat, struct wlr_t
 
 struct wlr_tablet_seat_client_v2 *tablet_seat_client_from_resource(struct wl_resource *resource);
 void tablet_seat_client_v2_destroy(struct wl_resource *resource);
+/**
+ * Send the pointer frame being coalesced on the seat, if any, so that it
+ * reaches the client before the tablet event about to be sent.
+ */
+void tablet_seat_client_v2_flush_pointer(
+	struct wlr_tablet_seat_client_v2 *seat);
 struct wlr_tablet_seat_v2 *get_or_create_tablet_seat(
 	struct wlr_tablet_manager_v2 *manager,
 	struct wlr_seat *wlr_seat);
@@ -1,7 +1,14 @@
 #ifndef UTIL_SHM_H
 #define UTIL_SHM_H
 
+#include <stddef.h>
+
 int create_shm_file(void);
 int allocate_shm_file(size_t size);
+/**
+ * Create a shared memory file holding a copy of data. The returned FD can
+ * only be used to read the file, and can be shared with several clients.
+ */
+int create_readonly_shm_file(const void *data, size_t size);
 
 #endif
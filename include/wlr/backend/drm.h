@@ -33,6 +33,38 @@ bool wlr_output_is_drm(struct wlr_output *output);
  */
 uint32_t wlr_drm_connector_get_id(struct wlr_output *output);
 
+/**
+ * How frames rendered on the parent GPU reach a multi-GPU output.
+ */
+enum wlr_drm_mgpu_path {
+	// Not a multi-GPU output, or no frame has been displayed yet
+	WLR_DRM_MGPU_PATH_NONE,
+	// Parent GPU buffers are scanned out directly by the secondary GPU
+	WLR_DRM_MGPU_PATH_DIRECT,
+	// Parent GPU buffers are copied by the secondary GPU
+	WLR_DRM_MGPU_PATH_BLIT,
+};
+
+/**
+ * Get the path taken by frames displayed on a multi-GPU output.
+ */
+enum wlr_drm_mgpu_path wlr_drm_connector_get_mgpu_path(
+	struct wlr_output *output);
+
+/**
+ * Statistics for the cache of KMS framebuffers imported from buffers.
+ */
+struct wlr_drm_fb_cache_stats {
+	size_t size; // number of cached framebuffers
+	uint64_t hits, misses, evictions;
+};
+
+/**
+ * Get statistics for the DRM backend's framebuffer cache.
+ */
+void wlr_drm_backend_get_fb_cache_stats(struct wlr_backend *backend,
+	struct wlr_drm_fb_cache_stats *stats);
+
 /**
  * Add mode to the list of available modes
  */
@@ -16,6 +16,9 @@
 /**
  * Creates a headless backend. A headless backend has no outputs or inputs by
  * default.
+ *
+ * If no DRM render node is available, the backend falls back to the pixman
+ * software renderer and shared memory buffers.
  */
 struct wlr_backend *wlr_headless_backend_create(struct wl_display *display);
 /**
@@ -24,7 +27,7 @@ struct wlr_backend *wlr_headless_backend_create(struct wl_display *display);
 struct wlr_backend *wlr_headless_backend_create_with_renderer(
 	struct wl_display *display, struct wlr_renderer *renderer);
 /**
- * Create a new headless output backed by an in-memory EGL framebuffer. You can
+ * Create a new headless output backed by an in-memory framebuffer. You can
  * read pixels from this framebuffer via wlr_renderer_read_pixels but it is
  * otherwise not displayed.
  */
@@ -49,6 +49,8 @@ struct wlr_egl {
 		bool image_dma_buf_export_mesa;
 		bool image_dmabuf_import_ext;
 		bool image_dmabuf_import_modifiers_ext;
+		bool native_fence_sync_android;
+		bool wait_sync_khr;
 
 		// Device extensions
 		bool device_drm_ext;
@@ -68,6 +70,10 @@ struct wlr_egl {
 		PFNEGLDEBUGMESSAGECONTROLKHRPROC eglDebugMessageControlKHR;
 		PFNEGLQUERYDISPLAYATTRIBEXTPROC eglQueryDisplayAttribEXT;
 		PFNEGLQUERYDEVICESTRINGEXTPROC eglQueryDeviceStringEXT;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
+		PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
 	} procs;
 
 	struct wl_display *wl_display;
@@ -155,4 +161,22 @@ bool wlr_egl_restore_context(struct wlr_egl_context *context);
 
 int wlr_egl_dup_drm_fd(struct wlr_egl *egl);
 
+/**
+ * Insert a fence after the commands submitted so far and export it as a
+ * sync_file FD, which becomes readable once the GPU has executed them. The EGL
+ * context must be current.
+ *
+ * Returns -1 on error or if EGL_ANDROID_native_fence_sync isn't supported.
+ */
+int wlr_egl_create_fence_fd(struct wlr_egl *egl);
+
+/**
+ * Make the GPU wait for a sync_file FD to signal before executing commands
+ * submitted afterwards. The CPU doesn't block. The EGL context must be
+ * current. The FD is not consumed.
+ *
+ * Returns false on error or if EGL_KHR_wait_sync isn't supported.
+ */
+bool wlr_egl_wait_fence_fd(struct wlr_egl *egl, int fd);
+
 #endif
@@ -20,6 +20,23 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl);
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *renderer);
 bool wlr_gles2_renderer_check_ext(struct wlr_renderer *renderer,
 	const char *ext);
+/**
+ * Get the number of draw calls issued since the last wlr_renderer_begin().
+ * After wlr_renderer_end(), this is the draw call count of the last frame.
+ */
+size_t wlr_gles2_renderer_get_draw_calls(struct wlr_renderer *renderer);
+/**
+ * Get the number of GL calls issued by render operations since the last
+ * wlr_renderer_begin(). Redundant state changes are skipped and not counted.
+ */
+size_t wlr_gles2_renderer_get_gl_calls(struct wlr_renderer *renderer);
+/**
+ * The renderer caches the GL state it sets during a render pass, and the
+ * uniforms of its programs. Compositors issuing their own GL calls between
+ * wlr_renderer_begin() and wlr_renderer_end(), or changing uniforms of the
+ * renderer's programs, must call this before rendering with wlroots again.
+ */
+void wlr_gles2_renderer_invalidate_state(struct wlr_renderer *renderer);
 
 struct wlr_gles2_texture_attribs {
 	GLenum target; /* either GL_TEXTURE_2D or GL_TEXTURE_EXTERNAL_OES */
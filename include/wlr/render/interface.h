@@ -9,6 +9,7 @@
 #ifndef WLR_RENDER_INTERFACE_H
 #define WLR_RENDER_INTERFACE_H
 
+#include <pixman.h>
 #include <stdbool.h>
 #include <wayland-server-core.h>
 #include <wlr/render/wlr_renderer.h>
@@ -28,6 +29,10 @@ struct wlr_renderer_impl {
 	bool (*render_subtexture_with_matrix)(struct wlr_renderer *renderer,
 		struct wlr_texture *texture, const struct wlr_fbox *box,
 		const float matrix[static 9], float alpha);
+	bool (*render_subtexture_region_with_matrix)(
+		struct wlr_renderer *renderer, struct wlr_texture *texture,
+		const struct wlr_fbox *box, const float matrix[static 9],
+		float alpha, pixman_region32_t *region);
 	void (*render_quad_with_matrix)(struct wlr_renderer *renderer,
 		const float color[static 4], const float matrix[static 9]);
 	void (*render_ellipse_with_matrix)(struct wlr_renderer *renderer,
@@ -59,19 +64,38 @@ struct wlr_renderer_impl {
 		struct wl_display *wl_display);
 	bool (*blit_dmabuf)(struct wlr_renderer *renderer,
 		struct wlr_dmabuf_attributes *dst,
-		struct wlr_dmabuf_attributes *src);
+		struct wlr_dmabuf_attributes *src,
+		const struct wlr_box *src_box);
 	int (*get_drm_fd)(struct wlr_renderer *renderer);
+	struct wlr_renderer_readback *(*read_pixels_async)(
+		struct wlr_renderer *renderer, uint32_t fmt, uint32_t width,
+		uint32_t height, uint32_t src_x, uint32_t src_y,
+		wlr_renderer_read_pixels_func_t done, void *data);
+	void (*cancel_readback)(struct wlr_renderer_readback *readback);
+	int (*create_fence_fd)(struct wlr_renderer *renderer);
+	bool (*wait_fence_fd)(struct wlr_renderer *renderer, int fd);
 };
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
 	const struct wlr_renderer_impl *impl);
 
+/**
+ * A pending asynchronous readback, see wlr_renderer_read_pixels_async.
+ * Renderers embed it in their own readback state.
+ */
+struct wlr_renderer_readback {
+	struct wlr_renderer *renderer;
+};
+
 struct wlr_texture_impl {
 	bool (*is_opaque)(struct wlr_texture *texture);
 	bool (*write_pixels)(struct wlr_texture *texture,
 		uint32_t stride, uint32_t width, uint32_t height,
 		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 		const void *data);
+	bool (*write_pixels_boxes)(struct wlr_texture *texture, uint32_t stride,
+		const pixman_box32_t *boxes, size_t boxes_len, const void *data,
+		size_t *uploaded_bytes);
 	bool (*to_dmabuf)(struct wlr_texture *texture,
 		struct wlr_dmabuf_attributes *attribs);
 	void (*destroy)(struct wlr_texture *texture);
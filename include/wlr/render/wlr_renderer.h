@@ -20,6 +20,7 @@ enum wlr_renderer_read_pixels_flags {
 };
 
 struct wlr_renderer_impl;
+struct wlr_renderer_readback;
 struct wlr_drm_format_set;
 struct wlr_buffer;
 
@@ -61,6 +62,25 @@ bool wlr_render_texture_with_matrix(struct wlr_renderer *r,
 bool wlr_render_subtexture_with_matrix(struct wlr_renderer *r,
 	struct wlr_texture *texture, const struct wlr_fbox *box,
 	const float matrix[static 9], float alpha);
+/**
+ * Renders the requested texture using the provided matrix, clipped to the
+ * provided region. The region is in the same coordinate space as
+ * wlr_renderer_scissor() boxes.
+ *
+ * This is equivalent to calling wlr_renderer_scissor() and
+ * wlr_render_texture_with_matrix() for each rectangle of the region, but
+ * renderers may draw all rectangles at once. The scissor box is reset.
+ */
+bool wlr_render_texture_region_with_matrix(struct wlr_renderer *r,
+	struct wlr_texture *texture, const float matrix[static 9], float alpha,
+	pixman_region32_t *region);
+/**
+ * Same as wlr_render_texture_region_with_matrix(), after cropping the texture
+ * to the provided rectangle.
+ */
+bool wlr_render_subtexture_region_with_matrix(struct wlr_renderer *r,
+	struct wlr_texture *texture, const struct wlr_fbox *box,
+	const float matrix[static 9], float alpha, pixman_region32_t *region);
 /**
  * Renders a solid rectangle in the specified color.
  */
@@ -114,11 +134,45 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, uint32_t fmt,
 	uint32_t *flags, uint32_t stride, uint32_t width, uint32_t height,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
 
+/**
+ * Callback invoked when an asynchronous pixel readback completes. `data`
+ * points to `height` rows of `stride` bytes each and is only valid during the
+ * call. On failure, `data` is NULL.
+ *
+ * `flags` is a bitfield of `enum wlr_renderer_read_pixels_flags`.
+ */
+typedef void (*wlr_renderer_read_pixels_func_t)(const void *data,
+	uint32_t stride, uint32_t flags, void *user_data);
+/**
+ * Starts reading out pixels of the currently bound surface without waiting for
+ * the GPU. `done` is called from the event loop once the pixels are available.
+ *
+ * Returns NULL if the renderer doesn't support asynchronous readback, in which
+ * case callers should fall back to wlr_renderer_read_pixels.
+ */
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+	struct wlr_renderer *r, uint32_t fmt, uint32_t width, uint32_t height,
+	uint32_t src_x, uint32_t src_y, wlr_renderer_read_pixels_func_t done,
+	void *user_data);
+/**
+ * Cancels a pending asynchronous readback. The callback won't be invoked. Must
+ * not be called once the callback has been invoked.
+ */
+void wlr_renderer_readback_cancel(struct wlr_renderer_readback *readback);
+
 /**
  * Blits the dmabuf in src onto the one in dst.
  */
 bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 	struct wlr_dmabuf_attributes *dst, struct wlr_dmabuf_attributes *src);
+/**
+ * Blits the rectangle `src_box` of the dmabuf in src onto the whole dmabuf in
+ * dst. `src_box` is in buffer-local coordinates of src and must have the same
+ * size as dst.
+ */
+bool wlr_renderer_blit_dmabuf_region(struct wlr_renderer *r,
+	struct wlr_dmabuf_attributes *dst, struct wlr_dmabuf_attributes *src,
+	const struct wlr_box *src_box);
 /**
  * Creates necessary shm and invokes the initialization of the implementation.
  *
@@ -134,6 +188,24 @@ bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
  */
 int wlr_renderer_get_drm_fd(struct wlr_renderer *r);
 
+/**
+ * Export a sync_file FD which signals once the rendering commands submitted
+ * so far have completed. Must be called while a buffer is bound, and the
+ * caller takes ownership of the FD.
+ *
+ * Returns -1 if the renderer doesn't support explicit synchronization, in
+ * which case callers rely on implicit synchronization.
+ */
+int wlr_renderer_create_fence_fd(struct wlr_renderer *r);
+/**
+ * Make subsequent rendering commands wait for a sync_file FD to signal,
+ * without blocking the CPU. Must be called between wlr_renderer_begin and
+ * wlr_renderer_end. The FD is not consumed.
+ *
+ * Returns false if the renderer doesn't support waiting on fences.
+ */
+bool wlr_renderer_wait_fence_fd(struct wlr_renderer *r, int fd);
+
 /**
  * Destroys this wlr_renderer. Textures must be destroyed separately.
  */
@@ -9,6 +9,7 @@
 #ifndef WLR_RENDER_WLR_TEXTURE_H
 #define WLR_RENDER_WLR_TEXTURE_H
 
+#include <pixman.h>
 #include <stdint.h>
 #include <wayland-server-core.h>
 #include <wlr/render/dmabuf.h>
@@ -76,6 +77,23 @@ bool wlr_texture_write_pixels(struct wlr_texture *texture,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
 	const void *data);
 
+/**
+ * Update the part of a texture covered by `region` with raw pixels. `data`
+ * must have the same size and pixel format as the texture. The texture must be
+ * mutable.
+ *
+ * Neighbouring rectangles of the region are merged when uploading a few extra
+ * pixels is cheaper than issuing another upload, and the remaining rectangles
+ * are uploaded in a single pass. If `uploaded_bytes` isn't NULL, it's set to
+ * the number of bytes transferred.
+ *
+ * Should not be called in a rendering block like renderer_begin()/end() or
+ * between attaching a renderer to an output and committing it.
+ */
+bool wlr_texture_write_pixels_region(struct wlr_texture *texture,
+	uint32_t stride, pixman_region32_t *region, const void *data,
+	size_t *uploaded_bytes);
+
 bool wlr_texture_to_dmabuf(struct wlr_texture *texture,
 	struct wlr_dmabuf_attributes *attribs);
 
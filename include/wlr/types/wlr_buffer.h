@@ -19,6 +19,8 @@ struct wlr_buffer_impl {
 	void (*destroy)(struct wlr_buffer *buffer);
 	bool (*get_dmabuf)(struct wlr_buffer *buffer,
 		struct wlr_dmabuf_attributes *attribs);
+	bool (*get_data_ptr)(struct wlr_buffer *buffer, void **data,
+		uint32_t *format, size_t *stride);
 };
 
 /**
@@ -76,6 +78,14 @@ void wlr_buffer_unlock(struct wlr_buffer *buffer);
  */
 bool wlr_buffer_get_dmabuf(struct wlr_buffer *buffer,
 	struct wlr_dmabuf_attributes *attribs);
+/**
+ * Get a pointer to the buffer's pixels, along with their DRM format and
+ * stride in bytes. If the buffer isn't accessible from the CPU, returns false.
+ *
+ * The pointer is valid for the lifetime of the wlr_buffer.
+ */
+bool wlr_buffer_get_data_ptr(struct wlr_buffer *buffer, void **data,
+	uint32_t *format, size_t *stride);
 
 /**
  * A client buffer.
@@ -96,6 +106,11 @@ struct wlr_client_buffer {
 	 * client destroys the buffer before it has been released.
 	 */
 	struct wlr_texture *texture;
+	/**
+	 * Number of bytes uploaded to the texture by the last commit. Only
+	 * relevant for wl_shm buffers, zero otherwise.
+	 */
+	size_t upload_bytes;
 
 	struct wl_listener resource_destroy;
 	struct wl_listener release;
@@ -0,0 +1,112 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_LINUX_EXPLICIT_SYNCHRONIZATION_V1_H
+#define WLR_TYPES_WLR_LINUX_EXPLICIT_SYNCHRONIZATION_V1_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+
+struct wlr_buffer;
+struct wlr_renderer;
+struct wlr_surface;
+
+struct wlr_linux_surface_synchronization_v1_state;
+
+/**
+ * A request from the client to be notified when the compositor is done
+ * reading a buffer.
+ */
+struct wlr_linux_buffer_release_v1 {
+	struct wl_resource *resource;
+	int fence_fd; // -1 if unset
+
+	// private state
+
+	// the state referencing this release, NULL once the buffer is replaced
+	struct wlr_linux_surface_synchronization_v1_state *state;
+	struct wlr_buffer *buffer; // waited on once the buffer is replaced
+
+	struct wl_listener buffer_release;
+	struct wl_listener buffer_destroy;
+};
+
+struct wlr_linux_surface_synchronization_v1_state {
+	int acquire_fence_fd; // -1 if unset
+	struct wlr_linux_buffer_release_v1 *buffer_release; // may be NULL
+};
+
+/**
+ * Explicit synchronization state of a surface.
+ *
+ * The acquire fence of the current state is signalled once the client is done
+ * writing to the current buffer. The release fence is provided by the
+ * compositor, and is sent to the client once the buffer has been replaced and
+ * released by all consumers (e.g. once it isn't scanned out anymore).
+ */
+struct wlr_linux_surface_synchronization_v1 {
+	struct wl_resource *resource;
+	struct wlr_surface *surface;
+
+	struct wlr_linux_surface_synchronization_v1_state pending, current;
+
+	struct wl_listener surface_destroy;
+	struct wl_listener surface_precommit;
+};
+
+struct wlr_linux_explicit_synchronization_v1 {
+	struct wl_global *global;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct wl_listener display_destroy;
+};
+
+struct wlr_linux_explicit_synchronization_v1 *
+	wlr_linux_explicit_synchronization_v1_create(struct wl_display *display);
+
+/**
+ * Get the explicit synchronization state of a surface. Returns NULL if the
+ * client doesn't use explicit synchronization for this surface.
+ */
+struct wlr_linux_surface_synchronization_v1 *
+	wlr_linux_surface_synchronization_v1_from_surface(
+	struct wlr_surface *surface);
+
+/**
+ * Make the renderer wait for the surface's acquire fence before sampling the
+ * surface's current buffer. Must be called between wlr_renderer_begin and
+ * wlr_renderer_end. The GPU waits if the renderer supports it, the CPU blocks
+ * otherwise. The fence is kept until it's known to be signalled, so this needs
+ * to be called by each renderer sampling the buffer.
+ *
+ * Returns true if the buffer can be sampled.
+ */
+bool wlr_linux_explicit_synchronization_v1_wait_surface(
+	struct wlr_surface *surface, struct wlr_renderer *renderer);
+
+/**
+ * Check without blocking whether the client is done writing to the surface's
+ * current buffer, e.g. before scanning it out directly. Returns true if the
+ * surface has no acquire fence or if it's signalled.
+ */
+bool wlr_linux_explicit_synchronization_v1_surface_is_ready(
+	struct wlr_surface *surface);
+
+/**
+ * Signal that the compositor will be done reading the surface's current
+ * buffer once the fence FD is signalled, e.g. a fence obtained via
+ * wlr_renderer_create_fence_fd after rendering the surface. The FD is not
+ * consumed. The fence is sent to the client when the buffer is replaced.
+ */
+void wlr_linux_explicit_synchronization_v1_signal_surface_release(
+	struct wlr_surface *surface, int fence_fd);
+
+#endif
@@ -61,6 +61,7 @@ enum wlr_output_state_field {
 	WLR_OUTPUT_STATE_TRANSFORM = 1 << 5,
 	WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED = 1 << 6,
 	WLR_OUTPUT_STATE_GAMMA_LUT = 1 << 7,
+	WLR_OUTPUT_STATE_LAYERS = 1 << 8,
 };
 
 enum wlr_output_state_buffer_type {
@@ -99,6 +100,10 @@ struct wlr_output_state {
 	// only valid if WLR_OUTPUT_STATE_GAMMA_LUT
 	uint16_t *gamma_lut;
 	size_t gamma_lut_size;
+
+	// only valid if WLR_OUTPUT_STATE_LAYERS
+	struct wlr_output_layer_state *layers;
+	size_t layers_len;
 };
 
 enum wlr_output_present_mode {
@@ -110,7 +115,74 @@ enum wlr_output_present_mode {
 	WLR_OUTPUT_PRESENT_MODE_ADAPTIVE
 };
 
+/**
+ * Result of a direct scan-out attempt, see `wlr_output_try_scanout_surface`.
+ */
+enum wlr_output_scanout_status {
+	WLR_OUTPUT_SCANOUT_OK,
+	// The surface doesn't have a buffer
+	WLR_OUTPUT_SCANOUT_NO_BUFFER,
+	// Scan-out is disabled by a render lock or a software cursor
+	WLR_OUTPUT_SCANOUT_LOCKED,
+	// The buffer transform or scale doesn't match the output's
+	WLR_OUTPUT_SCANOUT_TRANSFORM,
+	// The buffer is cropped or scaled by a viewport
+	WLR_OUTPUT_SCANOUT_VIEWPORT,
+	// The client's acquire fence for the buffer isn't signalled yet
+	WLR_OUTPUT_SCANOUT_FENCE,
+	// The buffer size doesn't match the output resolution
+	WLR_OUTPUT_SCANOUT_SIZE,
+	// The backend can't scan out the buffer
+	WLR_OUTPUT_SCANOUT_REJECTED,
+};
+
+#define WLR_OUTPUT_SCANOUT_STATUS_COUNT (WLR_OUTPUT_SCANOUT_REJECTED + 1)
+
+/**
+ * Direct scan-out statistics. `results` is indexed by
+ * enum wlr_output_scanout_status: `results[WLR_OUTPUT_SCANOUT_OK]` counts the
+ * hits, the other entries count the misses by reason.
+ */
+struct wlr_output_scanout_stats {
+	uint64_t attempts;
+	uint64_t results[WLR_OUTPUT_SCANOUT_STATUS_COUNT];
+};
+
+/**
+ * Statistics for the adaptive present mode, counting page-flips committed in
+ * time for the next vblank (hits), late page-flips which waited for the
+ * following vblank (misses) and late page-flips which were presented
+ * immediately (tears).
+ */
+struct wlr_output_adaptive_present_stats {
+	uint64_t hits, misses, tears;
+};
+
+#define WLR_OUTPUT_FRAME_PACING_HISTORY 16
+
+/**
+ * Frame pacing state, see wlr_output_set_frame_pacing.
+ */
+struct wlr_output_frame_pacing {
+	bool enabled;
+
+	// Last presentation time and refresh period reported by the backend, in
+	// the backend's presentation clock
+	struct timespec last_present;
+	int refresh; // nsec, zero if unknown
+
+	// Recent render durations: time between a frame event and the following
+	// buffer commit
+	int64_t render_nsec[WLR_OUTPUT_FRAME_PACING_HISTORY];
+	size_t render_nsec_len, render_nsec_next;
+	struct timespec frame_sent; // zero if no frame is being rendered
+
+	struct wl_event_source *timer;
+	bool frame_delayed;
+};
+
 struct wlr_output_impl;
+struct wlr_output_layer_state;
 
 /**
  * A compositor output region. This typically corresponds to a monitor that
@@ -190,6 +262,12 @@ struct wlr_output {
 
 	int attach_render_locks; // number of locks forcing rendering
 
+	struct wlr_output_scanout_stats scanout_stats;
+	struct wlr_output_frame_pacing frame_pacing;
+	struct wlr_output_adaptive_present_stats adaptive_present_stats;
+
+	struct wl_list layers; // wlr_output_layer.link
+
 	struct wl_list cursors; // wlr_output_cursor::link
 	struct wlr_output_cursor *hardware_cursor;
 	int software_cursor_locks; // number of locks forcing software cursors
@@ -347,6 +425,52 @@ bool wlr_output_attach_render(struct wlr_output *output, int *buffer_age);
  */
 void wlr_output_attach_buffer(struct wlr_output *output,
 	struct wlr_buffer *buffer);
+/**
+ * Try to attach the surface's buffer to the output for direct scan-out,
+ * bypassing composition. This is meant for a fullscreen surface covering the
+ * whole output with nothing drawn on top of it.
+ *
+ * On success, the buffer is attached and has passed `wlr_output_test`: the
+ * compositor should call `wlr_output_commit` without rendering. Otherwise, the
+ * pending buffer is cleared and the compositor should fall back to rendering.
+ * The outcome is recorded in the output's `scanout_stats`.
+ */
+enum wlr_output_scanout_status wlr_output_try_scanout_surface(
+	struct wlr_output *output, struct wlr_surface *surface);
+/**
+ * Get a human-readable description of a direct scan-out status.
+ */
+const char *wlr_output_scanout_status_name(
+	enum wlr_output_scanout_status status);
+/**
+ * Enable or disable frame pacing.
+ *
+ * By default, the frame event is emitted as soon as the previous frame has
+ * been presented, leaving the new frame waiting for almost a full refresh
+ * period before it's displayed. With frame pacing enabled, the frame event is
+ * delayed until just before the next vblank, leaving enough time to render
+ * as predicted from the durations of the recent frames. This reduces latency
+ * at the risk of missing a vblank when a frame takes longer than usual.
+ *
+ * Frame pacing only applies to the normal present mode, and requires the
+ * backend to report the refresh rate in present events.
+ */
+void wlr_output_set_frame_pacing(struct wlr_output *output, bool enabled);
+/**
+ * Set the output layers to display on top of the primary buffer, ordered from
+ * bottom to top. Layers of the output which aren't part of the array are
+ * disabled.
+ *
+ * The array is borrowed until the output is committed or rolled back. After
+ * calling `wlr_output_test`, the `accepted` field of each layer state
+ * indicates whether the backend can display it without compositing. See
+ * wlr_output_layer.
+ *
+ * Layers can be updated without attaching a buffer, in which case the test and
+ * the commit fail unless all of the layers are accepted.
+ */
+void wlr_output_set_layers(struct wlr_output *output,
+	struct wlr_output_layer_state *layers, size_t layers_len);
 /**
  * Get the preferred format for reading pixels.
  * This function might change the current rendering context.
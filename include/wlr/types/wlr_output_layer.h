@@ -0,0 +1,65 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OUTPUT_LAYER_H
+#define WLR_TYPES_WLR_OUTPUT_LAYER_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/types/wlr_output.h>
+
+/**
+ * An output layer.
+ *
+ * Output layers are displayed above the output's primary buffer. Backends may
+ * be able to display some of them with hardware planes (e.g. DRM overlay
+ * planes), without compositing them into the primary buffer.
+ *
+ * Each frame, compositors should propose the output layers they'd like to
+ * display with wlr_output_set_layers() and call wlr_output_test(). The backend
+ * marks the layers it can display itself as accepted: compositors need to
+ * render the other ones into the primary buffer before committing the output.
+ * Layers which haven't been accepted are not displayed by the backend.
+ */
+struct wlr_output_layer {
+	struct wl_list link; // wlr_output.layers
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	void *data;
+};
+
+/**
+ * State for an output layer.
+ */
+struct wlr_output_layer_state {
+	struct wlr_output_layer *layer;
+
+	// Buffer to display, or NULL to disable the layer
+	struct wlr_buffer *buffer;
+	// Position in output-buffer-local coordinates
+	int x, y;
+
+	// Populated by the backend after wlr_output_test(): whether the backend
+	// can display the layer without compositing
+	bool accepted;
+};
+
+/**
+ * Create a new output layer.
+ */
+struct wlr_output_layer *wlr_output_layer_create(struct wlr_output *output);
+
+/**
+ * Destroy an output layer.
+ */
+void wlr_output_layer_destroy(struct wlr_output_layer *layer);
+
+#endif
@@ -54,6 +54,16 @@ struct wlr_relative_pointer_v1 {
 	struct wl_listener seat_destroy;
 	struct wl_listener pointer_destroy;
 
+	// private state
+
+	// Motion accumulated while the seat coalesces the pointer frame
+	struct {
+		bool pending;
+		uint64_t time_usec;
+		double dx, dy, dx_unaccel, dy_unaccel;
+	} batch;
+	struct wl_listener seat_pointer_flush;
+
 	void *data;
 };
 
@@ -63,6 +73,9 @@ struct wlr_relative_pointer_manager_v1 *wlr_relative_pointer_manager_v1_create(
 /**
  * Send a relative motion event to the seat. Time is given in microseconds
  * (unlike wl_pointer which uses milliseconds).
+ *
+ * If the seat coalesces pointer motion, deltas are accumulated and sent in
+ * bulk with the seat's coalesced pointer frame.
  */
 void wlr_relative_pointer_manager_v1_send_relative_motion(
 	struct wlr_relative_pointer_manager_v1 *manager, struct wlr_seat *seat,
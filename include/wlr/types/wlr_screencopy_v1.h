@@ -9,7 +9,9 @@
 #ifndef WLR_TYPES_WLR_SCREENCOPY_V1_H
 #define WLR_TYPES_WLR_SCREENCOPY_V1_H
 
+#include <pixman.h>
 #include <stdbool.h>
+#include <time.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_box.h>
 
@@ -46,9 +48,16 @@ struct wlr_screencopy_frame_v1 {
 
 	bool with_damage;
 
+	struct wl_resource *buffer_resource;
 	struct wl_shm_buffer *shm_buffer;
 	struct wlr_dmabuf_v1_buffer *dma_buffer;
 
+	// Pending shm copy, in buffer-local coordinates
+	struct wlr_renderer_readback *readback;
+	pixman_region32_t readback_region;
+	pixman_region32_t readback_damage;
+	struct timespec readback_when;
+
 	struct wl_listener buffer_destroy;
 
 	struct wlr_output *output;
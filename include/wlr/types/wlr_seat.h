@@ -153,6 +153,16 @@ struct wlr_seat_pointer_grab {
 
 #define WLR_POINTER_BUTTONS_CAP 16
 
+/**
+ * Counters of pointer events merged together by the seat, see
+ * wlr_seat_pointer_send_motion().
+ */
+struct wlr_seat_pointer_coalesce_stats {
+	uint64_t motion_sent, motion_coalesced;
+	uint64_t relative_motion_sent, relative_motion_coalesced;
+	uint64_t frames_coalesced;
+};
+
 struct wlr_seat_pointer_state {
 	struct wlr_seat *seat;
 	struct wlr_seat_client *focused_client;
@@ -170,9 +180,26 @@ struct wlr_seat_pointer_state {
 
 	struct wl_listener surface_destroy;
 
+	// Merge motion events received before the event loop goes idle, true by
+	// default
+	bool coalesce_motion;
+	struct wlr_seat_pointer_coalesce_stats coalesce_stats;
+
 	struct {
 		struct wl_signal focus_change; // wlr_seat_pointer_focus_change_event
 	} events;
+
+	// private state
+
+	// Pointer frame being coalesced, sent when the event loop goes idle or
+	// before any event which can't be merged
+	struct {
+		bool motion, relative_motion, frame;
+		uint32_t time_msec;
+		double sx, sy;
+		struct wl_event_source *idle;
+		struct wl_signal flush;
+	} batch;
 };
 
 // TODO: May be useful to be able to simulate keyboard input events
@@ -367,6 +394,11 @@ void wlr_seat_pointer_clear_focus(struct wlr_seat *wlr_seat);
  * Send a motion event to the surface with pointer focus. Coordinates for the
  * motion event are surface-local. This function does not respect pointer grabs:
  * you probably want `wlr_seat_pointer_notify_motion()` instead.
+ *
+ * If `pointer_state.coalesce_motion` is set, the event is deferred until the
+ * event loop goes idle: frames which only contain motion are merged, and the
+ * client receives the latest position once per batch of input events. Any
+ * other pointer or keyboard event sends the deferred frame first.
  */
 void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time_msec,
 		double sx, double sy);
@@ -65,6 +65,10 @@ struct wlr_surface_role {
 	const char *name;
 	void (*commit)(struct wlr_surface *surface);
 	void (*precommit)(struct wlr_surface *surface);
+	// Whether commits may be held until their buffer is ready. Roles with
+	// double-buffered state need to call wlr_surface_apply_held_commit()
+	// before updating it.
+	bool hold_commits;
 };
 
 struct wlr_surface_output {
@@ -125,6 +129,9 @@ struct wlr_surface {
 	void *role_data; // role-specific data
 
 	struct {
+		// emitted before the pending state is applied, surface->pending
+		// holds the state about to be committed
+		struct wl_signal precommit;
 		struct wl_signal commit;
 		struct wl_signal new_subsurface;
 		struct wl_signal destroy;
@@ -142,6 +149,14 @@ struct wlr_surface {
 	// Immediately damage this output when this surface is committed.
 	struct wlr_output_damage *immediate_commit_output;
 
+	// private state
+
+	// Commit waiting for its dmabuf to be ready, applied on top of the
+	// pending state once the GPU is done writing to the buffer
+	struct wlr_surface_state held;
+	struct wl_event_source *held_source; // NULL if no commit is held
+	int held_fd;
+
 
 	void *data;
 };
@@ -200,6 +215,13 @@ bool wlr_surface_set_role(struct wlr_surface *surface,
 		const struct wlr_surface_role *role, void *role_data,
 		struct wl_resource *error_resource, uint32_t error_code);
 
+/**
+ * Apply the commit waiting for its buffer to be ready, if any. Roles allowing
+ * held commits call this before updating their double-buffered state, so that
+ * it's applied along with the right commit.
+ */
+void wlr_surface_apply_held_commit(struct wlr_surface *surface);
+
 /**
  * Whether or not this surface currently has an attached buffer. A surface has
  * an attached buffer when it commits with a non-null buffer in its pending
@@ -65,6 +65,7 @@ struct wlr_xcursor {
  * Container for an Xcursor theme.
  */
 struct wlr_xcursor_theme {
+	// Cursors loaded so far, see wlr_xcursor_theme_get_cursor
 	unsigned int cursor_count;
 	struct wlr_xcursor **cursors;
 	char *name;
@@ -82,8 +83,15 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size);
 
 void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme);
 
+/**
+ * Loads all cursors of the theme now rather than on first use. The cursor
+ * files are read and decoded concurrently by a pool of worker threads.
+ */
+void wlr_xcursor_theme_preload(struct wlr_xcursor_theme *theme);
+
 /**
  * Obtains a wlr_xcursor image for the specified cursor name (e.g. "left_ptr").
+ * The cursor is loaded from the theme files the first time it is requested.
  */
 struct wlr_xcursor *wlr_xcursor_theme_get_cursor(
 	struct wlr_xcursor_theme *theme, const char *name);
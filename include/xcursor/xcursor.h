@@ -26,7 +26,9 @@
 #ifndef XCURSOR_H
 #define XCURSOR_H
 
+#include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 typedef int XcursorBool;
 typedef uint32_t XcursorUInt;
@@ -54,14 +56,65 @@ typedef struct _XcursorImages {
     char	    *name;	/* name used to load images */
 } XcursorImages;
 
+char *
+XcursorLibraryFindFile (const char *file, const char *theme);
+
 XcursorImages *
 XcursorLibraryLoadImages (const char *file, const char *theme, int size);
 
 void
 XcursorImagesDestroy (XcursorImages *images);
 
+/*
+ * A cursor file mapped into memory, with its table of contents parsed
+ */
+struct xcursor_file;
+
+/*
+ * Identifies the images loaded from a cursor file at a given size, whichever
+ * name or symlink the file was opened with
+ */
+struct xcursor_file_id {
+	dev_t dev;
+	ino_t ino;
+	XcursorDim size;
+};
+
+struct xcursor_file *
+xcursor_file_open(const char *path);
+
+void
+xcursor_file_close(struct xcursor_file *file);
+
+void
+xcursor_file_get_id(struct xcursor_file *file, int size,
+		    struct xcursor_file_id *id);
+
+XcursorImages *
+xcursor_file_load_images(struct xcursor_file *file, int size);
+
+bool
+xcursor_theme_has_cursors(const char *theme);
+
+/*
+ * Callbacks of xcursor_load_theme, all called on the calling thread
+ */
+struct xcursor_load_callbacks {
+	/* Whether the cursor of a given name should be loaded at all */
+	bool (*want_cursor)(const char *name, void *data);
+	/* Whether images should be decoded, rather than being known already */
+	bool (*want_images)(const struct xcursor_file_id *id, void *data);
+	/*
+	 * Called for each cursor loaded, with NULL images if they weren't
+	 * decoded because they were known already or are the same as the
+	 * ones of a previous cursor
+	 */
+	void (*load)(const char *name, XcursorImages *images,
+		     const struct xcursor_file_id *id, void *data);
+};
+
 void
 xcursor_load_theme(const char *theme, int size,
-		    void (*load_callback)(XcursorImages *, void *),
+		    const struct xcursor_load_callbacks *callbacks,
 		    void *user_data);
 #endif
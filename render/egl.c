@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <gbm.h>
+#include <GLES2/gl2.h>
 #include <wlr/render/egl.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
@@ -242,6 +243,20 @@ struct wlr_egl *wlr_egl_create(EGLenum platform, void *remote_display) {
 			"eglExportDMABUFImageMESA");
 	}
 
+	if (check_egl_ext(display_exts_str, "EGL_KHR_fence_sync") &&
+			check_egl_ext(display_exts_str, "EGL_ANDROID_native_fence_sync")) {
+		egl->exts.native_fence_sync_android = true;
+		load_egl_proc(&egl->procs.eglCreateSyncKHR, "eglCreateSyncKHR");
+		load_egl_proc(&egl->procs.eglDestroySyncKHR, "eglDestroySyncKHR");
+		load_egl_proc(&egl->procs.eglDupNativeFenceFDANDROID,
+			"eglDupNativeFenceFDANDROID");
+
+		if (check_egl_ext(display_exts_str, "EGL_KHR_wait_sync")) {
+			egl->exts.wait_sync_khr = true;
+			load_egl_proc(&egl->procs.eglWaitSyncKHR, "eglWaitSyncKHR");
+		}
+	}
+
 	if (check_egl_ext(display_exts_str, "EGL_WL_bind_wayland_display")) {
 		egl->exts.bind_wayland_display_wl = true;
 		load_egl_proc(&egl->procs.eglBindWaylandDisplayWL,
@@ -807,3 +822,67 @@ int wlr_egl_dup_drm_fd(struct wlr_egl *egl) {
 
 	return render_fd;
 }
+
+int wlr_egl_create_fence_fd(struct wlr_egl *egl) {
+	if (!egl->exts.native_fence_sync_android) {
+		return -1;
+	}
+
+	EGLint attribs[] = {
+		EGL_SYNC_NATIVE_FENCE_FD_ANDROID, EGL_NO_NATIVE_FENCE_FD_ANDROID,
+		EGL_NONE,
+	};
+	EGLSyncKHR sync = egl->procs.eglCreateSyncKHR(egl->display,
+		EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+	if (sync == EGL_NO_SYNC_KHR) {
+		wlr_log(WLR_ERROR, "eglCreateSyncKHR failed");
+		return -1;
+	}
+
+	// The native fence FD only becomes available once the fence has been
+	// flushed to the GPU
+	glFlush();
+
+	int fd = egl->procs.eglDupNativeFenceFDANDROID(egl->display, sync);
+	egl->procs.eglDestroySyncKHR(egl->display, sync);
+	if (fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
+		wlr_log(WLR_ERROR, "eglDupNativeFenceFDANDROID failed");
+		return -1;
+	}
+
+	return fd;
+}
+
+bool wlr_egl_wait_fence_fd(struct wlr_egl *egl, int fd) {
+	if (!egl->exts.wait_sync_khr) {
+		return false;
+	}
+
+	// EGL takes ownership of the FD on success
+	int dup_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (dup_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
+		return false;
+	}
+
+	EGLint attribs[] = {
+		EGL_SYNC_NATIVE_FENCE_FD_ANDROID, dup_fd,
+		EGL_NONE,
+	};
+	EGLSyncKHR sync = egl->procs.eglCreateSyncKHR(egl->display,
+		EGL_SYNC_NATIVE_FENCE_ANDROID, attribs);
+	if (sync == EGL_NO_SYNC_KHR) {
+		wlr_log(WLR_ERROR, "eglCreateSyncKHR failed");
+		close(dup_fd);
+		return false;
+	}
+
+	EGLint ret = egl->procs.eglWaitSyncKHR(egl->display, sync, 0);
+	egl->procs.eglDestroySyncKHR(egl->display, sync);
+	if (ret != EGL_TRUE) {
+		wlr_log(WLR_ERROR, "eglWaitSyncKHR failed");
+		return false;
+	}
+
+	return true;
+}
@@ -2,6 +2,7 @@
 #include <drm_fourcc.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -180,6 +181,147 @@ static bool gles2_bind_buffer(struct wlr_renderer *wlr_renderer,
 	return true;
 }
 
+static void gles2_use_program(struct wlr_gles2_renderer *renderer,
+		GLuint program) {
+	if (renderer->state.program == program) {
+		return;
+	}
+	gles2_call(renderer, glUseProgram(program));
+	renderer->state.program = program;
+}
+
+static void gles2_bind_texture(struct wlr_gles2_renderer *renderer,
+		GLenum target, GLuint tex) {
+	if (renderer->state.texture_target == target &&
+			renderer->state.texture == tex) {
+		return;
+	}
+	gles2_call(renderer, glBindTexture(target, tex));
+	renderer->state.texture_target = target;
+	renderer->state.texture = tex;
+}
+
+void gles2_invalidate_texture_state(struct wlr_gles2_renderer *renderer) {
+	renderer->state.texture_target = 0;
+	renderer->state.texture = 0;
+}
+
+static void gles2_set_blend(struct wlr_gles2_renderer *renderer, bool blend) {
+	if (renderer->state.blend == blend) {
+		return;
+	}
+	if (blend) {
+		gles2_call(renderer, glEnable(GL_BLEND));
+	} else {
+		gles2_call(renderer, glDisable(GL_BLEND));
+	}
+	renderer->state.blend = blend;
+}
+
+static uint32_t attrib_bit(GLint loc) {
+	// Inactive attributes have no location
+	if (loc < 0) {
+		return 0;
+	}
+	assert(loc < 32);
+	return 1u << loc;
+}
+
+/**
+ * Enable exactly the vertex attrib arrays in the bitmask.
+ */
+static void gles2_set_attribs(struct wlr_gles2_renderer *renderer,
+		uint32_t attribs) {
+	uint32_t changed = renderer->state.attribs ^ attribs;
+	for (GLuint i = 0; changed != 0; i++, changed >>= 1) {
+		if (!(changed & 1)) {
+			continue;
+		}
+		if (attribs & (1u << i)) {
+			gles2_call(renderer, glEnableVertexAttribArray(i));
+		} else {
+			gles2_call(renderer, glDisableVertexAttribArray(i));
+		}
+	}
+	renderer->state.attribs = attribs;
+}
+
+static void gles2_set_proj(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_uniform_cache *cache, GLint loc,
+		const GLfloat proj[static 9]) {
+	if (cache->has_proj &&
+			memcmp(cache->proj, proj, sizeof(cache->proj)) == 0) {
+		return;
+	}
+	gles2_call(renderer, glUniformMatrix3fv(loc, 1, GL_FALSE, proj));
+	memcpy(cache->proj, proj, sizeof(cache->proj));
+	cache->has_proj = true;
+}
+
+static void gles2_set_color(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_uniform_cache *cache, GLint loc,
+		const float color[static 4]) {
+	if (cache->has_color &&
+			memcmp(cache->color, color, sizeof(cache->color)) == 0) {
+		return;
+	}
+	gles2_call(renderer,
+		glUniform4f(loc, color[0], color[1], color[2], color[3]));
+	memcpy(cache->color, color, sizeof(cache->color));
+	cache->has_color = true;
+}
+
+static void gles2_set_alpha(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_uniform_cache *cache, GLint loc, float alpha) {
+	if (cache->has_alpha && cache->alpha == alpha) {
+		return;
+	}
+	gles2_call(renderer, glUniform1f(loc, alpha));
+	cache->alpha = alpha;
+	cache->has_alpha = true;
+}
+
+static void gles2_set_invert_y(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_uniform_cache *cache, GLint loc, bool invert_y) {
+	if (cache->has_invert_y && cache->invert_y == invert_y) {
+		return;
+	}
+	gles2_call(renderer, glUniform1i(loc, invert_y));
+	cache->invert_y = invert_y;
+	cache->has_invert_y = true;
+}
+
+/**
+ * Put the GL state the compositor may have changed back into a known state,
+ * keeping the scissor rectangle.
+ */
+static void gles2_reset_state(struct wlr_gles2_renderer *renderer) {
+	// Attrib arrays left enabled may point to stale client memory
+	for (GLuint i = 0; i < 32; i++) {
+		if (renderer->state.attribs & (1u << i)) {
+			gles2_call(renderer, glDisableVertexAttribArray(i));
+		}
+	}
+	renderer->state.attribs = 0;
+
+	gles2_call(renderer, glActiveTexture(GL_TEXTURE0));
+	gles2_call(renderer, glEnable(GL_BLEND));
+	gles2_call(renderer, glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+
+	renderer->state.program = 0;
+	gles2_invalidate_texture_state(renderer);
+	renderer->state.blend = true;
+
+	if (renderer->state.scissor) {
+		struct wlr_box *box = &renderer->state.scissor_box;
+		gles2_call(renderer,
+			glScissor(box->x, box->y, box->width, box->height));
+		gles2_call(renderer, glEnable(GL_SCISSOR_TEST));
+	} else {
+		gles2_call(renderer, glDisable(GL_SCISSOR_TEST));
+	}
+}
+
 static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 		uint32_t height) {
 	struct wlr_gles2_renderer *renderer =
@@ -187,13 +329,18 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 
 	push_gles2_debug(renderer);
 
-	glViewport(0, 0, width, height);
+	renderer->draw_calls = 0;
+	renderer->gl_calls = 0;
+
+	gles2_call(renderer, glViewport(0, 0, width, height));
 	renderer->viewport_width = width;
 	renderer->viewport_height = height;
 
-	// enable transparency
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	// Scissoring doesn't carry over from the last pass, and the compositor
+	// may have changed the rectangle
+	renderer->state.scissor = false;
+	renderer->state.scissor_box = (struct wlr_box){ .width = -1 };
+	gles2_reset_state(renderer);
 
 	// XXX: maybe we should save output projection and remove some of the need
 	// for users to sling matricies themselves
@@ -202,8 +349,16 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 }
 
 static void gles2_end(struct wlr_renderer *wlr_renderer) {
-	gles2_get_renderer_in_context(wlr_renderer);
-	// no-op
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	// Leave the GL state as the compositor expects it outside of a pass
+	push_gles2_debug(renderer);
+	gles2_set_attribs(renderer, 0);
+	if (renderer->state.texture_target != 0) {
+		gles2_bind_texture(renderer, renderer->state.texture_target, 0);
+	}
+	pop_gles2_debug(renderer);
 }
 
 static void gles2_clear(struct wlr_renderer *wlr_renderer,
@@ -212,8 +367,9 @@ static void gles2_clear(struct wlr_renderer *wlr_renderer,
 		gles2_get_renderer_in_context(wlr_renderer);
 
 	push_gles2_debug(renderer);
-	glClearColor(color[0], color[1], color[2], color[3]);
-	glClear(GL_COLOR_BUFFER_BIT);
+	gles2_call(renderer,
+		glClearColor(color[0], color[1], color[2], color[3]));
+	gles2_call(renderer, glClear(GL_COLOR_BUFFER_BIT));
 	pop_gles2_debug(renderer);
 }
 
@@ -224,10 +380,18 @@ static void gles2_scissor(struct wlr_renderer *wlr_renderer,
 
 	push_gles2_debug(renderer);
 	if (box != NULL) {
-		glScissor(box->x, box->y, box->width, box->height);
-		glEnable(GL_SCISSOR_TEST);
-	} else {
-		glDisable(GL_SCISSOR_TEST);
+		if (memcmp(&renderer->state.scissor_box, box, sizeof(*box)) != 0) {
+			gles2_call(renderer,
+				glScissor(box->x, box->y, box->width, box->height));
+			renderer->state.scissor_box = *box;
+		}
+		if (!renderer->state.scissor) {
+			gles2_call(renderer, glEnable(GL_SCISSOR_TEST));
+			renderer->state.scissor = true;
+		}
+	} else if (renderer->state.scissor) {
+		gles2_call(renderer, glDisable(GL_SCISSOR_TEST));
+		renderer->state.scissor = false;
 	}
 	pop_gles2_debug(renderer);
 }
@@ -238,15 +402,14 @@ static const float flip_180[9] = {
 	0.0f, 0.0f, 1.0f,
 };
 
-static bool gles2_render_subtexture_with_matrix(
-		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
-		const struct wlr_fbox *box, const float matrix[static 9],
-		float alpha) {
-	struct wlr_gles2_renderer *renderer =
-		gles2_get_renderer_in_context(wlr_renderer);
-	struct wlr_gles2_texture *texture =
-		gles2_get_texture(wlr_texture);
-
+/**
+ * Bind the texture and set up the shader used to sample it. The caller
+ * provides the vertex attributes and draws.
+ */
+static struct wlr_gles2_tex_shader *gles2_use_texture_shader(
+		struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_texture *texture,
+		const float matrix[static 9], float alpha) {
 	struct wlr_gles2_tex_shader *shader = NULL;
 
 	switch (texture->target) {
@@ -263,7 +426,7 @@ static bool gles2_render_subtexture_with_matrix(
 		if (!renderer->exts.egl_image_external_oes) {
 			wlr_log(WLR_ERROR, "Failed to render texture: "
 				"GL_TEXTURE_EXTERNAL_OES not supported");
-			return false;
+			return NULL;
 		}
 		break;
 	default:
@@ -277,19 +440,37 @@ static bool gles2_render_subtexture_with_matrix(
 	// to GL_FALSE
 	wlr_matrix_transpose(gl_matrix, gl_matrix);
 
-	push_gles2_debug(renderer);
+	// The texture unit is selected by gles2_begin, and samplers default to
+	// unit 0
+	gles2_bind_texture(renderer, texture->target, texture->tex);
+	gles2_use_program(renderer, shader->program);
+	gles2_set_blend(renderer, texture->has_alpha || alpha < 1.0f);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
+	gles2_set_proj(renderer, &shader->uniforms, shader->proj, gl_matrix);
+	gles2_set_invert_y(renderer, &shader->uniforms, shader->invert_y,
+		texture->inverted_y);
+	gles2_set_alpha(renderer, &shader->uniforms, shader->alpha, alpha);
 
-	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	return shader;
+}
 
-	glUseProgram(shader->program);
+static bool gles2_render_subtexture_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const struct wlr_fbox *box, const float matrix[static 9],
+		float alpha) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_texture *texture =
+		gles2_get_texture(wlr_texture);
 
-	glUniformMatrix3fv(shader->proj, 1, GL_FALSE, gl_matrix);
-	glUniform1i(shader->invert_y, texture->inverted_y);
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
+	push_gles2_debug(renderer);
+
+	struct wlr_gles2_tex_shader *shader =
+		gles2_use_texture_shader(renderer, texture, matrix, alpha);
+	if (shader == NULL) {
+		pop_gles2_debug(renderer);
+		return false;
+	}
 
 	const GLfloat x1 = box->x / wlr_texture->width;
 	const GLfloat y1 = box->y / wlr_texture->height;
@@ -302,18 +483,152 @@ static bool gles2_render_subtexture_with_matrix(
 		x1, y2, // bottom left
 	};
 
-	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-	glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, texcoord);
+	gles2_call(renderer, glVertexAttribPointer(shader->pos_attrib, 2,
+		GL_FLOAT, GL_FALSE, 0, verts));
+	gles2_call(renderer, glVertexAttribPointer(shader->tex_attrib, 2,
+		GL_FLOAT, GL_FALSE, 0, texcoord));
+
+	gles2_set_attribs(renderer,
+		attrib_bit(shader->pos_attrib) | attrib_bit(shader->tex_attrib));
+
+	gles2_call(renderer, glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+	renderer->draw_calls++;
+
+	pop_gles2_debug(renderer);
+	return true;
+}
+
+static bool region_verts_reserve(struct wlr_gles2_renderer *renderer,
+		size_t len) {
+	if (len <= renderer->region_verts_cap) {
+		return true;
+	}
+	size_t cap = renderer->region_verts_cap ? renderer->region_verts_cap : 256;
+	while (cap < len) {
+		cap *= 2;
+	}
+	GLfloat *verts = realloc(renderer->region_verts, cap * sizeof(GLfloat));
+	if (verts == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	renderer->region_verts = verts;
+	renderer->region_verts_cap = cap;
+	return true;
+}
+
+// Position and texture coordinates of each vertex
+#define REGION_VERT_LEN 4
+// Each rectangle is drawn as two triangles
+#define REGION_RECT_VERTS 6
+
+static bool gles2_render_subtexture_region_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const struct wlr_fbox *box, const float matrix[static 9],
+		float alpha, pixman_region32_t *region) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	struct wlr_gles2_texture *texture =
+		gles2_get_texture(wlr_texture);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+
+	// The matrix maps the unit square to normalized device coordinates:
+	// x = a * u + b * v + c, y = d * u + e * v + f
+	float gl_matrix[9];
+	wlr_matrix_multiply(gl_matrix, flip_180, matrix);
+	float a = gl_matrix[0], b = gl_matrix[1], c = gl_matrix[2];
+	float d = gl_matrix[3], e = gl_matrix[4], f = gl_matrix[5];
+	float det = a * e - b * d;
+
+	// Rotated quads can't be clipped to rectangles, scissor them instead
+	bool axis_aligned = (b == 0 && d == 0) || (a == 0 && e == 0);
+	if (!axis_aligned || det == 0 || !region_verts_reserve(renderer,
+			(size_t)nrects * REGION_RECT_VERTS * REGION_VERT_LEN)) {
+		bool ok = true;
+		for (int i = 0; i < nrects; i++) {
+			struct wlr_box scissor = {
+				.x = rects[i].x1,
+				.y = rects[i].y1,
+				.width = rects[i].x2 - rects[i].x1,
+				.height = rects[i].y2 - rects[i].y1,
+			};
+			gles2_scissor(wlr_renderer, &scissor);
+			ok = gles2_render_subtexture_with_matrix(wlr_renderer,
+				wlr_texture, box, matrix, alpha) && ok;
+		}
+		gles2_scissor(wlr_renderer, NULL);
+		return ok;
+	}
+
+	// Bounds of the quad
+	float quad_x1 = fminf(c, c + a + b), quad_x2 = fmaxf(c, c + a + b);
+	float quad_y1 = fminf(f, f + d + e), quad_y2 = fmaxf(f, f + d + e);
+
+	float vw = renderer->viewport_width, vh = renderer->viewport_height;
+	GLfloat *v = renderer->region_verts;
+	size_t nverts = 0;
+	for (int i = 0; i < nrects; i++) {
+		// Intersect the rectangle with the quad, in device coordinates
+		float x1 = fmaxf(2 * rects[i].x1 / vw - 1, quad_x1);
+		float x2 = fminf(2 * rects[i].x2 / vw - 1, quad_x2);
+		float y1 = fmaxf(2 * rects[i].y1 / vh - 1, quad_y1);
+		float y2 = fminf(2 * rects[i].y2 / vh - 1, quad_y2);
+		if (x1 >= x2 || y1 >= y2) {
+			continue;
+		}
+
+		const float corners[][2] = {
+			{ x1, y1 }, { x2, y1 }, { x1, y2 },
+			{ x1, y2 }, { x2, y1 }, { x2, y2 },
+		};
+		for (size_t j = 0; j < REGION_RECT_VERTS; j++) {
+			// Map back to the unit square, and to texture coordinates
+			float x = corners[j][0] - c, y = corners[j][1] - f;
+			float u = (e * x - b * y) / det;
+			float w = (a * y - d * x) / det;
+			*v++ = u;
+			*v++ = w;
+			*v++ = (box->x + u * box->width) / wlr_texture->width;
+			*v++ = (box->y + w * box->height) / wlr_texture->height;
+		}
+		nverts += REGION_RECT_VERTS;
+	}
+	if (nverts == 0) {
+		return true;
+	}
+
+	gles2_scissor(wlr_renderer, NULL);
+
+	push_gles2_debug(renderer);
+
+	struct wlr_gles2_tex_shader *shader =
+		gles2_use_texture_shader(renderer, texture, matrix, alpha);
+	if (shader == NULL) {
+		pop_gles2_debug(renderer);
+		return false;
+	}
+
+	gles2_call(renderer, glBindBuffer(GL_ARRAY_BUFFER, renderer->region_vbo));
+	gles2_call(renderer, glBufferData(GL_ARRAY_BUFFER,
+		nverts * REGION_VERT_LEN * sizeof(GLfloat),
+		renderer->region_verts, GL_STREAM_DRAW));
 
-	glEnableVertexAttribArray(shader->pos_attrib);
-	glEnableVertexAttribArray(shader->tex_attrib);
+	GLsizei stride = REGION_VERT_LEN * sizeof(GLfloat);
+	gles2_call(renderer, glVertexAttribPointer(shader->pos_attrib, 2,
+		GL_FLOAT, GL_FALSE, stride, (void *)0));
+	gles2_call(renderer, glVertexAttribPointer(shader->tex_attrib, 2,
+		GL_FLOAT, GL_FALSE, stride, (void *)(2 * sizeof(GLfloat))));
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	gles2_set_attribs(renderer,
+		attrib_bit(shader->pos_attrib) | attrib_bit(shader->tex_attrib));
 
-	glDisableVertexAttribArray(shader->pos_attrib);
-	glDisableVertexAttribArray(shader->tex_attrib);
+	gles2_call(renderer, glDrawArrays(GL_TRIANGLES, 0, nverts));
+	renderer->draw_calls++;
 
-	glBindTexture(texture->target, 0);
+	// Other draws use client-side vertex arrays
+	gles2_call(renderer, glBindBuffer(GL_ARRAY_BUFFER, 0));
 
 	pop_gles2_debug(renderer);
 	return true;
@@ -332,19 +647,21 @@ static void gles2_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
 	wlr_matrix_transpose(gl_matrix, gl_matrix);
 
 	push_gles2_debug(renderer);
-	glUseProgram(renderer->shaders.quad.program);
-
-	glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE, gl_matrix);
-	glUniform4f(renderer->shaders.quad.color, color[0], color[1], color[2], color[3]);
+	gles2_use_program(renderer, renderer->shaders.quad.program);
+	gles2_set_blend(renderer, color[3] < 1.0f);
 
-	glVertexAttribPointer(renderer->shaders.quad.pos_attrib, 2, GL_FLOAT, GL_FALSE,
-			0, verts);
+	gles2_set_proj(renderer, &renderer->shaders.quad.uniforms,
+		renderer->shaders.quad.proj, gl_matrix);
+	gles2_set_color(renderer, &renderer->shaders.quad.uniforms,
+		renderer->shaders.quad.color, color);
 
-	glEnableVertexAttribArray(renderer->shaders.quad.pos_attrib);
+	gles2_call(renderer, glVertexAttribPointer(
+		renderer->shaders.quad.pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts));
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	gles2_set_attribs(renderer, attrib_bit(renderer->shaders.quad.pos_attrib));
 
-	glDisableVertexAttribArray(renderer->shaders.quad.pos_attrib);
+	gles2_call(renderer, glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+	renderer->draw_calls++;
 
 	pop_gles2_debug(renderer);
 }
@@ -369,23 +686,28 @@ static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
 	};
 
 	push_gles2_debug(renderer);
-	glUseProgram(renderer->shaders.ellipse.program);
+	gles2_use_program(renderer, renderer->shaders.ellipse.program);
+	// Pixels outside of the ellipse are transparent
+	gles2_set_blend(renderer, true);
 
-	glUniformMatrix3fv(renderer->shaders.ellipse.proj, 1, GL_FALSE, gl_matrix);
-	glUniform4f(renderer->shaders.ellipse.color, color[0], color[1], color[2], color[3]);
+	gles2_set_proj(renderer, &renderer->shaders.ellipse.uniforms,
+		renderer->shaders.ellipse.proj, gl_matrix);
+	gles2_set_color(renderer, &renderer->shaders.ellipse.uniforms,
+		renderer->shaders.ellipse.color, color);
 
-	glVertexAttribPointer(renderer->shaders.ellipse.pos_attrib, 2, GL_FLOAT,
-			GL_FALSE, 0, verts);
-	glVertexAttribPointer(renderer->shaders.ellipse.tex_attrib, 2, GL_FLOAT,
-			GL_FALSE, 0, texcoord);
+	gles2_call(renderer, glVertexAttribPointer(
+		renderer->shaders.ellipse.pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts));
+	gles2_call(renderer, glVertexAttribPointer(
+		renderer->shaders.ellipse.tex_attrib, 2, GL_FLOAT, GL_FALSE, 0,
+		texcoord));
 
-	glEnableVertexAttribArray(renderer->shaders.ellipse.pos_attrib);
-	glEnableVertexAttribArray(renderer->shaders.ellipse.tex_attrib);
+	gles2_set_attribs(renderer,
+		attrib_bit(renderer->shaders.ellipse.pos_attrib) |
+		attrib_bit(renderer->shaders.ellipse.tex_attrib));
 
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	gles2_call(renderer, glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+	renderer->draw_calls++;
 
-	glDisableVertexAttribArray(renderer->shaders.ellipse.pos_attrib);
-	glDisableVertexAttribArray(renderer->shaders.ellipse.tex_attrib);
 	pop_gles2_debug(renderer);
 }
 
@@ -518,9 +840,163 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 	return glGetError() == GL_NO_ERROR;
 }
 
+static void gles2_readback_destroy(struct wlr_gles2_readback *readback) {
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	wlr_egl_make_current(renderer->egl);
+	push_gles2_debug(renderer);
+	glDeleteBuffers(1, &readback->pbo);
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&old_context);
+
+	if (readback->fence_source != NULL) {
+		wl_event_source_remove(readback->fence_source);
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+	}
+	wl_list_remove(&readback->link);
+	free(readback);
+}
+
+static void gles2_readback_complete(struct wlr_gles2_readback *readback,
+		bool ok) {
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	wlr_egl_make_current(renderer->egl);
+	push_gles2_debug(renderer);
+
+	const void *data = NULL;
+	if (ok) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+		data = renderer->procs.glMapBufferRange(GL_PIXEL_PACK_BUFFER_NV, 0,
+			readback->stride * readback->height, GL_MAP_READ_BIT_EXT);
+		if (data == NULL) {
+			wlr_log(WLR_ERROR, "Failed to map pixel buffer object");
+		}
+	}
+
+	readback->done(data, readback->stride, 0, readback->data);
+
+	if (data != NULL) {
+		renderer->procs.glUnmapBuffer(GL_PIXEL_PACK_BUFFER_NV);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	pop_gles2_debug(renderer);
+	wlr_egl_restore_context(&old_context);
+
+	gles2_readback_destroy(readback);
+}
+
+static int gles2_readback_handle_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_gles2_readback *readback = data;
+	bool ok = !(mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR));
+	gles2_readback_complete(readback, ok);
+	return 0;
+}
+
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1 // GLES 3.0
+#endif
+
+static struct wlr_renderer_readback *gles2_read_pixels_async(
+		struct wlr_renderer *wlr_renderer, uint32_t drm_format,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		wlr_renderer_read_pixels_func_t done, void *data) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+
+	if (!renderer->exts.pixel_buffer_object ||
+			!renderer->egl->exts.native_fence_sync_android ||
+			renderer->event_loop == NULL) {
+		return NULL;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_gles2_format_from_drm(drm_format);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return NULL;
+	}
+
+	if (fmt->gl_format == GL_BGRA_EXT && !renderer->exts.read_format_bgra_ext) {
+		wlr_log(WLR_ERROR,
+			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
+		return NULL;
+	}
+
+	struct wlr_gles2_readback *readback =
+		calloc(1, sizeof(struct wlr_gles2_readback));
+	if (readback == NULL) {
+		return NULL;
+	}
+	readback->base.renderer = wlr_renderer;
+	readback->renderer = renderer;
+	readback->stride = width * fmt->bpp / 8;
+	readback->height = height;
+	readback->fence_fd = -1;
+	readback->done = done;
+	readback->data = data;
+	wl_list_insert(&renderer->readbacks, &readback->link);
+
+	push_gles2_debug(renderer);
+
+	glGetError(); // Clear the error flag
+
+	// The transfer into the PBO is queued along with the rendering commands:
+	// unlike glReadPixels into client memory, this doesn't block
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER_NV, readback->stride * height, NULL,
+		GL_STREAM_READ);
+	glReadPixels(src_x, src_y, width, height, fmt->gl_format, fmt->gl_type,
+		NULL);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER_NV, 0);
+
+	bool ok = glGetError() == GL_NO_ERROR;
+
+	pop_gles2_debug(renderer);
+
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to read pixels into pixel buffer object");
+		goto error;
+	}
+
+	readback->fence_fd = wlr_egl_create_fence_fd(renderer->egl);
+	if (readback->fence_fd < 0) {
+		goto error;
+	}
+
+	readback->fence_source = wl_event_loop_add_fd(renderer->event_loop,
+		readback->fence_fd, WL_EVENT_READABLE, gles2_readback_handle_fence,
+		readback);
+	if (readback->fence_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add fence FD to event loop");
+		goto error;
+	}
+
+	return &readback->base;
+
+error:
+	gles2_readback_destroy(readback);
+	return NULL;
+}
+
+static void gles2_cancel_readback(struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback =
+		wl_container_of(wlr_readback, readback, base);
+	gles2_readback_destroy(readback);
+}
+
 static bool gles2_blit_dmabuf(struct wlr_renderer *wlr_renderer,
 		struct wlr_dmabuf_attributes *dst_attr,
-		struct wlr_dmabuf_attributes *src_attr) {
+		struct wlr_dmabuf_attributes *src_attr,
+		const struct wlr_box *src_box) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
 	if (!renderer->procs.glEGLImageTargetRenderbufferStorageOES) {
 		return false;
@@ -577,13 +1053,26 @@ static bool gles2_blit_dmabuf(struct wlr_renderer *wlr_renderer,
 		goto out;
 	}
 
+	// The texture coordinates get flipped when inverted_y is set: mirror the
+	// source rectangle so that the same buffer region ends up being sampled
+	struct wlr_fbox src_fbox = {
+		.x = src_box->x,
+		.y = src_box->y,
+		.width = src_box->width,
+		.height = src_box->height,
+	};
+	if (dst_inverted_y) {
+		src_fbox.y = src_attr->height - src_box->y - src_box->height;
+	}
+
 	// TODO: use ANGLE_framebuffer_blit if available
 	float mat[9];
 	wlr_matrix_projection(mat, 1, 1, WL_OUTPUT_TRANSFORM_NORMAL);
 
 	wlr_renderer_begin(wlr_renderer, dst_attr->width, dst_attr->height);
 	wlr_renderer_clear(wlr_renderer, (float[]){ 0.0, 0.0, 0.0, 0.0 });
-	wlr_render_texture_with_matrix(wlr_renderer, src_tex, mat, 1.0f);
+	wlr_render_subtexture_with_matrix(wlr_renderer, src_tex, &src_fbox, mat,
+		1.0f);
 	wlr_renderer_end(wlr_renderer);
 
 	r = true;
@@ -621,6 +1110,8 @@ static bool gles2_init_wl_display(struct wlr_renderer *wlr_renderer,
 		wlr_log(WLR_INFO, "EGL_EXT_image_dma_buf_import is not supported");
 	}
 
+	renderer->event_loop = wl_display_get_event_loop(wl_display);
+
 	return true;
 }
 
@@ -635,6 +1126,18 @@ static int gles2_get_drm_fd(struct wlr_renderer *wlr_renderer) {
 	return renderer->drm_fd;
 }
 
+static int gles2_create_fence_fd(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	return wlr_egl_create_fence_fd(renderer->egl);
+}
+
+static bool gles2_wait_fence_fd(struct wlr_renderer *wlr_renderer, int fd) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	return wlr_egl_wait_fence_fd(renderer->egl, fd);
+}
+
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer(wlr_renderer);
@@ -646,6 +1149,11 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 
 	wlr_egl_make_current(renderer->egl);
 
+	struct wlr_gles2_readback *readback, *readback_tmp;
+	wl_list_for_each_safe(readback, readback_tmp, &renderer->readbacks, link) {
+		gles2_readback_complete(readback, false);
+	}
+
 	struct wlr_gles2_buffer *buffer, *buffer_tmp;
 	wl_list_for_each_safe(buffer, buffer_tmp, &renderer->buffers, link) {
 		destroy_buffer(buffer);
@@ -657,7 +1165,9 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
 	glDeleteProgram(renderer->shaders.tex_rgbx.program);
 	glDeleteProgram(renderer->shaders.tex_ext.program);
+	glDeleteBuffers(1, &renderer->region_vbo);
 	pop_gles2_debug(renderer);
+	free(renderer->region_verts);
 
 	if (renderer->exts.debug_khr) {
 		glDisable(GL_DEBUG_OUTPUT_KHR);
@@ -682,6 +1192,8 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.clear = gles2_clear,
 	.scissor = gles2_scissor,
 	.render_subtexture_with_matrix = gles2_render_subtexture_with_matrix,
+	.render_subtexture_region_with_matrix =
+		gles2_render_subtexture_region_with_matrix,
 	.render_quad_with_matrix = gles2_render_quad_with_matrix,
 	.render_ellipse_with_matrix = gles2_render_ellipse_with_matrix,
 	.get_shm_texture_formats = gles2_get_shm_texture_formats,
@@ -697,6 +1209,10 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.init_wl_display = gles2_init_wl_display,
 	.blit_dmabuf = gles2_blit_dmabuf,
 	.get_drm_fd = gles2_get_drm_fd,
+	.read_pixels_async = gles2_read_pixels_async,
+	.cancel_readback = gles2_cancel_readback,
+	.create_fence_fd = gles2_create_fence_fd,
+	.wait_fence_fd = gles2_wait_fence_fd,
 };
 
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
@@ -850,6 +1366,7 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl);
 
 	wl_list_init(&renderer->buffers);
+	wl_list_init(&renderer->readbacks);
 
 	renderer->egl = egl;
 	renderer->exts_str = exts_str;
@@ -894,6 +1411,17 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			"glEGLImageTargetRenderbufferStorageOES");
 	}
 
+	// Mesa and most drivers hand out a GLES 3 context even though we only
+	// ask for GLES 2
+	int gl_major = 0, gl_minor = 0;
+	const char *gl_version = (const char *)glGetString(GL_VERSION);
+	if (gl_version != NULL && sscanf(gl_version, "OpenGL ES %d.%d",
+			&gl_major, &gl_minor) == 2 && gl_major >= 3) {
+		renderer->exts.pixel_buffer_object = true;
+		load_gl_proc(&renderer->procs.glMapBufferRange, "glMapBufferRange");
+		load_gl_proc(&renderer->procs.glUnmapBuffer, "glUnmapBuffer");
+	}
+
 	if (renderer->exts.debug_khr) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -966,6 +1494,8 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 		renderer->shaders.tex_ext.tex_attrib = glGetAttribLocation(prog, "texcoord");
 	}
 
+	glGenBuffers(1, &renderer->region_vbo);
+
 	pop_gles2_debug(renderer);
 
 	wlr_egl_unset_current(renderer->egl);
@@ -992,6 +1522,31 @@ error:
 	return NULL;
 }
 
+size_t wlr_gles2_renderer_get_draw_calls(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	return renderer->draw_calls;
+}
+
+size_t wlr_gles2_renderer_get_gl_calls(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	return renderer->gl_calls;
+}
+
+void wlr_gles2_renderer_invalidate_state(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	push_gles2_debug(renderer);
+	gles2_reset_state(renderer);
+	pop_gles2_debug(renderer);
+
+	// The compositor may have set uniforms of our programs too
+	renderer->shaders.quad.uniforms = (struct wlr_gles2_uniform_cache){0};
+	renderer->shaders.ellipse.uniforms = (struct wlr_gles2_uniform_cache){0};
+	renderer->shaders.tex_rgba.uniforms = (struct wlr_gles2_uniform_cache){0};
+	renderer->shaders.tex_rgbx.uniforms = (struct wlr_gles2_uniform_cache){0};
+	renderer->shaders.tex_ext.uniforms = (struct wlr_gles2_uniform_cache){0};
+}
+
 bool wlr_gles2_renderer_check_ext(struct wlr_renderer *wlr_renderer,
 		const char *ext) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
@@ -85,6 +85,7 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+	gles2_invalidate_texture_state(texture->renderer);
 
 	pop_gles2_debug(texture->renderer);
 
@@ -93,6 +94,67 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	return true;
 }
 
+static bool gles2_texture_write_pixels_boxes(struct wlr_texture *wlr_texture,
+		uint32_t stride, const pixman_box32_t *boxes, size_t boxes_len,
+		const void *data, size_t *uploaded_bytes) {
+	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+
+	if (texture->target != GL_TEXTURE_2D) {
+		wlr_log(WLR_ERROR, "Cannot write pixels to immutable texture");
+		return false;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt =
+		get_gles2_format_from_drm(texture->drm_format);
+	assert(fmt);
+
+	if (!check_stride(fmt, stride, wlr_texture->width)) {
+		return false;
+	}
+
+	struct wlr_egl_context prev_ctx;
+	wlr_egl_save_context(&prev_ctx);
+	wlr_egl_make_current(texture->renderer->egl);
+
+	push_gles2_debug(texture->renderer);
+
+	// Bind the texture and set up the row length once for all boxes
+	glBindTexture(GL_TEXTURE_2D, texture->tex);
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / (fmt->bpp / 8));
+
+	size_t bytes = 0;
+	for (size_t i = 0; i < boxes_len; i++) {
+		const pixman_box32_t *box = &boxes[i];
+		uint32_t width = box->x2 - box->x1;
+		uint32_t height = box->y2 - box->y1;
+
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, box->x1);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, box->y1);
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, box->x1, box->y1, width, height,
+			fmt->gl_format, fmt->gl_type, data);
+
+		bytes += (size_t)width * height * (fmt->bpp / 8);
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	gles2_invalidate_texture_state(texture->renderer);
+
+	pop_gles2_debug(texture->renderer);
+
+	wlr_egl_restore_context(&prev_ctx);
+
+	if (uploaded_bytes != NULL) {
+		*uploaded_bytes = bytes;
+	}
+	return true;
+}
+
 static bool gles2_texture_to_dmabuf(struct wlr_texture *wlr_texture,
 		struct wlr_dmabuf_attributes *attribs) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
@@ -135,6 +197,8 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 	push_gles2_debug(texture->renderer);
 
 	glDeleteTextures(1, &texture->tex);
+	// The name may be reused by the next texture
+	gles2_invalidate_texture_state(texture->renderer);
 	wlr_egl_destroy_image(texture->renderer->egl, texture->image);
 
 	pop_gles2_debug(texture->renderer);
@@ -147,6 +211,7 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 static const struct wlr_texture_impl texture_impl = {
 	.is_opaque = gles2_texture_is_opaque,
 	.write_pixels = gles2_texture_write_pixels,
+	.write_pixels_boxes = gles2_texture_write_pixels_boxes,
 	.to_dmabuf = gles2_texture_to_dmabuf,
 	.destroy = gles2_texture_destroy,
 };
@@ -190,12 +255,14 @@ struct wlr_texture *gles2_texture_from_pixels(struct wlr_renderer *wlr_renderer,
 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / (fmt->bpp / 8));
 	glTexImage2D(GL_TEXTURE_2D, 0, fmt->gl_format, width, height, 0,
 		fmt->gl_format, fmt->gl_type, data);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
 
 	glBindTexture(GL_TEXTURE_2D, 0);
+	gles2_invalidate_texture_state(renderer);
 
 	pop_gles2_debug(renderer);
 
@@ -260,9 +327,11 @@ struct wlr_texture *gles2_texture_from_wl_drm(struct wlr_renderer *wlr_renderer,
 	glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture->tex);
 	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	renderer->procs.glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES,
 		texture->image);
 	glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+	gles2_invalidate_texture_state(renderer);
 
 	pop_gles2_debug(renderer);
 
@@ -329,8 +398,10 @@ struct wlr_texture *gles2_texture_from_dmabuf(struct wlr_renderer *wlr_renderer,
 	glBindTexture(texture->target, texture->tex);
 	glTexParameteri(texture->target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(texture->target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	renderer->procs.glEGLImageTargetTexture2DOES(texture->target, texture->image);
 	glBindTexture(texture->target, 0);
+	gles2_invalidate_texture_state(renderer);
 
 	pop_gles2_debug(renderer);
 
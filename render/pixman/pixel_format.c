@@ -0,0 +1,96 @@
+#include <drm_fourcc.h>
+#include "render/pixman.h"
+
+/*
+ * DRM formats are little endian while pixman formats are native endian, so
+ * e.g. DRM_FORMAT_ARGB8888 is PIXMAN_a8r8g8b8 on little endian machines and
+ * PIXMAN_b8g8r8a8 on big endian ones.
+ */
+static const struct wlr_pixman_pixel_format formats[] = {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	{
+		.drm_format = DRM_FORMAT_ARGB8888,
+		.pixman_format = PIXMAN_a8r8g8b8,
+	},
+	{
+		.drm_format = DRM_FORMAT_XRGB8888,
+		.pixman_format = PIXMAN_x8r8g8b8,
+	},
+	{
+		.drm_format = DRM_FORMAT_ABGR8888,
+		.pixman_format = PIXMAN_a8b8g8r8,
+	},
+	{
+		.drm_format = DRM_FORMAT_XBGR8888,
+		.pixman_format = PIXMAN_x8b8g8r8,
+	},
+	{
+		.drm_format = DRM_FORMAT_RGBA8888,
+		.pixman_format = PIXMAN_r8g8b8a8,
+	},
+	{
+		.drm_format = DRM_FORMAT_RGBX8888,
+		.pixman_format = PIXMAN_r8g8b8x8,
+	},
+	{
+		.drm_format = DRM_FORMAT_BGRA8888,
+		.pixman_format = PIXMAN_b8g8r8a8,
+	},
+	{
+		.drm_format = DRM_FORMAT_BGRX8888,
+		.pixman_format = PIXMAN_b8g8r8x8,
+	},
+#else
+	{
+		.drm_format = DRM_FORMAT_ARGB8888,
+		.pixman_format = PIXMAN_b8g8r8a8,
+	},
+	{
+		.drm_format = DRM_FORMAT_XRGB8888,
+		.pixman_format = PIXMAN_b8g8r8x8,
+	},
+	{
+		.drm_format = DRM_FORMAT_ABGR8888,
+		.pixman_format = PIXMAN_r8g8b8a8,
+	},
+	{
+		.drm_format = DRM_FORMAT_XBGR8888,
+		.pixman_format = PIXMAN_r8g8b8x8,
+	},
+	{
+		.drm_format = DRM_FORMAT_RGBA8888,
+		.pixman_format = PIXMAN_a8b8g8r8,
+	},
+	{
+		.drm_format = DRM_FORMAT_RGBX8888,
+		.pixman_format = PIXMAN_x8b8g8r8,
+	},
+	{
+		.drm_format = DRM_FORMAT_BGRA8888,
+		.pixman_format = PIXMAN_a8r8g8b8,
+	},
+	{
+		.drm_format = DRM_FORMAT_BGRX8888,
+		.pixman_format = PIXMAN_x8r8g8b8,
+	},
+#endif
+};
+
+const struct wlr_pixman_pixel_format *get_pixman_format_from_drm(
+		uint32_t fmt) {
+	for (size_t i = 0; i < sizeof(formats) / sizeof(*formats); ++i) {
+		if (formats[i].drm_format == fmt) {
+			return &formats[i];
+		}
+	}
+	return NULL;
+}
+
+const uint32_t *get_pixman_shm_formats(size_t *len) {
+	static uint32_t shm_formats[sizeof(formats) / sizeof(formats[0])];
+	*len = sizeof(formats) / sizeof(formats[0]);
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		shm_formats[i] = formats[i].drm_format;
+	}
+	return shm_formats;
+}
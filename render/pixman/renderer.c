@@ -0,0 +1,659 @@
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/render/interface.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "render/pixman.h"
+
+static const struct wlr_renderer_impl renderer_impl;
+static const struct wlr_texture_impl texture_impl;
+
+bool wlr_renderer_is_pixman(struct wlr_renderer *wlr_renderer) {
+	return wlr_renderer->impl == &renderer_impl;
+}
+
+static struct wlr_pixman_renderer *get_renderer(
+		struct wlr_renderer *wlr_renderer) {
+	assert(wlr_renderer_is_pixman(wlr_renderer));
+	return (struct wlr_pixman_renderer *)wlr_renderer;
+}
+
+static struct wlr_pixman_renderer *get_renderer_in_context(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+	assert(renderer->current_buffer != NULL);
+	return renderer;
+}
+
+bool wlr_texture_is_pixman(struct wlr_texture *wlr_texture) {
+	return wlr_texture->impl == &texture_impl;
+}
+
+static struct wlr_pixman_texture *get_texture(
+		struct wlr_texture *wlr_texture) {
+	assert(wlr_texture_is_pixman(wlr_texture));
+	return (struct wlr_pixman_texture *)wlr_texture;
+}
+
+static bool texture_is_opaque(struct wlr_texture *wlr_texture) {
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	return PIXMAN_FORMAT_A(texture->format->pixman_format) == 0;
+}
+
+static bool texture_write_pixels(struct wlr_texture *wlr_texture,
+		uint32_t stride, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
+		const void *data) {
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+
+	uint32_t bytes_per_pixel =
+		PIXMAN_FORMAT_BPP(texture->format->pixman_format) / 8;
+	if (stride % bytes_per_pixel != 0) {
+		wlr_log(WLR_ERROR, "Invalid stride %"PRIu32" (incompatible with "
+			"%"PRIu32" bytes-per-pixel)", stride, bytes_per_pixel);
+		return false;
+	}
+	if (stride < width * bytes_per_pixel) {
+		wlr_log(WLR_ERROR, "Invalid stride %"PRIu32" (too small for "
+			"%"PRIu32" bytes-per-pixel and width %"PRIu32")",
+			stride, bytes_per_pixel, width);
+		return false;
+	}
+	if (dst_x > wlr_texture->width || width > wlr_texture->width - dst_x ||
+			dst_y > wlr_texture->height ||
+			height > wlr_texture->height - dst_y) {
+		wlr_log(WLR_ERROR, "Invalid region %"PRIu32"x%"PRIu32"+%"PRIu32
+			",%"PRIu32" (outside of the %"PRIu32"x%"PRIu32" texture)",
+			width, height, dst_x, dst_y,
+			wlr_texture->width, wlr_texture->height);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < height; ++i) {
+		const char *src = (const char *)data +
+			(src_y + i) * stride + src_x * bytes_per_pixel;
+		char *dst = (char *)texture->data +
+			(dst_y + i) * texture->stride + dst_x * bytes_per_pixel;
+		memcpy(dst, src, width * bytes_per_pixel);
+	}
+
+	return true;
+}
+
+static void texture_destroy(struct wlr_texture *wlr_texture) {
+	if (wlr_texture == NULL) {
+		return;
+	}
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	pixman_image_unref(texture->image);
+	free(texture->data);
+	free(texture);
+}
+
+static const struct wlr_texture_impl texture_impl = {
+	.is_opaque = texture_is_opaque,
+	.write_pixels = texture_write_pixels,
+	.destroy = texture_destroy,
+};
+
+static void destroy_buffer(struct wlr_pixman_buffer *buffer) {
+	wl_list_remove(&buffer->link);
+	wl_list_remove(&buffer->buffer_destroy.link);
+
+	pixman_image_unref(buffer->image);
+
+	free(buffer);
+}
+
+static struct wlr_pixman_buffer *get_buffer(
+		struct wlr_pixman_renderer *renderer, struct wlr_buffer *wlr_buffer) {
+	struct wlr_pixman_buffer *buffer;
+	wl_list_for_each(buffer, &renderer->buffers, link) {
+		if (buffer->buffer == wlr_buffer) {
+			return buffer;
+		}
+	}
+	return NULL;
+}
+
+static void handle_buffer_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_pixman_buffer *buffer =
+		wl_container_of(listener, buffer, buffer_destroy);
+	destroy_buffer(buffer);
+}
+
+static struct wlr_pixman_buffer *create_buffer(
+		struct wlr_pixman_renderer *renderer, struct wlr_buffer *wlr_buffer) {
+	void *data;
+	uint32_t drm_format;
+	size_t stride;
+	if (!wlr_buffer_get_data_ptr(wlr_buffer, &data, &drm_format, &stride)) {
+		wlr_log(WLR_ERROR, "Buffer isn't accessible from the CPU");
+		return NULL;
+	}
+
+	const struct wlr_pixman_pixel_format *format =
+		get_pixman_format_from_drm(drm_format);
+	if (format == NULL) {
+		wlr_log(WLR_ERROR, "Unsupported pixel format 0x%"PRIX32, drm_format);
+		return NULL;
+	}
+
+	struct wlr_pixman_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	buffer->buffer = wlr_buffer;
+	buffer->renderer = renderer;
+	buffer->format = format;
+
+	buffer->image = pixman_image_create_bits_no_clear(format->pixman_format,
+		wlr_buffer->width, wlr_buffer->height, data, stride);
+	if (buffer->image == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		free(buffer);
+		return NULL;
+	}
+
+	buffer->buffer_destroy.notify = handle_buffer_destroy;
+	wl_signal_add(&wlr_buffer->events.destroy, &buffer->buffer_destroy);
+
+	wl_list_insert(&renderer->buffers, &buffer->link);
+
+	wlr_log(WLR_DEBUG, "Created pixman image for buffer %dx%d",
+		wlr_buffer->width, wlr_buffer->height);
+
+	return buffer;
+}
+
+static bool pixman_bind_buffer(struct wlr_renderer *wlr_renderer,
+		struct wlr_buffer *wlr_buffer) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+
+	if (renderer->current_buffer != NULL) {
+		wlr_buffer_unlock(renderer->current_buffer->buffer);
+		renderer->current_buffer = NULL;
+	}
+
+	if (wlr_buffer == NULL) {
+		return true;
+	}
+
+	struct wlr_pixman_buffer *buffer = get_buffer(renderer, wlr_buffer);
+	if (buffer == NULL) {
+		buffer = create_buffer(renderer, wlr_buffer);
+	}
+	if (buffer == NULL) {
+		return false;
+	}
+
+	wlr_buffer_lock(wlr_buffer);
+	renderer->current_buffer = buffer;
+
+	return true;
+}
+
+static void pixman_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
+		uint32_t height) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+	renderer->width = width;
+	renderer->height = height;
+	pixman_image_set_clip_region32(renderer->current_buffer->image, NULL);
+}
+
+static void pixman_end(struct wlr_renderer *wlr_renderer) {
+	get_renderer_in_context(wlr_renderer);
+	// no-op
+}
+
+static pixman_color_t color_to_pixman(const float color[static 4]) {
+	// Both are pre-multiplied
+	return (pixman_color_t){
+		.red = color[0] * 0xFFFF,
+		.green = color[1] * 0xFFFF,
+		.blue = color[2] * 0xFFFF,
+		.alpha = color[3] * 0xFFFF,
+	};
+}
+
+static void pixman_clear(struct wlr_renderer *wlr_renderer,
+		const float color[static 4]) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+
+	pixman_color_t pixman_color = color_to_pixman(color);
+	pixman_box32_t box = {
+		.x2 = renderer->width,
+		.y2 = renderer->height,
+	};
+	pixman_image_fill_boxes(PIXMAN_OP_SRC, renderer->current_buffer->image,
+		&pixman_color, 1, &box);
+}
+
+static void pixman_scissor(struct wlr_renderer *wlr_renderer,
+		struct wlr_box *box) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+
+	if (box == NULL) {
+		pixman_image_set_clip_region32(renderer->current_buffer->image, NULL);
+		return;
+	}
+
+	pixman_region32_t region;
+	pixman_region32_init_rect(&region, box->x, box->y, box->width,
+		box->height);
+	pixman_image_set_clip_region32(renderer->current_buffer->image, &region);
+	pixman_region32_fini(&region);
+}
+
+/**
+ * Turns a matrix mapping the unit square to normalized device coordinates into
+ * a transform mapping it to buffer pixels.
+ */
+static void get_pixel_transform(struct wlr_pixman_renderer *renderer,
+		const float matrix[static 9], struct pixman_f_transform *transform) {
+	double width = renderer->width, height = renderer->height;
+	for (size_t i = 0; i < 3; ++i) {
+		transform->m[0][i] = width / 2 * (matrix[i] + matrix[6 + i]);
+		transform->m[1][i] = height / 2 * (matrix[6 + i] - matrix[3 + i]);
+		transform->m[2][i] = matrix[6 + i];
+	}
+}
+
+/**
+ * Computes the bounding box of the transformed unit square, clipped to the
+ * current buffer. Returns false if it's empty.
+ */
+static bool get_pixel_box(struct wlr_pixman_renderer *renderer,
+		const struct pixman_f_transform *transform, pixman_box32_t *box) {
+	double x1 = INFINITY, y1 = INFINITY, x2 = -INFINITY, y2 = -INFINITY;
+	for (size_t i = 0; i < 4; ++i) {
+		struct pixman_f_vector v = {{ i % 2, i / 2, 1 }};
+		if (!pixman_f_transform_point(transform, &v)) {
+			return false;
+		}
+		x1 = fmin(x1, v.v[0]);
+		y1 = fmin(y1, v.v[1]);
+		x2 = fmax(x2, v.v[0]);
+		y2 = fmax(y2, v.v[1]);
+	}
+
+	box->x1 = fmax(round(x1), 0);
+	box->y1 = fmax(round(y1), 0);
+	box->x2 = fmin(round(x2), renderer->width);
+	box->y2 = fmin(round(y2), renderer->height);
+	return box->x1 < box->x2 && box->y1 < box->y2;
+}
+
+static bool is_axis_aligned(const struct pixman_f_transform *transform) {
+	return transform->m[0][1] == 0 && transform->m[1][0] == 0 &&
+		transform->m[2][0] == 0 && transform->m[2][1] == 0;
+}
+
+static bool is_translation(const struct pixman_f_transform *transform) {
+	return is_axis_aligned(transform) && transform->m[2][2] == 1 &&
+		fabs(transform->m[0][0] - 1) < 1e-6 &&
+		fabs(transform->m[1][1] - 1) < 1e-6;
+}
+
+static bool pixman_render_subtexture_with_matrix(
+		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
+		const struct wlr_fbox *fbox, const float matrix[static 9],
+		float alpha) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+
+	struct pixman_f_transform dst_transform;
+	get_pixel_transform(renderer, matrix, &dst_transform);
+
+	pixman_box32_t dst_box;
+	if (!get_pixel_box(renderer, &dst_transform, &dst_box)) {
+		return true;
+	}
+
+	struct pixman_f_transform inverse;
+	if (!pixman_f_transform_invert(&inverse, &dst_transform)) {
+		return true;
+	}
+
+	// Sample from a view restricted to the source box, so that filtering and
+	// rotated quads never pick texels outside of it
+	int src_x1 = fmax(floor(fbox->x), 0);
+	int src_y1 = fmax(floor(fbox->y), 0);
+	int src_x2 = fmin(ceil(fbox->x + fbox->width), wlr_texture->width);
+	int src_y2 = fmin(ceil(fbox->y + fbox->height), wlr_texture->height);
+	if (src_x1 >= src_x2 || src_y1 >= src_y2) {
+		return true;
+	}
+
+	size_t bytes_per_pixel =
+		PIXMAN_FORMAT_BPP(texture->format->pixman_format) / 8;
+	char *src_data = (char *)texture->data +
+		src_y1 * texture->stride + src_x1 * bytes_per_pixel;
+	pixman_image_t *src = pixman_image_create_bits_no_clear(
+		texture->format->pixman_format, src_x2 - src_x1, src_y2 - src_y1,
+		(uint32_t *)src_data, texture->stride);
+	if (src == NULL) {
+		return false;
+	}
+
+	// pixman transforms map destination pixels to source texels
+	struct pixman_f_transform src_transform = {{
+		{ fbox->width, 0, fbox->x - src_x1 },
+		{ 0, fbox->height, fbox->y - src_y1 },
+		{ 0, 0, 1 },
+	}};
+	pixman_f_transform_multiply(&src_transform, &src_transform, &inverse);
+
+	struct pixman_transform transform;
+	pixman_transform_from_pixman_f_transform(&transform, &src_transform);
+	pixman_image_set_transform(src, &transform);
+	pixman_image_set_filter(src, is_translation(&src_transform) ?
+		PIXMAN_FILTER_NEAREST : PIXMAN_FILTER_BILINEAR, NULL, 0);
+
+	pixman_image_t *mask = NULL;
+	if (alpha < 1.0) {
+		pixman_color_t mask_color = { .alpha = alpha * 0xFFFF };
+		mask = pixman_image_create_solid_fill(&mask_color);
+	}
+
+	pixman_image_composite32(PIXMAN_OP_OVER, src, mask,
+		renderer->current_buffer->image, dst_box.x1, dst_box.y1, 0, 0,
+		dst_box.x1, dst_box.y1, dst_box.x2 - dst_box.x1,
+		dst_box.y2 - dst_box.y1);
+
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	pixman_image_unref(src);
+
+	return true;
+}
+
+static void pixman_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
+		const float color[static 4], const float matrix[static 9]) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+
+	struct pixman_f_transform dst_transform;
+	get_pixel_transform(renderer, matrix, &dst_transform);
+
+	pixman_box32_t dst_box;
+	if (!get_pixel_box(renderer, &dst_transform, &dst_box)) {
+		return;
+	}
+
+	pixman_color_t pixman_color = color_to_pixman(color);
+	if (is_axis_aligned(&dst_transform)) {
+		pixman_op_t op = color[3] == 1.0 ? PIXMAN_OP_SRC : PIXMAN_OP_OVER;
+		pixman_image_fill_boxes(op, renderer->current_buffer->image,
+			&pixman_color, 1, &dst_box);
+		return;
+	}
+
+	struct pixman_f_transform inverse;
+	if (!pixman_f_transform_invert(&inverse, &dst_transform)) {
+		return;
+	}
+
+	// Rotated quads are drawn through a transformed 1x1 mask, which gives us
+	// anti-aliased edges for free
+	uint32_t mask_data = 0xFFFFFFFF;
+	pixman_image_t *mask = pixman_image_create_bits_no_clear(PIXMAN_a8, 1, 1,
+		&mask_data, sizeof(mask_data));
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+	if (mask == NULL || src == NULL) {
+		goto out;
+	}
+
+	struct pixman_transform transform;
+	pixman_transform_from_pixman_f_transform(&transform, &inverse);
+	pixman_image_set_transform(mask, &transform);
+	pixman_image_set_filter(mask, PIXMAN_FILTER_BILINEAR, NULL, 0);
+
+	pixman_image_composite32(PIXMAN_OP_OVER, src, mask,
+		renderer->current_buffer->image, 0, 0, dst_box.x1, dst_box.y1,
+		dst_box.x1, dst_box.y1, dst_box.x2 - dst_box.x1,
+		dst_box.y2 - dst_box.y1);
+
+out:
+	if (src != NULL) {
+		pixman_image_unref(src);
+	}
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+}
+
+static void pixman_render_ellipse_with_matrix(
+		struct wlr_renderer *wlr_renderer, const float color[static 4],
+		const float matrix[static 9]) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+
+	struct pixman_f_transform dst_transform;
+	get_pixel_transform(renderer, matrix, &dst_transform);
+
+	pixman_box32_t dst_box;
+	if (!get_pixel_box(renderer, &dst_transform, &dst_box)) {
+		return;
+	}
+
+	struct pixman_f_transform inverse;
+	if (!pixman_f_transform_invert(&inverse, &dst_transform)) {
+		return;
+	}
+
+	int width = dst_box.x2 - dst_box.x1;
+	int height = dst_box.y2 - dst_box.y1;
+	int stride = (width + 3) & ~3;
+	uint8_t *mask_data = calloc(stride * height, 1);
+	if (mask_data == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			struct pixman_f_vector v = {{
+				dst_box.x1 + x + 0.5, dst_box.y1 + y + 0.5, 1,
+			}};
+			if (!pixman_f_transform_point(&inverse, &v)) {
+				continue;
+			}
+			double dx = v.v[0] - 0.5, dy = v.v[1] - 0.5;
+			if (dx * dx + dy * dy <= 0.25) {
+				mask_data[y * stride + x] = 0xFF;
+			}
+		}
+	}
+
+	pixman_color_t pixman_color = color_to_pixman(color);
+	pixman_image_t *mask = pixman_image_create_bits_no_clear(PIXMAN_a8,
+		width, height, (uint32_t *)mask_data, stride);
+	pixman_image_t *src = pixman_image_create_solid_fill(&pixman_color);
+	if (mask != NULL && src != NULL) {
+		pixman_image_composite32(PIXMAN_OP_OVER, src, mask,
+			renderer->current_buffer->image, 0, 0, 0, 0,
+			dst_box.x1, dst_box.y1, width, height);
+	}
+
+	if (src != NULL) {
+		pixman_image_unref(src);
+	}
+	if (mask != NULL) {
+		pixman_image_unref(mask);
+	}
+	free(mask_data);
+}
+
+static const uint32_t *pixman_get_shm_texture_formats(
+		struct wlr_renderer *wlr_renderer, size_t *len) {
+	return get_pixman_shm_formats(len);
+}
+
+static const struct wlr_drm_format_set *pixman_get_dmabuf_render_formats(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+	return &renderer->render_formats;
+}
+
+static uint32_t pixman_preferred_read_format(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+	return renderer->current_buffer->format->drm_format;
+}
+
+static bool pixman_read_pixels(struct wlr_renderer *wlr_renderer,
+		uint32_t drm_format, uint32_t *flags, uint32_t stride,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y,
+		uint32_t dst_x, uint32_t dst_y, void *data) {
+	struct wlr_pixman_renderer *renderer =
+		get_renderer_in_context(wlr_renderer);
+
+	const struct wlr_pixman_pixel_format *fmt =
+		get_pixman_format_from_drm(drm_format);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return false;
+	}
+
+	pixman_image_t *dst = pixman_image_create_bits_no_clear(
+		fmt->pixman_format, dst_x + width, dst_y + height, data, stride);
+	if (dst == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		return false;
+	}
+
+	pixman_image_composite32(PIXMAN_OP_SRC, renderer->current_buffer->image,
+		NULL, dst, src_x, src_y, 0, 0, dst_x, dst_y, width, height);
+
+	pixman_image_unref(dst);
+
+	if (flags != NULL) {
+		*flags = 0;
+	}
+
+	return true;
+}
+
+static struct wlr_texture *pixman_texture_from_pixels(
+		struct wlr_renderer *wlr_renderer, uint32_t drm_format,
+		uint32_t stride, uint32_t width, uint32_t height, const void *data) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+
+	const struct wlr_pixman_pixel_format *fmt =
+		get_pixman_format_from_drm(drm_format);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Unsupported pixel format 0x%"PRIX32, drm_format);
+		return NULL;
+	}
+
+	struct wlr_pixman_texture *texture =
+		calloc(1, sizeof(struct wlr_pixman_texture));
+	if (texture == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_texture_init(&texture->wlr_texture, &texture_impl, width, height);
+	texture->renderer = renderer;
+	texture->format = fmt;
+
+	// Keep our own copy: clients may modify or release the shm pool at any
+	// time, and pixman requires 4-byte aligned rows
+	texture->stride = width * (PIXMAN_FORMAT_BPP(fmt->pixman_format) / 8);
+	texture->data = malloc(texture->stride * height);
+	if (texture->data == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		free(texture);
+		return NULL;
+	}
+	texture_write_pixels(&texture->wlr_texture, stride, width, height,
+		0, 0, 0, 0, data);
+
+	texture->image = pixman_image_create_bits_no_clear(fmt->pixman_format,
+		width, height, texture->data, texture->stride);
+	if (texture->image == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create pixman image");
+		free(texture->data);
+		free(texture);
+		return NULL;
+	}
+
+	return &texture->wlr_texture;
+}
+
+static void pixman_destroy(struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+
+	struct wlr_pixman_buffer *buffer, *buffer_tmp;
+	wl_list_for_each_safe(buffer, buffer_tmp, &renderer->buffers, link) {
+		destroy_buffer(buffer);
+	}
+
+	wlr_drm_format_set_finish(&renderer->render_formats);
+
+	free(renderer);
+}
+
+static const struct wlr_renderer_impl renderer_impl = {
+	.destroy = pixman_destroy,
+	.bind_buffer = pixman_bind_buffer,
+	.begin = pixman_begin,
+	.end = pixman_end,
+	.clear = pixman_clear,
+	.scissor = pixman_scissor,
+	.render_subtexture_with_matrix = pixman_render_subtexture_with_matrix,
+	.render_quad_with_matrix = pixman_render_quad_with_matrix,
+	.render_ellipse_with_matrix = pixman_render_ellipse_with_matrix,
+	.get_shm_texture_formats = pixman_get_shm_texture_formats,
+	.get_dmabuf_render_formats = pixman_get_dmabuf_render_formats,
+	.preferred_read_format = pixman_preferred_read_format,
+	.read_pixels = pixman_read_pixels,
+	.texture_from_pixels = pixman_texture_from_pixels,
+};
+
+struct wlr_renderer *wlr_pixman_renderer_create(void) {
+	struct wlr_pixman_renderer *renderer =
+		calloc(1, sizeof(struct wlr_pixman_renderer));
+	if (renderer == NULL) {
+		return NULL;
+	}
+
+	wlr_log(WLR_INFO, "Creating pixman renderer");
+	wlr_renderer_init(&renderer->wlr_renderer, &renderer_impl);
+	wl_list_init(&renderer->buffers);
+
+	// We can render into any linear buffer we can map
+	size_t len = 0;
+	const uint32_t *formats = get_pixman_shm_formats(&len);
+	for (size_t i = 0; i < len; ++i) {
+		wlr_drm_format_set_add(&renderer->render_formats, formats[i],
+			DRM_FORMAT_MOD_LINEAR);
+	}
+
+	return &renderer->wlr_renderer;
+}
+
+pixman_image_t *wlr_pixman_renderer_get_current_image(
+		struct wlr_renderer *wlr_renderer) {
+	struct wlr_pixman_renderer *renderer = get_renderer(wlr_renderer);
+	if (renderer->current_buffer == NULL) {
+		return NULL;
+	}
+	return renderer->current_buffer->image;
+}
+
+pixman_image_t *wlr_pixman_texture_get_image(struct wlr_texture *wlr_texture) {
+	struct wlr_pixman_texture *texture = get_texture(wlr_texture);
+	return texture->image;
+}
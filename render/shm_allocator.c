@@ -0,0 +1,135 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <drm_fourcc.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <wlr/util/log.h>
+#include "render/shm_allocator.h"
+#include "util/shm.h"
+
+static const struct wlr_buffer_impl buffer_impl;
+
+static struct wlr_shm_buffer *shm_buffer_from_buffer(
+		struct wlr_buffer *wlr_buffer) {
+	assert(wlr_buffer->impl == &buffer_impl);
+	return (struct wlr_shm_buffer *)wlr_buffer;
+}
+
+static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
+	munmap(buffer->data, buffer->size);
+	close(buffer->fd);
+	free(buffer);
+}
+
+static bool buffer_get_data_ptr(struct wlr_buffer *wlr_buffer, void **data,
+		uint32_t *format, size_t *stride) {
+	struct wlr_shm_buffer *buffer = shm_buffer_from_buffer(wlr_buffer);
+	*data = buffer->data;
+	*format = buffer->format;
+	*stride = buffer->stride;
+	return true;
+}
+
+static const struct wlr_buffer_impl buffer_impl = {
+	.destroy = buffer_destroy,
+	.get_data_ptr = buffer_get_data_ptr,
+};
+
+static int get_bytes_per_pixel(uint32_t format) {
+	switch (format) {
+	case DRM_FORMAT_ARGB8888:
+	case DRM_FORMAT_XRGB8888:
+	case DRM_FORMAT_ABGR8888:
+	case DRM_FORMAT_XBGR8888:
+	case DRM_FORMAT_RGBA8888:
+	case DRM_FORMAT_RGBX8888:
+	case DRM_FORMAT_BGRA8888:
+	case DRM_FORMAT_BGRX8888:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+static bool format_allows_linear(const struct wlr_drm_format *format) {
+	if (format->len == 0) {
+		return true;
+	}
+	for (size_t i = 0; i < format->len; ++i) {
+		if (format->modifiers[i] == DRM_FORMAT_MOD_LINEAR ||
+				format->modifiers[i] == DRM_FORMAT_MOD_INVALID) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static struct wlr_buffer *allocator_create_buffer(
+		struct wlr_allocator *wlr_alloc, int width, int height,
+		const struct wlr_drm_format *format) {
+	int bytes_per_pixel = get_bytes_per_pixel(format->format);
+	if (bytes_per_pixel == 0) {
+		wlr_log(WLR_ERROR, "Unsupported pixel format 0x%"PRIX32,
+			format->format);
+		return NULL;
+	}
+	if (!format_allows_linear(format)) {
+		wlr_log(WLR_ERROR, "Shared memory buffers can only be linear");
+		return NULL;
+	}
+
+	struct wlr_shm_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		return NULL;
+	}
+	wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+
+	buffer->format = format->format;
+	buffer->stride = (size_t)width * bytes_per_pixel;
+	buffer->size = buffer->stride * height;
+
+	buffer->fd = allocate_shm_file(buffer->size);
+	if (buffer->fd < 0) {
+		wlr_log(WLR_ERROR, "Failed to allocate shared memory file");
+		free(buffer);
+		return NULL;
+	}
+
+	buffer->data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE,
+		MAP_SHARED, buffer->fd, 0);
+	if (buffer->data == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "mmap failed");
+		close(buffer->fd);
+		free(buffer);
+		return NULL;
+	}
+
+	wlr_log(WLR_DEBUG, "Allocated %dx%d shared memory buffer "
+		"(format 0x%"PRIX32")", width, height, buffer->format);
+
+	return &buffer->base;
+}
+
+static void allocator_destroy(struct wlr_allocator *wlr_alloc) {
+	free(wlr_alloc);
+}
+
+static const struct wlr_allocator_interface allocator_impl = {
+	.destroy = allocator_destroy,
+	.create_buffer = allocator_create_buffer,
+};
+
+struct wlr_shm_allocator *wlr_shm_allocator_create(void) {
+	struct wlr_shm_allocator *alloc = calloc(1, sizeof(*alloc));
+	if (alloc == NULL) {
+		return NULL;
+	}
+	wlr_allocator_init(&alloc->base, &allocator_impl);
+
+	wlr_log(WLR_DEBUG, "Created shared memory allocator");
+
+	return alloc;
+}
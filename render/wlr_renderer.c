@@ -1,10 +1,12 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <gbm.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/gles2.h>
 #include <wlr/render/interface.h>
+#include <wlr/render/pixman.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/util/log.h>
@@ -114,6 +116,46 @@ bool wlr_render_subtexture_with_matrix(struct wlr_renderer *r,
 		box, matrix, alpha);
 }
 
+bool wlr_render_texture_region_with_matrix(struct wlr_renderer *r,
+		struct wlr_texture *texture, const float matrix[static 9], float alpha,
+		pixman_region32_t *region) {
+	struct wlr_fbox box = {
+		.x = 0,
+		.y = 0,
+		.width = texture->width,
+		.height = texture->height,
+	};
+	return wlr_render_subtexture_region_with_matrix(r, texture, &box, matrix,
+		alpha, region);
+}
+
+bool wlr_render_subtexture_region_with_matrix(struct wlr_renderer *r,
+		struct wlr_texture *texture, const struct wlr_fbox *box,
+		const float matrix[static 9], float alpha, pixman_region32_t *region) {
+	assert(r->rendering);
+	if (r->impl->render_subtexture_region_with_matrix) {
+		return r->impl->render_subtexture_region_with_matrix(r, texture, box,
+			matrix, alpha, region);
+	}
+
+	bool ok = true;
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+	for (int i = 0; i < nrects; i++) {
+		struct wlr_box scissor = {
+			.x = rects[i].x1,
+			.y = rects[i].y1,
+			.width = rects[i].x2 - rects[i].x1,
+			.height = rects[i].y2 - rects[i].y1,
+		};
+		wlr_renderer_scissor(r, &scissor);
+		ok = r->impl->render_subtexture_with_matrix(r, texture, box,
+			matrix, alpha) && ok;
+	}
+	wlr_renderer_scissor(r, NULL);
+	return ok;
+}
+
 void wlr_render_rect(struct wlr_renderer *r, const struct wlr_box *box,
 		const float color[static 4], const float projection[static 9]) {
 	if (box->width == 0 || box->height == 0) {
@@ -200,6 +242,23 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, uint32_t fmt,
 		src_x, src_y, dst_x, dst_y, data);
 }
 
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+		struct wlr_renderer *r, uint32_t fmt, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y, wlr_renderer_read_pixels_func_t done,
+		void *user_data) {
+	if (!r->impl->read_pixels_async) {
+		return NULL;
+	}
+	return r->impl->read_pixels_async(r, fmt, width, height, src_x, src_y,
+		done, user_data);
+}
+
+void wlr_renderer_readback_cancel(struct wlr_renderer_readback *readback) {
+	struct wlr_renderer *r = readback->renderer;
+	assert(r->impl->cancel_readback);
+	r->impl->cancel_readback(readback);
+}
+
 bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 		struct wlr_dmabuf_attributes *dst,
 		struct wlr_dmabuf_attributes *src) {
@@ -207,7 +266,29 @@ bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 	if (!r->impl->blit_dmabuf) {
 		return false;
 	}
-	return r->impl->blit_dmabuf(r, dst, src);
+	struct wlr_box src_box = {
+		.width = src->width,
+		.height = src->height,
+	};
+	return r->impl->blit_dmabuf(r, dst, src, &src_box);
+}
+
+bool wlr_renderer_blit_dmabuf_region(struct wlr_renderer *r,
+		struct wlr_dmabuf_attributes *dst,
+		struct wlr_dmabuf_attributes *src,
+		const struct wlr_box *src_box) {
+	assert(!r->rendering);
+	if (!r->impl->blit_dmabuf) {
+		return false;
+	}
+	if (src_box->x < 0 || src_box->y < 0 ||
+			src_box->x + src_box->width > src->width ||
+			src_box->y + src_box->height > src->height ||
+			src_box->width != dst->width || src_box->height != dst->height) {
+		wlr_log(WLR_ERROR, "Invalid blit region");
+		return false;
+	}
+	return r->impl->blit_dmabuf(r, dst, src, src_box);
 }
 
 bool wlr_renderer_init_wl_display(struct wlr_renderer *r,
@@ -277,6 +358,14 @@ struct wlr_renderer *wlr_renderer_autocreate_with_drm_fd(int drm_fd) {
 }
 
 struct wlr_renderer *wlr_renderer_autocreate(struct wlr_backend *backend) {
+	const char *name = getenv("WLR_RENDERER");
+	if (name != NULL && strcmp(name, "pixman") == 0) {
+		return wlr_pixman_renderer_create();
+	} else if (name != NULL && strcmp(name, "gles2") != 0) {
+		wlr_log(WLR_ERROR, "Unknown renderer '%s'", name);
+		return NULL;
+	}
+
 	int drm_fd = backend_get_drm_fd(backend);
 	if (drm_fd < 0) {
 		wlr_log(WLR_ERROR, "Failed to get DRM FD from backend");
@@ -292,3 +381,18 @@ int wlr_renderer_get_drm_fd(struct wlr_renderer *r) {
 	}
 	return r->impl->get_drm_fd(r);
 }
+
+int wlr_renderer_create_fence_fd(struct wlr_renderer *r) {
+	if (!r->impl->create_fence_fd) {
+		return -1;
+	}
+	return r->impl->create_fence_fd(r);
+}
+
+bool wlr_renderer_wait_fence_fd(struct wlr_renderer *r, int fd) {
+	assert(r->rendering);
+	if (!r->impl->wait_fence_fd) {
+		return false;
+	}
+	return r->impl->wait_fence_fd(r, fd);
+}
@@ -66,6 +66,100 @@ bool wlr_texture_write_pixels(struct wlr_texture *texture,
 		src_x, src_y, dst_x, dst_y, data);
 }
 
+// Fixed cost of an upload, expressed in pixels: merging two rectangles is
+// worth it if the bounding box wastes fewer pixels than this
+#define UPLOAD_BOX_COST (64 * 64)
+
+static int64_t box_area(const pixman_box32_t *box) {
+	return (int64_t)(box->x2 - box->x1) * (box->y2 - box->y1);
+}
+
+/**
+ * Greedily merge the rectangles of a region, in pixman's banded order. Merged
+ * boxes may overlap, which only means some pixels are uploaded twice.
+ */
+static size_t coalesce_upload_boxes(pixman_region32_t *region,
+		pixman_box32_t *boxes) {
+	int rects_len;
+	const pixman_box32_t *rects = pixman_region32_rectangles(region, &rects_len);
+	if (rects_len == 0) {
+		return 0;
+	}
+
+	size_t boxes_len = 0;
+	pixman_box32_t cur = rects[0];
+	int64_t cur_area = box_area(&cur);
+	for (int i = 1; i < rects_len; i++) {
+		const pixman_box32_t *rect = &rects[i];
+		pixman_box32_t merged = {
+			.x1 = cur.x1 < rect->x1 ? cur.x1 : rect->x1,
+			.y1 = cur.y1 < rect->y1 ? cur.y1 : rect->y1,
+			.x2 = cur.x2 > rect->x2 ? cur.x2 : rect->x2,
+			.y2 = cur.y2 > rect->y2 ? cur.y2 : rect->y2,
+		};
+		int64_t rect_area = box_area(rect);
+		if (box_area(&merged) - cur_area - rect_area <= UPLOAD_BOX_COST) {
+			cur = merged;
+			cur_area += rect_area;
+		} else {
+			boxes[boxes_len++] = cur;
+			cur = *rect;
+			cur_area = rect_area;
+		}
+	}
+	boxes[boxes_len++] = cur;
+
+	return boxes_len;
+}
+
+bool wlr_texture_write_pixels_region(struct wlr_texture *texture,
+		uint32_t stride, pixman_region32_t *region, const void *data,
+		size_t *uploaded_bytes) {
+	if (uploaded_bytes != NULL) {
+		*uploaded_bytes = 0;
+	}
+
+	pixman_region32_t clipped;
+	pixman_region32_init(&clipped);
+	pixman_region32_intersect_rect(&clipped, region, 0, 0,
+		texture->width, texture->height);
+
+	int rects_len;
+	pixman_region32_rectangles(&clipped, &rects_len);
+	pixman_box32_t *boxes = calloc(rects_len > 0 ? rects_len : 1,
+		sizeof(pixman_box32_t));
+	if (boxes == NULL) {
+		pixman_region32_fini(&clipped);
+		return false;
+	}
+	size_t boxes_len = coalesce_upload_boxes(&clipped, boxes);
+	pixman_region32_fini(&clipped);
+
+	bool ok = true;
+	if (boxes_len == 0) {
+		// Nothing to upload
+	} else if (texture->impl->write_pixels_boxes) {
+		ok = texture->impl->write_pixels_boxes(texture, stride, boxes,
+			boxes_len, data, uploaded_bytes);
+	} else {
+		size_t bytes = 0;
+		for (size_t i = 0; i < boxes_len && ok; i++) {
+			pixman_box32_t *box = &boxes[i];
+			ok = wlr_texture_write_pixels(texture, stride,
+				box->x2 - box->x1, box->y2 - box->y1, box->x1, box->y1,
+				box->x1, box->y1, data);
+			// Estimate the pixel size from the stride
+			bytes += box_area(box) * (stride / texture->width);
+		}
+		if (ok && uploaded_bytes != NULL) {
+			*uploaded_bytes = bytes;
+		}
+	}
+
+	free(boxes);
+	return ok;
+}
+
 bool wlr_texture_to_dmabuf(struct wlr_texture *texture,
 		struct wlr_dmabuf_attributes *attribs) {
 	if (!texture->impl->to_dmabuf) {
@@ -0,0 +1,1023 @@
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_linux_explicit_synchronization_v1.h>
+#include <wlr/types/wlr_matrix.h>
+#include <wlr/types/wlr_output_damage.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include <wlr/util/region.h>
+#include "util/signal.h"
+
+static struct wlr_scene *scene_root_from_node(struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_ROOT);
+	return (struct wlr_scene *)node;
+}
+
+struct wlr_scene_surface *wlr_scene_surface_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_SURFACE);
+	return (struct wlr_scene_surface *)node;
+}
+
+static struct wlr_scene_rect *scene_rect_from_node(
+		struct wlr_scene_node *node) {
+	assert(node->type == WLR_SCENE_NODE_RECT);
+	return (struct wlr_scene_rect *)node;
+}
+
+static struct wlr_scene *scene_node_get_root(struct wlr_scene_node *node) {
+	while (node->parent != NULL) {
+		node = node->parent;
+	}
+	return scene_root_from_node(node);
+}
+
+static void scene_node_state_init(struct wlr_scene_node_state *state) {
+	wl_list_init(&state->children);
+	wl_list_init(&state->link);
+	state->enabled = true;
+}
+
+static void scene_node_state_finish(struct wlr_scene_node_state *state) {
+	wl_list_remove(&state->link);
+}
+
+static void scene_node_init(struct wlr_scene_node *node,
+		enum wlr_scene_node_type type, struct wlr_scene_node *parent) {
+	assert(type == WLR_SCENE_NODE_ROOT || parent != NULL);
+
+	node->type = type;
+	node->parent = parent;
+	scene_node_state_init(&node->state);
+	wl_signal_init(&node->events.destroy);
+
+	if (parent != NULL) {
+		wl_list_insert(parent->state.children.prev, &node->state.link);
+	}
+}
+
+static void scene_node_damage_whole(struct wlr_scene_node *node);
+
+static void scene_node_destroy(struct wlr_scene_node *node) {
+	wlr_signal_emit_safe(&node->events.destroy, node);
+
+	struct wlr_scene_node *child, *child_tmp;
+	wl_list_for_each_safe(child, child_tmp,
+			&node->state.children, state.link) {
+		scene_node_destroy(child);
+	}
+
+	scene_node_state_finish(&node->state);
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:;
+		struct wlr_scene *scene = scene_root_from_node(node);
+		struct wlr_scene_output *scene_output, *scene_output_tmp;
+		wl_list_for_each_safe(scene_output, scene_output_tmp,
+				&scene->outputs, link) {
+			wlr_scene_output_destroy(scene_output);
+		}
+		free(scene);
+		break;
+	case WLR_SCENE_NODE_TREE:;
+		struct wlr_scene_tree *tree = (struct wlr_scene_tree *)node;
+		free(tree);
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		wl_list_remove(&scene_surface->surface_commit.link);
+		wl_list_remove(&scene_surface->surface_destroy.link);
+		free(scene_surface);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(node);
+		free(rect);
+		break;
+	}
+}
+
+void wlr_scene_node_destroy(struct wlr_scene_node *node) {
+	if (node == NULL) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	scene_node_destroy(node);
+}
+
+struct wlr_scene *wlr_scene_create(void) {
+	struct wlr_scene *scene = calloc(1, sizeof(struct wlr_scene));
+	if (scene == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene->node, WLR_SCENE_NODE_ROOT, NULL);
+	wl_list_init(&scene->outputs);
+	return scene;
+}
+
+struct wlr_scene_tree *wlr_scene_tree_create(struct wlr_scene_node *parent) {
+	struct wlr_scene_tree *tree =
+		calloc(1, sizeof(struct wlr_scene_tree));
+	if (tree == NULL) {
+		return NULL;
+	}
+	scene_node_init(&tree->node, WLR_SCENE_NODE_TREE, parent);
+	return tree;
+}
+
+static int scale_length(int length, int offset, float scale) {
+	return round((offset + length) * scale) - round(offset * scale);
+}
+
+static void scale_box(struct wlr_box *box, float scale) {
+	box->width = scale_length(box->width, box->x, scale);
+	box->height = scale_length(box->height, box->y, scale);
+	box->x = round(box->x * scale);
+	box->y = round(box->y * scale);
+}
+
+static void scene_output_damage_region(struct wlr_scene_output *scene_output,
+		pixman_region32_t *damage, int buffer_scale) {
+	struct wlr_output *output = scene_output->output;
+
+	pixman_region32_t output_damage;
+	pixman_region32_init(&output_damage);
+	pixman_region32_copy(&output_damage, damage);
+	pixman_region32_translate(&output_damage,
+		-scene_output->x, -scene_output->y);
+	wlr_region_scale(&output_damage, &output_damage, output->scale);
+	if (ceil(output->scale) > buffer_scale) {
+		// The buffer is upscaled, damage the pixels sampled by the linear
+		// filter around the damaged area as well
+		wlr_region_expand(&output_damage, &output_damage,
+			ceil(output->scale) - buffer_scale);
+	}
+
+	int width, height;
+	wlr_output_transformed_resolution(output, &width, &height);
+	pixman_region32_intersect_rect(&output_damage, &output_damage,
+		0, 0, width, height);
+	if (pixman_region32_not_empty(&output_damage)) {
+		wlr_output_damage_add(scene_output->damage, &output_damage);
+	}
+	pixman_region32_fini(&output_damage);
+}
+
+static void scene_surface_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_destroy);
+	wlr_scene_node_destroy(&scene_surface->node);
+}
+
+static void scene_surface_handle_surface_commit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wl_container_of(listener, scene_surface, surface_commit);
+	struct wlr_surface *surface = scene_surface->surface;
+
+	struct wlr_scene *scene = scene_node_get_root(&scene_surface->node);
+	if (wl_list_empty(&scene->outputs)) {
+		return;
+	}
+
+	int lx, ly;
+	if (!wlr_scene_node_coords(&scene_surface->node, &lx, &ly)) {
+		return;
+	}
+
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	wlr_surface_get_effective_damage(surface, &damage);
+	pixman_region32_translate(&damage, lx, ly);
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		scene_output_damage_region(scene_output, &damage,
+			surface->current.scale);
+	}
+
+	pixman_region32_fini(&damage);
+}
+
+struct wlr_scene_surface *wlr_scene_surface_create(struct wlr_scene_node *parent,
+		struct wlr_surface *surface) {
+	struct wlr_scene_surface *scene_surface =
+		calloc(1, sizeof(struct wlr_scene_surface));
+	if (scene_surface == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_surface->node, WLR_SCENE_NODE_SURFACE, parent);
+
+	scene_surface->surface = surface;
+
+	scene_surface->surface_destroy.notify =
+		scene_surface_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &scene_surface->surface_destroy);
+
+	scene_surface->surface_commit.notify = scene_surface_handle_surface_commit;
+	wl_signal_add(&surface->events.commit, &scene_surface->surface_commit);
+
+	scene_node_damage_whole(&scene_surface->node);
+
+	return scene_surface;
+}
+
+struct wlr_scene_rect *wlr_scene_rect_create(struct wlr_scene_node *parent,
+		int width, int height, const float color[static 4]) {
+	struct wlr_scene_rect *scene_rect =
+		calloc(1, sizeof(struct wlr_scene_rect));
+	if (scene_rect == NULL) {
+		return NULL;
+	}
+	scene_node_init(&scene_rect->node, WLR_SCENE_NODE_RECT, parent);
+
+	scene_rect->width = width;
+	scene_rect->height = height;
+	memcpy(scene_rect->color, color, sizeof(scene_rect->color));
+
+	scene_node_damage_whole(&scene_rect->node);
+
+	return scene_rect;
+}
+
+void wlr_scene_rect_set_size(struct wlr_scene_rect *rect, int width, int height) {
+	if (rect->width == width && rect->height == height) {
+		return;
+	}
+
+	scene_node_damage_whole(&rect->node);
+	rect->width = width;
+	rect->height = height;
+	scene_node_damage_whole(&rect->node);
+}
+
+void wlr_scene_rect_set_color(struct wlr_scene_rect *rect,
+		const float color[static 4]) {
+	if (memcmp(rect->color, color, sizeof(rect->color)) == 0) {
+		return;
+	}
+
+	memcpy(rect->color, color, sizeof(rect->color));
+	scene_node_damage_whole(&rect->node);
+}
+
+static void scene_node_get_size(struct wlr_scene_node *node,
+		int *width, int *height) {
+	*width = 0;
+	*height = 0;
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		return;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		*width = scene_surface->surface->current.width;
+		*height = scene_surface->surface->current.height;
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *scene_rect = scene_rect_from_node(node);
+		*width = scene_rect->width;
+		*height = scene_rect->height;
+		break;
+	}
+}
+
+static void _scene_node_damage_whole(struct wlr_scene_node *node,
+		struct wlr_scene *scene, int lx, int ly) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		_scene_node_damage_whole(child, scene,
+			lx + child->state.x, ly + child->state.y);
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	if (width <= 0 || height <= 0) {
+		return;
+	}
+
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		struct wlr_box box = {
+			.x = lx - scene_output->x,
+			.y = ly - scene_output->y,
+			.width = width,
+			.height = height,
+		};
+		scale_box(&box, scene_output->output->scale);
+
+		struct wlr_box output_box = {0};
+		wlr_output_transformed_resolution(scene_output->output,
+			&output_box.width, &output_box.height);
+
+		struct wlr_box intersection;
+		if (wlr_box_intersection(&intersection, &box, &output_box)) {
+			wlr_output_damage_add_box(scene_output->damage, &intersection);
+		}
+	}
+}
+
+static void scene_node_damage_whole(struct wlr_scene_node *node) {
+	struct wlr_scene *scene = scene_node_get_root(node);
+	if (wl_list_empty(&scene->outputs)) {
+		return;
+	}
+
+	int lx, ly;
+	if (!wlr_scene_node_coords(node, &lx, &ly)) {
+		return;
+	}
+
+	_scene_node_damage_whole(node, scene, lx, ly);
+}
+
+void wlr_scene_node_set_enabled(struct wlr_scene_node *node, bool enabled) {
+	if (node->state.enabled == enabled) {
+		return;
+	}
+
+	// One of these damage_whole() calls will short-circuit and be a no-op
+	scene_node_damage_whole(node);
+	node->state.enabled = enabled;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_set_position(struct wlr_scene_node *node, int x, int y) {
+	if (node->state.x == x && node->state.y == y) {
+		return;
+	}
+
+	scene_node_damage_whole(node);
+	node->state.x = x;
+	node->state.y = y;
+	scene_node_damage_whole(node);
+}
+
+void wlr_scene_node_place_above(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.prev == &sibling->state.link) {
+		return;
+	}
+
+	wl_list_remove(&node->state.link);
+	wl_list_insert(&sibling->state.link, &node->state.link);
+
+	scene_node_damage_whole(node);
+	scene_node_damage_whole(sibling);
+}
+
+void wlr_scene_node_place_below(struct wlr_scene_node *node,
+		struct wlr_scene_node *sibling) {
+	assert(node != sibling);
+	assert(node->parent == sibling->parent);
+
+	if (node->state.link.next == &sibling->state.link) {
+		return;
+	}
+
+	wl_list_remove(&node->state.link);
+	wl_list_insert(sibling->state.link.prev, &node->state.link);
+
+	scene_node_damage_whole(node);
+	scene_node_damage_whole(sibling);
+}
+
+void wlr_scene_node_raise_to_top(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_top = wl_container_of(
+		node->parent->state.children.prev, current_top, state.link);
+	if (node == current_top) {
+		return;
+	}
+	wlr_scene_node_place_above(node, current_top);
+}
+
+void wlr_scene_node_lower_to_bottom(struct wlr_scene_node *node) {
+	struct wlr_scene_node *current_bottom = wl_container_of(
+		node->parent->state.children.next, current_bottom, state.link);
+	if (node == current_bottom) {
+		return;
+	}
+	wlr_scene_node_place_below(node, current_bottom);
+}
+
+void wlr_scene_node_reparent(struct wlr_scene_node *node,
+		struct wlr_scene_node *new_parent) {
+	assert(node->type != WLR_SCENE_NODE_ROOT && new_parent != NULL);
+
+	if (node->parent == new_parent) {
+		return;
+	}
+
+	/* Ensure that a node cannot become its own ancestor */
+	for (struct wlr_scene_node *ancestor = new_parent; ancestor != NULL;
+			ancestor = ancestor->parent) {
+		assert(ancestor != node);
+	}
+
+	scene_node_damage_whole(node);
+
+	wl_list_remove(&node->state.link);
+	node->parent = new_parent;
+	wl_list_insert(new_parent->state.children.prev, &node->state.link);
+
+	scene_node_damage_whole(node);
+}
+
+bool wlr_scene_node_coords(struct wlr_scene_node *node,
+		int *lx_ptr, int *ly_ptr) {
+	int lx = 0, ly = 0;
+	bool enabled = true;
+	while (node != NULL) {
+		lx += node->state.x;
+		ly += node->state.y;
+		enabled = enabled && node->state.enabled;
+		node = node->parent;
+	}
+
+	*lx_ptr = lx;
+	*ly_ptr = ly;
+	return enabled;
+}
+
+static void scene_node_for_each_surface(struct wlr_scene_node *node,
+		int lx, int ly, wlr_surface_iterator_func_t user_iterator,
+		void *user_data) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		user_iterator(scene_surface->surface, lx, ly, user_data);
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_node_for_each_surface(child, lx, ly, user_iterator, user_data);
+	}
+}
+
+void wlr_scene_node_for_each_surface(struct wlr_scene_node *node,
+		wlr_surface_iterator_func_t user_iterator, void *user_data) {
+	scene_node_for_each_surface(node, 0, 0, user_iterator, user_data);
+}
+
+struct wlr_scene_node *wlr_scene_node_at(struct wlr_scene_node *node,
+		double lx, double ly, double *nx, double *ny) {
+	if (!node->state.enabled) {
+		return NULL;
+	}
+
+	lx -= node->state.x;
+	ly -= node->state.y;
+
+	struct wlr_scene_node *child;
+	wl_list_for_each_reverse(child, &node->state.children, state.link) {
+		struct wlr_scene_node *found =
+			wlr_scene_node_at(child, lx, ly, nx, ny);
+		if (found != NULL) {
+			return found;
+		}
+	}
+
+	bool intersects = false;
+	switch (node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		intersects = wlr_surface_point_accepts_input(scene_surface->surface,
+			lx, ly);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(node);
+		intersects = lx >= 0 && lx < rect->width &&
+			ly >= 0 && ly < rect->height;
+		break;
+	}
+
+	if (!intersects) {
+		return NULL;
+	}
+
+	if (nx != NULL) {
+		*nx = lx;
+	}
+	if (ny != NULL) {
+		*ny = ly;
+	}
+	return node;
+}
+
+static void scene_output_handle_damage_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_output *scene_output =
+		wl_container_of(listener, scene_output, output_damage_destroy);
+	// The output damage is going away along with the output
+	wl_list_remove(&scene_output->output_damage_destroy.link);
+	wl_list_init(&scene_output->output_damage_destroy.link);
+	scene_output->damage = NULL;
+	wlr_scene_output_destroy(scene_output);
+}
+
+struct wlr_scene_output *wlr_scene_output_create(struct wlr_scene *scene,
+		struct wlr_output *output) {
+	struct wlr_scene_output *scene_output =
+		calloc(1, sizeof(struct wlr_scene_output));
+	if (scene_output == NULL) {
+		return NULL;
+	}
+
+	scene_output->damage = wlr_output_damage_create(output);
+	if (scene_output->damage == NULL) {
+		free(scene_output);
+		return NULL;
+	}
+
+	scene_output->output = output;
+	scene_output->scene = scene;
+	wl_list_insert(scene->outputs.prev, &scene_output->link);
+
+	scene_output->output_damage_destroy.notify =
+		scene_output_handle_damage_destroy;
+	wl_signal_add(&scene_output->damage->events.destroy,
+		&scene_output->output_damage_destroy);
+
+	wlr_output_damage_add_whole(scene_output->damage);
+
+	return scene_output;
+}
+
+void wlr_scene_output_destroy(struct wlr_scene_output *scene_output) {
+	if (scene_output == NULL) {
+		return;
+	}
+
+	wl_list_remove(&scene_output->link);
+	wl_list_remove(&scene_output->output_damage_destroy.link);
+	wlr_output_damage_destroy(scene_output->damage);
+	free(scene_output);
+}
+
+struct wlr_scene_output *wlr_scene_get_scene_output(struct wlr_scene *scene,
+		struct wlr_output *output) {
+	struct wlr_scene_output *scene_output;
+	wl_list_for_each(scene_output, &scene->outputs, link) {
+		if (scene_output->output == output) {
+			return scene_output;
+		}
+	}
+	return NULL;
+}
+
+void wlr_scene_output_set_position(struct wlr_scene_output *scene_output,
+		int lx, int ly) {
+	if (scene_output->x == lx && scene_output->y == ly) {
+		return;
+	}
+
+	scene_output->x = lx;
+	scene_output->y = ly;
+	wlr_output_damage_add_whole(scene_output->damage);
+}
+
+/**
+ * A node which needs to be painted on an output, gathered in rendering order
+ * by scene_output_collect_entries.
+ */
+struct render_entry {
+	struct wlr_scene_node *node;
+	int ox, oy; // output-local, unscaled
+	struct wlr_box box; // output-local, scaled
+	pixman_region32_t visible; // output-local, scaled
+};
+
+static void scene_output_collect_entries(struct wlr_scene_output *scene_output,
+		struct wlr_scene_node *node, int lx, int ly,
+		const struct wlr_box *output_box, struct wl_array *entries) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	bool has_content = true;
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		has_content = wlr_surface_get_texture(scene_surface->surface) != NULL;
+	}
+
+	int width, height;
+	scene_node_get_size(node, &width, &height);
+	if (has_content && width > 0 && height > 0) {
+		struct wlr_box box = {
+			.x = lx - scene_output->x,
+			.y = ly - scene_output->y,
+			.width = width,
+			.height = height,
+		};
+		scale_box(&box, scene_output->output->scale);
+
+		struct wlr_box intersection;
+		if (wlr_box_intersection(&intersection, &box, output_box)) {
+			struct render_entry *entry = wl_array_add(entries, sizeof(*entry));
+			if (entry == NULL) {
+				wlr_log(WLR_ERROR, "Allocation failed");
+				return;
+			}
+			entry->node = node;
+			entry->ox = lx - scene_output->x;
+			entry->oy = ly - scene_output->y;
+			entry->box = box;
+		}
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_output_collect_entries(scene_output, child, lx, ly,
+			output_box, entries);
+	}
+}
+
+/**
+ * Accumulates the region of the output covered by opaque content of the
+ * entry. Edges are rounded inwards, so that partially covered pixels are never
+ * considered occluded.
+ */
+static void render_entry_add_opaque_region(struct render_entry *entry,
+		float scale, pixman_region32_t *opaque) {
+	switch (entry->node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(entry->node);
+		// With a fractional scale, the surface origin is rounded: keep an
+		// additional pixel of margin
+		int margin = scale == floor(scale) ? 0 : 1;
+
+		int nrects;
+		pixman_box32_t *rects = pixman_region32_rectangles(
+			&scene_surface->surface->opaque_region, &nrects);
+		for (int i = 0; i < nrects; ++i) {
+			int x1 = ceil((entry->ox + rects[i].x1) * scale) + margin;
+			int y1 = ceil((entry->oy + rects[i].y1) * scale) + margin;
+			int x2 = floor((entry->ox + rects[i].x2) * scale) - margin;
+			int y2 = floor((entry->oy + rects[i].y2) * scale) - margin;
+			if (x2 <= x1 || y2 <= y1) {
+				continue;
+			}
+			pixman_region32_union_rect(opaque, opaque,
+				x1, y1, x2 - x1, y2 - y1);
+		}
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(entry->node);
+		if (rect->color[3] >= 1.0) {
+			pixman_region32_union_rect(opaque, opaque,
+				entry->box.x, entry->box.y,
+				entry->box.width, entry->box.height);
+		}
+		break;
+	}
+}
+
+static void output_box_to_buffer(struct wlr_output *output,
+		pixman_box32_t *rect, struct wlr_box *box) {
+	*box = (struct wlr_box){
+		.x = rect->x1,
+		.y = rect->y1,
+		.width = rect->x2 - rect->x1,
+		.height = rect->y2 - rect->y1,
+	};
+
+	int ow, oh;
+	wlr_output_transformed_resolution(output, &ow, &oh);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_box_transform(box, box, transform, ow, oh);
+}
+
+static void scissor_output(struct wlr_output *output, pixman_box32_t *rect) {
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer);
+
+	struct wlr_box box;
+	output_box_to_buffer(output, rect, &box);
+	wlr_renderer_scissor(renderer, &box);
+}
+
+static void render_entry_render(struct render_entry *entry,
+		struct wlr_output *output, struct wlr_renderer *renderer) {
+	int nrects;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&entry->visible, &nrects);
+	if (nrects == 0) {
+		return;
+	}
+
+	float matrix[9];
+	switch (entry->node->type) {
+	case WLR_SCENE_NODE_ROOT:
+	case WLR_SCENE_NODE_TREE:
+		break;
+	case WLR_SCENE_NODE_SURFACE:;
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(entry->node);
+		struct wlr_surface *surface = scene_surface->surface;
+
+		struct wlr_texture *texture = wlr_surface_get_texture(surface);
+		if (texture == NULL) {
+			return;
+		}
+		if (!wlr_linux_explicit_synchronization_v1_wait_surface(surface,
+				renderer)) {
+			return;
+		}
+
+		struct wlr_fbox src_box;
+		wlr_surface_get_buffer_source_box(surface, &src_box);
+
+		enum wl_output_transform transform =
+			wlr_output_transform_invert(surface->current.transform);
+		wlr_matrix_project_box(matrix, &entry->box, transform, 0.0,
+			output->transform_matrix);
+
+		// Draw all visible rectangles at once
+		pixman_region32_t clip;
+		pixman_region32_init(&clip);
+		for (int i = 0; i < nrects; ++i) {
+			struct wlr_box box;
+			output_box_to_buffer(output, &rects[i], &box);
+			pixman_region32_union_rect(&clip, &clip,
+				box.x, box.y, box.width, box.height);
+		}
+		wlr_render_subtexture_region_with_matrix(renderer, texture, &src_box,
+			matrix, 1.0, &clip);
+		pixman_region32_fini(&clip);
+		break;
+	case WLR_SCENE_NODE_RECT:;
+		struct wlr_scene_rect *rect = scene_rect_from_node(entry->node);
+
+		wlr_matrix_project_box(matrix, &entry->box,
+			WL_OUTPUT_TRANSFORM_NORMAL, 0.0, output->transform_matrix);
+
+		for (int i = 0; i < nrects; ++i) {
+			scissor_output(output, &rects[i]);
+			wlr_render_quad_with_matrix(renderer, rect->color, matrix);
+		}
+		break;
+	}
+}
+
+/**
+ * Hand a release fence for this frame to clients using explicit
+ * synchronization.
+ */
+static void scene_output_signal_release(struct render_entry *list,
+		size_t entries_len, struct wlr_renderer *renderer) {
+	int fence_fd = -1;
+	for (size_t i = 0; i < entries_len; i++) {
+		if (list[i].node->type != WLR_SCENE_NODE_SURFACE) {
+			continue;
+		}
+		struct wlr_surface *surface =
+			wlr_scene_surface_from_node(list[i].node)->surface;
+		struct wlr_linux_surface_synchronization_v1 *surface_sync =
+			wlr_linux_surface_synchronization_v1_from_surface(surface);
+		if (surface_sync == NULL ||
+				surface_sync->current.buffer_release == NULL) {
+			continue;
+		}
+
+		if (fence_fd < 0) {
+			fence_fd = wlr_renderer_create_fence_fd(renderer);
+			if (fence_fd < 0) {
+				return;
+			}
+		}
+		wlr_linux_explicit_synchronization_v1_signal_surface_release(surface,
+			fence_fd);
+	}
+	if (fence_fd >= 0) {
+		close(fence_fd);
+	}
+}
+
+/**
+ * Try to display the topmost node without compositing: this only works if it's
+ * a surface covering the whole output, with nothing visible underneath.
+ */
+static bool scene_output_scanout(struct wlr_scene_output *scene_output,
+		struct render_entry *list, size_t entries_len,
+		const struct wlr_box *output_box) {
+	if (entries_len == 0) {
+		return false;
+	}
+
+	struct render_entry *entry = &list[entries_len - 1];
+	if (entry->node->type != WLR_SCENE_NODE_SURFACE ||
+			entry->box.x != output_box->x || entry->box.y != output_box->y ||
+			entry->box.width != output_box->width ||
+			entry->box.height != output_box->height) {
+		return false;
+	}
+
+	struct wlr_surface *surface =
+		wlr_scene_surface_from_node(entry->node)->surface;
+	if (entries_len > 1) {
+		pixman_box32_t surface_box = {
+			.x2 = surface->current.width,
+			.y2 = surface->current.height,
+		};
+		if (pixman_region32_contains_rectangle(&surface->opaque_region,
+				&surface_box) != PIXMAN_REGION_IN) {
+			return false;
+		}
+	}
+
+	struct wlr_output *output = scene_output->output;
+	if (wlr_output_try_scanout_surface(output, surface) !=
+			WLR_OUTPUT_SCANOUT_OK) {
+		return false;
+	}
+
+	return wlr_output_commit(output);
+}
+
+bool wlr_scene_output_commit(struct wlr_scene_output *scene_output) {
+	struct wlr_output *output = scene_output->output;
+
+	struct wlr_renderer *renderer = wlr_backend_get_renderer(output->backend);
+	assert(renderer != NULL);
+
+	if (!output->needs_frame &&
+			!pixman_region32_not_empty(&scene_output->damage->current)) {
+		return true;
+	}
+
+	int tr_width, tr_height;
+	wlr_output_transformed_resolution(output, &tr_width, &tr_height);
+	struct wlr_box output_box = {
+		.width = tr_width,
+		.height = tr_height,
+	};
+
+	struct wl_array entries;
+	wl_array_init(&entries);
+	scene_output_collect_entries(scene_output, &scene_output->scene->node,
+		0, 0, &output_box, &entries);
+
+	struct render_entry *list = entries.data;
+	size_t entries_len = entries.size / sizeof(struct render_entry);
+
+	if (scene_output_scanout(scene_output, list, entries_len, &output_box)) {
+		wl_array_release(&entries);
+		return true;
+	}
+
+	bool needs_frame;
+	pixman_region32_t damage;
+	pixman_region32_init(&damage);
+	if (!wlr_output_damage_attach_render(scene_output->damage,
+			&needs_frame, &damage)) {
+		pixman_region32_fini(&damage);
+		wl_array_release(&entries);
+		return false;
+	}
+
+	if (!needs_frame) {
+		pixman_region32_fini(&damage);
+		wl_array_release(&entries);
+		wlr_output_rollback(output);
+		return true;
+	}
+
+	// Walk the nodes front-to-back to figure out which parts of the damage
+	// each node needs to paint: anything below opaque content is skipped
+	pixman_region32_t occluded;
+	pixman_region32_init(&occluded);
+	for (size_t i = entries_len; i-- > 0;) {
+		struct render_entry *entry = &list[i];
+		pixman_region32_init_rect(&entry->visible, entry->box.x, entry->box.y,
+			entry->box.width, entry->box.height);
+		pixman_region32_intersect(&entry->visible, &entry->visible, &damage);
+		pixman_region32_subtract(&entry->visible, &entry->visible, &occluded);
+		render_entry_add_opaque_region(entry, output->scale, &occluded);
+	}
+
+	pixman_region32_t background;
+	pixman_region32_init(&background);
+	pixman_region32_subtract(&background, &damage, &occluded);
+	pixman_region32_fini(&occluded);
+
+	wlr_renderer_begin(renderer, output->width, output->height);
+
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(&background, &nrects);
+	for (int i = 0; i < nrects; ++i) {
+		scissor_output(output, &rects[i]);
+		wlr_renderer_clear(renderer, (float[4]){ 0.0, 0.0, 0.0, 1.0 });
+	}
+	pixman_region32_fini(&background);
+
+	for (size_t i = 0; i < entries_len; i++) {
+		render_entry_render(&list[i], output, renderer);
+		pixman_region32_fini(&list[i].visible);
+	}
+
+	wlr_renderer_scissor(renderer, NULL);
+	wlr_output_render_software_cursors(output, &damage);
+
+	wlr_renderer_end(renderer);
+	pixman_region32_fini(&damage);
+
+	scene_output_signal_release(list, entries_len, renderer);
+	wl_array_release(&entries);
+
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+
+	pixman_region32_t frame_damage;
+	pixman_region32_init(&frame_damage);
+	wlr_region_transform(&frame_damage, &scene_output->damage->current,
+		transform, tr_width, tr_height);
+	wlr_output_set_damage(output, &frame_damage);
+	pixman_region32_fini(&frame_damage);
+
+	return wlr_output_commit(output);
+}
+
+static void scene_output_send_frame_done_iterator(struct wlr_scene_node *node,
+		struct timespec *now, const struct wlr_box *output_box,
+		int lx, int ly) {
+	if (!node->state.enabled) {
+		return;
+	}
+
+	lx += node->state.x;
+	ly += node->state.y;
+
+	if (node->type == WLR_SCENE_NODE_SURFACE) {
+		struct wlr_scene_surface *scene_surface =
+			wlr_scene_surface_from_node(node);
+		struct wlr_surface *surface = scene_surface->surface;
+
+		struct wlr_box box = {
+			.x = lx,
+			.y = ly,
+			.width = surface->current.width,
+			.height = surface->current.height,
+		};
+		struct wlr_box intersection;
+		if (wlr_box_intersection(&intersection, &box, output_box)) {
+			wlr_surface_send_frame_done(surface, now);
+		}
+	}
+
+	struct wlr_scene_node *child;
+	wl_list_for_each(child, &node->state.children, state.link) {
+		scene_output_send_frame_done_iterator(child, now, output_box,
+			lx, ly);
+	}
+}
+
+void wlr_scene_output_send_frame_done(struct wlr_scene_output *scene_output,
+		struct timespec *now) {
+	struct wlr_box output_box = {
+		.x = scene_output->x,
+		.y = scene_output->y,
+	};
+	wlr_output_effective_resolution(scene_output->output,
+		&output_box.width, &output_box.height);
+
+	scene_output_send_frame_done_iterator(&scene_output->scene->node,
+		now, &output_box, 0, 0);
+}
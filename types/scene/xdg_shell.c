@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <wlr/types/wlr_scene.h>
+#include <wlr/types/wlr_xdg_shell.h>
+
+struct wlr_scene_xdg_surface {
+	struct wlr_scene_tree *tree;
+	struct wlr_xdg_surface *xdg_surface;
+	struct wlr_scene_node *surface_node;
+
+	struct wl_listener tree_destroy;
+	struct wl_listener xdg_surface_destroy;
+	struct wl_listener xdg_surface_map;
+	struct wl_listener xdg_surface_unmap;
+	struct wl_listener xdg_surface_commit;
+	struct wl_listener xdg_surface_new_popup;
+};
+
+static void scene_xdg_surface_handle_tree_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, tree_destroy);
+	// tree and surface_node will be cleaned up by scene_node_destroy
+	wl_list_remove(&scene_xdg_surface->tree_destroy.link);
+	wl_list_remove(&scene_xdg_surface->xdg_surface_destroy.link);
+	wl_list_remove(&scene_xdg_surface->xdg_surface_map.link);
+	wl_list_remove(&scene_xdg_surface->xdg_surface_unmap.link);
+	wl_list_remove(&scene_xdg_surface->xdg_surface_commit.link);
+	wl_list_remove(&scene_xdg_surface->xdg_surface_new_popup.link);
+	free(scene_xdg_surface);
+}
+
+static void scene_xdg_surface_handle_xdg_surface_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, xdg_surface_destroy);
+	wlr_scene_node_destroy(&scene_xdg_surface->tree->node);
+}
+
+static void scene_xdg_surface_handle_xdg_surface_map(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, xdg_surface_map);
+	wlr_scene_node_set_enabled(&scene_xdg_surface->tree->node, true);
+}
+
+static void scene_xdg_surface_handle_xdg_surface_unmap(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, xdg_surface_unmap);
+	wlr_scene_node_set_enabled(&scene_xdg_surface->tree->node, false);
+}
+
+static void scene_xdg_surface_update_position(
+		struct wlr_scene_xdg_surface *scene_xdg_surface) {
+	struct wlr_xdg_surface *xdg_surface = scene_xdg_surface->xdg_surface;
+	if (xdg_surface->role != WLR_XDG_SURFACE_ROLE_POPUP) {
+		return;
+	}
+
+	// Popups are positioned relative to the parent surface origin, just like
+	// wlr_xdg_surface_for_each_surface does
+	struct wlr_xdg_popup *popup = xdg_surface->popup;
+	struct wlr_box parent_geo = {0};
+	if (popup->parent != NULL && wlr_surface_is_xdg_surface(popup->parent)) {
+		struct wlr_xdg_surface *parent =
+			wlr_xdg_surface_from_wlr_surface(popup->parent);
+		wlr_xdg_surface_get_geometry(parent, &parent_geo);
+	}
+	wlr_scene_node_set_position(&scene_xdg_surface->tree->node,
+		parent_geo.x + popup->geometry.x - xdg_surface->geometry.x,
+		parent_geo.y + popup->geometry.y - xdg_surface->geometry.y);
+}
+
+static void scene_xdg_surface_handle_xdg_surface_commit(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, xdg_surface_commit);
+	scene_xdg_surface_update_position(scene_xdg_surface);
+}
+
+static void scene_xdg_surface_handle_xdg_surface_new_popup(
+		struct wl_listener *listener, void *data) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		wl_container_of(listener, scene_xdg_surface, xdg_surface_new_popup);
+	struct wlr_xdg_popup *popup = data;
+	if (wlr_scene_xdg_surface_create(&scene_xdg_surface->tree->node,
+			popup->base) == NULL) {
+		wl_resource_post_no_memory(popup->resource);
+	}
+}
+
+struct wlr_scene_node *wlr_scene_xdg_surface_create(
+		struct wlr_scene_node *parent, struct wlr_xdg_surface *xdg_surface) {
+	struct wlr_scene_xdg_surface *scene_xdg_surface =
+		calloc(1, sizeof(struct wlr_scene_xdg_surface));
+	if (scene_xdg_surface == NULL) {
+		return NULL;
+	}
+
+	scene_xdg_surface->xdg_surface = xdg_surface;
+
+	scene_xdg_surface->tree = wlr_scene_tree_create(parent);
+	if (scene_xdg_surface->tree == NULL) {
+		free(scene_xdg_surface);
+		return NULL;
+	}
+
+	scene_xdg_surface->surface_node = wlr_scene_subsurface_tree_create(
+		&scene_xdg_surface->tree->node, xdg_surface->surface);
+	if (scene_xdg_surface->surface_node == NULL) {
+		wlr_scene_node_destroy(&scene_xdg_surface->tree->node);
+		free(scene_xdg_surface);
+		return NULL;
+	}
+
+	scene_xdg_surface->tree_destroy.notify =
+		scene_xdg_surface_handle_tree_destroy;
+	wl_signal_add(&scene_xdg_surface->tree->node.events.destroy,
+		&scene_xdg_surface->tree_destroy);
+
+	scene_xdg_surface->xdg_surface_destroy.notify =
+		scene_xdg_surface_handle_xdg_surface_destroy;
+	wl_signal_add(&xdg_surface->events.destroy,
+		&scene_xdg_surface->xdg_surface_destroy);
+
+	scene_xdg_surface->xdg_surface_map.notify =
+		scene_xdg_surface_handle_xdg_surface_map;
+	wl_signal_add(&xdg_surface->events.map,
+		&scene_xdg_surface->xdg_surface_map);
+
+	scene_xdg_surface->xdg_surface_unmap.notify =
+		scene_xdg_surface_handle_xdg_surface_unmap;
+	wl_signal_add(&xdg_surface->events.unmap,
+		&scene_xdg_surface->xdg_surface_unmap);
+
+	scene_xdg_surface->xdg_surface_commit.notify =
+		scene_xdg_surface_handle_xdg_surface_commit;
+	wl_signal_add(&xdg_surface->surface->events.commit,
+		&scene_xdg_surface->xdg_surface_commit);
+
+	scene_xdg_surface->xdg_surface_new_popup.notify =
+		scene_xdg_surface_handle_xdg_surface_new_popup;
+	wl_signal_add(&xdg_surface->events.new_popup,
+		&scene_xdg_surface->xdg_surface_new_popup);
+
+	wlr_scene_node_set_enabled(&scene_xdg_surface->tree->node,
+		xdg_surface->mapped);
+	scene_xdg_surface_update_position(scene_xdg_surface);
+
+	// Pick up popups created before the scene node
+	struct wlr_xdg_popup *popup;
+	wl_list_for_each(popup, &xdg_surface->popups, link) {
+		wlr_scene_xdg_surface_create(&scene_xdg_surface->tree->node,
+			popup->base);
+	}
+
+	return &scene_xdg_surface->tree->node;
+}
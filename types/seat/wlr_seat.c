@@ -161,6 +161,7 @@ void wlr_seat_destroy(struct wlr_seat *seat) {
 
 	wlr_seat_pointer_clear_focus(seat);
 	wlr_seat_keyboard_clear_focus(seat);
+	seat_pointer_flush(seat);
 
 	struct wlr_touch_point *point;
 	wl_list_for_each(point, &seat->touch_state.touch_points, link) {
@@ -226,6 +227,9 @@ struct wlr_seat *wlr_seat_create(struct wl_display *display, const char *name) {
 	seat->pointer_state.default_grab = pointer_grab;
 	seat->pointer_state.grab = pointer_grab;
 
+	seat->pointer_state.coalesce_motion = true;
+	wl_signal_init(&seat->pointer_state.batch.flush);
+
 	wl_signal_init(&seat->pointer_state.events.focus_change);
 
 	// keyboard state
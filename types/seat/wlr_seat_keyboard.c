@@ -2,9 +2,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <time.h>
-#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/types/wlr_data_device.h>
 #include <wlr/types/wlr_gtk_primary_selection.h>
@@ -12,7 +10,6 @@
 #include <wlr/util/log.h>
 #include "types/wlr_data_device.h"
 #include "types/wlr_seat.h"
-#include "util/shm.h"
 #include "util/signal.h"
 
 static void default_keyboard_enter(struct wlr_seat_keyboard_grab *grab,
@@ -77,6 +74,9 @@ void wlr_seat_keyboard_send_key(struct wlr_seat *wlr_seat, uint32_t time,
 		return;
 	}
 
+	// Keep the order of pointer and keyboard events
+	seat_pointer_flush(wlr_seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(client);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->keyboards) {
@@ -132,6 +132,13 @@ void wlr_seat_set_keyboard(struct wlr_seat *seat,
 		return;
 	}
 
+	// Keyboards of a group or virtual keyboards often share the keymap,
+	// clients don't need to load it again
+	struct wlr_keyboard *prev = seat->keyboard_state.keyboard;
+	bool same_keymap = prev != NULL && keyboard != NULL &&
+		prev->keymap_string != NULL && keyboard->keymap_string != NULL &&
+		strcmp(prev->keymap_string, keyboard->keymap_string) == 0;
+
 	if (seat->keyboard_state.keyboard) {
 		wl_list_remove(&seat->keyboard_state.keyboard_destroy.link);
 		wl_list_remove(&seat->keyboard_state.keyboard_keymap.link);
@@ -156,7 +163,9 @@ void wlr_seat_set_keyboard(struct wlr_seat *seat,
 
 		struct wlr_seat_client *client;
 		wl_list_for_each(client, &seat->clients, link) {
-			seat_client_send_keymap(client, keyboard);
+			if (!same_keymap) {
+				seat_client_send_keymap(client, keyboard);
+			}
 			seat_client_send_repeat_info(client, keyboard);
 		}
 
@@ -206,6 +215,8 @@ void wlr_seat_keyboard_send_modifiers(struct wlr_seat *seat,
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(client);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->keyboards) {
@@ -243,6 +254,8 @@ void wlr_seat_keyboard_enter(struct wlr_seat *seat,
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wlr_seat_client *client = NULL;
 
 	if (surface) {
@@ -353,7 +366,7 @@ void wlr_seat_keyboard_notify_key(struct wlr_seat *seat, uint32_t time,
 
 static void seat_client_send_keymap(struct wlr_seat_client *client,
 		struct wlr_keyboard *keyboard) {
-	if (!keyboard) {
+	if (!keyboard || keyboard->keymap_fd < 0) {
 		return;
 	}
 
@@ -365,28 +378,10 @@ static void seat_client_send_keymap(struct wlr_seat_client *client,
 			continue;
 		}
 
-		int keymap_fd = allocate_shm_file(keyboard->keymap_size);
-		if (keymap_fd < 0) {
-			wlr_log(WLR_ERROR, "creating a keymap file for %zu bytes failed", keyboard->keymap_size);
-			continue;
-		}
-
-		void *ptr = mmap(NULL, keyboard->keymap_size, PROT_READ | PROT_WRITE,
-				MAP_SHARED, keymap_fd, 0);
-		if (ptr == MAP_FAILED) {
-			wlr_log(WLR_ERROR, "failed to mmap() %zu bytes", keyboard->keymap_size);
-			close(keymap_fd);
-			continue;
-		}
-
-		strcpy(ptr, keyboard->keymap_string);
-		munmap(ptr, keyboard->keymap_size);
-
+		// The file is read-only, all clients can share it
 		wl_keyboard_send_keymap(resource,
-			WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keymap_fd,
+			WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keyboard->keymap_fd,
 			keyboard->keymap_size);
-
-		close(keymap_fd);
 	}
 }
 
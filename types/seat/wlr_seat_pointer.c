@@ -162,6 +162,9 @@ void wlr_seat_pointer_enter(struct wlr_seat *wlr_seat,
 		client = wlr_seat_client_for_wl_client(wlr_seat, wl_client);
 	}
 
+	// the coalesced frame belongs to the previously entered surface
+	seat_pointer_flush(wlr_seat);
+
 	struct wlr_seat_client *focused_client =
 		wlr_seat->pointer_state.focused_client;
 	struct wlr_surface *focused_surface =
@@ -230,25 +233,123 @@ void wlr_seat_pointer_warp(struct wlr_seat *wlr_seat, double sx, double sy) {
 	wlr_seat->pointer_state.sy = sy;
 }
 
+static void seat_client_send_pointer_motion_raw(
+		struct wlr_seat_client *client, uint32_t time, double sx, double sy) {
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		wl_pointer_send_motion(resource, time, wl_fixed_from_double(sx),
+			wl_fixed_from_double(sy));
+	}
+}
+
+static void seat_client_send_pointer_frame_raw(
+		struct wlr_seat_client *client) {
+	struct wl_resource *resource;
+	wl_resource_for_each(resource, &client->pointers) {
+		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
+			continue;
+		}
+
+		pointer_send_frame(resource);
+	}
+}
+
+void seat_pointer_flush(struct wlr_seat *seat) {
+	struct wlr_seat_pointer_state *state = &seat->pointer_state;
+	if (state->batch.idle != NULL) {
+		wl_event_source_remove(state->batch.idle);
+		state->batch.idle = NULL;
+	}
+
+	if (!state->batch.motion && !state->batch.relative_motion &&
+			!state->batch.frame) {
+		return;
+	}
+
+	// Relative motion is part of the wl_pointer frame
+	if (state->batch.relative_motion) {
+		wlr_signal_emit_safe(&state->batch.flush, seat);
+	}
+
+	struct wlr_seat_client *client = state->focused_client;
+	if (client != NULL) {
+		if (state->batch.motion) {
+			seat_client_send_pointer_motion_raw(client,
+				state->batch.time_msec, state->batch.sx, state->batch.sy);
+			state->coalesce_stats.motion_sent++;
+		}
+		if (state->batch.frame) {
+			seat_client_send_pointer_frame_raw(client);
+		}
+	}
+
+	state->batch.motion = false;
+	state->batch.relative_motion = false;
+	state->batch.frame = false;
+}
+
+static void seat_pointer_handle_idle(void *data) {
+	struct wlr_seat *seat = data;
+	// Idle sources are removed by the event loop once dispatched
+	seat->pointer_state.batch.idle = NULL;
+	seat_pointer_flush(seat);
+}
+
+static void seat_pointer_schedule_flush(struct wlr_seat *seat) {
+	struct wlr_seat_pointer_state *state = &seat->pointer_state;
+	if (state->batch.idle != NULL) {
+		return;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(seat->display);
+	state->batch.idle =
+		wl_event_loop_add_idle(loop, seat_pointer_handle_idle, seat);
+	if (state->batch.idle == NULL) {
+		wlr_log(WLR_ERROR, "Failed to schedule pointer frame");
+		seat_pointer_flush(seat);
+	}
+}
+
+bool seat_pointer_coalesce_relative_motion(struct wlr_seat *seat) {
+	struct wlr_seat_pointer_state *state = &seat->pointer_state;
+	if (!state->coalesce_motion || state->focused_client == NULL) {
+		return false;
+	}
+
+	state->batch.relative_motion = true;
+	seat_pointer_schedule_flush(seat);
+	return true;
+}
+
 void wlr_seat_pointer_send_motion(struct wlr_seat *wlr_seat, uint32_t time,
 		double sx, double sy) {
-	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	struct wlr_seat_client *client = state->focused_client;
 	if (client == NULL) {
 		return;
 	}
 
-	if (wlr_seat->pointer_state.sx == sx && wlr_seat->pointer_state.sy == sy) {
+	if (state->sx == sx && state->sy == sy) {
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &client->pointers) {
-		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-			continue;
+	if (state->coalesce_motion) {
+		if (state->batch.motion) {
+			state->coalesce_stats.motion_coalesced++;
 		}
-
-		wl_pointer_send_motion(resource, time, wl_fixed_from_double(sx),
-			wl_fixed_from_double(sy));
+		state->batch.motion = true;
+		state->batch.time_msec = time;
+		state->batch.sx = sx;
+		state->batch.sy = sy;
+		seat_pointer_schedule_flush(wlr_seat);
+	} else {
+		seat_pointer_flush(wlr_seat);
+		seat_client_send_pointer_motion_raw(client, time, sx, sy);
+		state->coalesce_stats.motion_sent++;
 	}
 
 	wlr_seat_pointer_warp(wlr_seat, sx, sy);
@@ -261,6 +362,8 @@ uint32_t wlr_seat_pointer_send_button(struct wlr_seat *wlr_seat, uint32_t time,
 		return 0;
 	}
 
+	seat_pointer_flush(wlr_seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(client);
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
@@ -281,6 +384,8 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 		return;
 	}
 
+	seat_pointer_flush(wlr_seat);
+
 	struct wl_resource *resource;
 	wl_resource_for_each(resource, &client->pointers) {
 		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
@@ -308,19 +413,22 @@ void wlr_seat_pointer_send_axis(struct wlr_seat *wlr_seat, uint32_t time,
 }
 
 void wlr_seat_pointer_send_frame(struct wlr_seat *wlr_seat) {
-	struct wlr_seat_client *client = wlr_seat->pointer_state.focused_client;
+	struct wlr_seat_pointer_state *state = &wlr_seat->pointer_state;
+	struct wlr_seat_client *client = state->focused_client;
 	if (client == NULL) {
 		return;
 	}
 
-	struct wl_resource *resource;
-	wl_resource_for_each(resource, &client->pointers) {
-		if (wlr_seat_client_from_pointer_resource(resource) == NULL) {
-			continue;
+	// A frame which only contains motion is merged with the next ones
+	if (state->batch.motion || state->batch.relative_motion) {
+		if (state->batch.frame) {
+			state->coalesce_stats.frames_coalesced++;
 		}
-
-		pointer_send_frame(resource);
+		state->batch.frame = true;
+		return;
 	}
+
+	seat_client_send_pointer_frame_raw(client);
 }
 
 void wlr_seat_pointer_start_grab(struct wlr_seat *wlr_seat,
@@ -13,6 +13,7 @@
 #include <wlr/types/wlr_tablet_v2.h>
 #include <wlr/util/log.h>
 #include "tablet-unstable-v2-protocol.h"
+#include "types/wlr_seat.h"
 #include "util/signal.h"
 
 #define TABLET_MANAGER_VERSION 1
@@ -97,6 +98,12 @@ struct wlr_tablet_seat_client_v2 *tablet_seat_client_from_resource(
 	return wl_resource_get_user_data(resource);
 }
 
+void tablet_seat_client_v2_flush_pointer(
+		struct wlr_tablet_seat_client_v2 *seat) {
+	// Keep the order of pointer and tablet events
+	seat_pointer_flush(seat->seat_client->seat);
+}
+
 void tablet_seat_client_v2_destroy(struct wl_resource *resource) {
 	struct wlr_tablet_seat_client_v2 *seat = tablet_seat_client_from_resource(resource);
 	if (!seat) {
@@ -455,6 +455,8 @@ uint32_t wlr_send_tablet_v2_tablet_pad_enter(
 
 	pad->current_client = pad_client;
 
+	tablet_seat_client_v2_flush_pointer(pad_client->seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(
 		pad_client->seat->seat_client);
 
@@ -480,6 +482,7 @@ void wlr_send_tablet_v2_tablet_pad_button(
 		uint32_t time, enum zwp_tablet_pad_v2_button_state state) {
 
 	if (pad->current_client) {
+		tablet_seat_client_v2_flush_pointer(pad->current_client->seat);
 		zwp_tablet_pad_v2_send_button(pad->current_client->resource,
 				time, button, state);
 	}
@@ -494,6 +497,8 @@ void wlr_send_tablet_v2_tablet_pad_strip(struct wlr_tablet_v2_tablet_pad *pad,
 	}
 	struct wl_resource *resource = pad->current_client->strips[strip];
 
+	tablet_seat_client_v2_flush_pointer(pad->current_client->seat);
+
 	if (finger) {
 		zwp_tablet_pad_strip_v2_send_source(resource, ZWP_TABLET_PAD_STRIP_V2_SOURCE_FINGER);
 	}
@@ -515,6 +520,8 @@ void wlr_send_tablet_v2_tablet_pad_ring(struct wlr_tablet_v2_tablet_pad *pad,
 	}
 	struct wl_resource *resource = pad->current_client->rings[ring];
 
+	tablet_seat_client_v2_flush_pointer(pad->current_client->seat);
+
 	if (finger) {
 		zwp_tablet_pad_ring_v2_send_source(resource, ZWP_TABLET_PAD_RING_V2_SOURCE_FINGER);
 	}
@@ -534,6 +541,7 @@ uint32_t wlr_send_tablet_v2_tablet_pad_leave(struct wlr_tablet_v2_tablet_pad *pa
 		return 0;
 	}
 
+	tablet_seat_client_v2_flush_pointer(pad->current_client->seat);
 
 	uint32_t serial = wlr_seat_client_next_serial(
 		pad->current_client->seat->seat_client);
@@ -556,6 +564,8 @@ uint32_t wlr_send_tablet_v2_tablet_pad_mode(struct wlr_tablet_v2_tablet_pad *pad
 
 	pad->groups[group] = mode;
 
+	tablet_seat_client_v2_flush_pointer(pad->current_client->seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(
 		pad->current_client->seat->seat_client);
 
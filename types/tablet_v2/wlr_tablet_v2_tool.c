@@ -376,6 +376,8 @@ void wlr_send_tablet_v2_tablet_tool_proximity_in(
 
 	tool->current_client = tool_client;
 
+	tablet_seat_client_v2_flush_pointer(tool_client->seat);
+
 	uint32_t serial = wlr_seat_client_next_serial(tool_client->seat->seat_client);
 	tool->focused_surface = surface;
 	tool->proximity_serial = serial;
@@ -401,6 +403,7 @@ void wlr_send_tablet_v2_tablet_tool_motion(
 		return;
 	}
 
+	tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 	zwp_tablet_tool_v2_send_motion(tool->current_client->resource,
 		wl_fixed_from_double(x), wl_fixed_from_double(y));
 
@@ -410,6 +413,7 @@ void wlr_send_tablet_v2_tablet_tool_motion(
 void wlr_send_tablet_v2_tablet_tool_proximity_out(
 		struct wlr_tablet_v2_tablet_tool *tool) {
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 		for (size_t i = 0; i < tool->num_buttons; ++i) {
 			zwp_tablet_tool_v2_send_button(tool->current_client->resource,
 				tool->pressed_serials[i],
@@ -436,6 +440,7 @@ void wlr_send_tablet_v2_tablet_tool_proximity_out(
 void wlr_send_tablet_v2_tablet_tool_pressure(
 		struct wlr_tablet_v2_tablet_tool *tool, double pressure) {
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 		zwp_tablet_tool_v2_send_pressure(tool->current_client->resource,
 			pressure * 65535);
 
@@ -446,6 +451,7 @@ void wlr_send_tablet_v2_tablet_tool_pressure(
 void wlr_send_tablet_v2_tablet_tool_distance(
 		struct wlr_tablet_v2_tablet_tool *tool, double distance) {
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 		zwp_tablet_tool_v2_send_distance(tool->current_client->resource,
 			distance * 65535);
 
@@ -459,6 +465,7 @@ void wlr_send_tablet_v2_tablet_tool_tilt(
 		return;
 	}
 
+	tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 	zwp_tablet_tool_v2_send_tilt(tool->current_client->resource,
 		wl_fixed_from_double(x), wl_fixed_from_double(y));
 
@@ -471,6 +478,7 @@ void wlr_send_tablet_v2_tablet_tool_rotation(
 		return;
 	}
 
+	tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 	zwp_tablet_tool_v2_send_rotation(tool->current_client->resource,
 		wl_fixed_from_double(degrees));
 
@@ -483,6 +491,7 @@ void wlr_send_tablet_v2_tablet_tool_slider(
 		return;
 	}
 
+	tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 	zwp_tablet_tool_v2_send_slider(tool->current_client->resource,
 		position * 65535);
 
@@ -495,6 +504,8 @@ void wlr_send_tablet_v2_tablet_tool_button(
 	ssize_t index = tablet_tool_button_update(tool, button, state);
 
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
+
 		uint32_t serial = wlr_seat_client_next_serial(
 			tool->current_client->seat->seat_client);
 		if (index >= 0) {
@@ -510,6 +521,7 @@ void wlr_send_tablet_v2_tablet_tool_button(
 void wlr_send_tablet_v2_tablet_tool_wheel(
 	struct wlr_tablet_v2_tablet_tool *tool, double degrees, int32_t clicks) {
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 		zwp_tablet_tool_v2_send_wheel(tool->current_client->resource,
 			clicks, degrees);
 
@@ -524,6 +536,8 @@ void wlr_send_tablet_v2_tablet_tool_down(struct wlr_tablet_v2_tablet_tool *tool)
 
 	tool->is_down = true;
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
+
 		uint32_t serial = wlr_seat_client_next_serial(
 			tool->current_client->seat->seat_client);
 
@@ -543,6 +557,7 @@ void wlr_send_tablet_v2_tablet_tool_up(struct wlr_tablet_v2_tablet_tool *tool) {
 	tool->down_serial = 0;
 
 	if (tool->current_client) {
+		tablet_seat_client_v2_flush_pointer(tool->current_client->seat);
 		zwp_tablet_tool_v2_send_up(tool->current_client->resource);
 		queue_tool_frame(tool->current_client);
 	}
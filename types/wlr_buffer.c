@@ -65,6 +65,14 @@ bool wlr_buffer_get_dmabuf(struct wlr_buffer *buffer,
 	return buffer->impl->get_dmabuf(buffer, attribs);
 }
 
+bool wlr_buffer_get_data_ptr(struct wlr_buffer *buffer, void **data,
+		uint32_t *format, size_t *stride) {
+	if (!buffer->impl->get_data_ptr) {
+		return false;
+	}
+	return buffer->impl->get_data_ptr(buffer, data, format, stride);
+}
+
 
 bool wlr_resource_is_buffer(struct wl_resource *resource) {
 	return strcmp(wl_resource_get_class(resource), wl_buffer_interface.name) == 0;
@@ -180,6 +188,7 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 
 	struct wlr_texture *texture = NULL;
 	bool resource_released = false;
+	size_t upload_bytes = 0;
 
 	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
 	if (shm_buf != NULL) {
@@ -194,6 +203,7 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 		texture = wlr_texture_from_pixels(renderer, drm_format, stride,
 			width, height, data);
 		wl_shm_buffer_end_access(shm_buf);
+		upload_bytes = (size_t)stride * height;
 
 		// We have uploaded the data, we don't need to access the wl_buffer
 		// anymore
@@ -236,6 +246,7 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 	buffer->resource = resource;
 	buffer->texture = texture;
 	buffer->resource_released = resource_released;
+	buffer->upload_bytes = upload_bytes;
 
 	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
 	buffer->resource_destroy.notify = client_buffer_resource_handle_destroy;
@@ -287,20 +298,17 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 	wl_shm_buffer_begin_access(shm_buf);
 	void *data = wl_shm_buffer_get_data(shm_buf);
 
-	int n;
-	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
-	for (int i = 0; i < n; ++i) {
-		pixman_box32_t *r = &rects[i];
-		if (!wlr_texture_write_pixels(buffer->texture, stride,
-				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
-				r->x1, r->y1, data)) {
-			wl_shm_buffer_end_access(shm_buf);
-			return NULL;
-		}
-	}
+	size_t upload_bytes = 0;
+	bool ok = wlr_texture_write_pixels_region(buffer->texture, stride, damage,
+		data, &upload_bytes);
 
 	wl_shm_buffer_end_access(shm_buf);
 
+	if (!ok) {
+		return NULL;
+	}
+	buffer->upload_bytes = upload_bytes;
+
 	// We have uploaded the data, we don't need to access the wl_buffer
 	// anymore
 	wl_buffer_send_release(resource);
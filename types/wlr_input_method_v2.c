@@ -3,15 +3,12 @@
 #endif
 #include <assert.h>
 #include <string.h>
-#include <sys/mman.h>
-#include <unistd.h>
 #include <wayland-util.h>
 #include <wlr/types/wlr_input_method_v2.h>
 #include <wlr/types/wlr_surface.h>
 #include <wlr/util/log.h>
 #include <xkbcommon/xkbcommon.h>
 #include "input-method-unstable-v2-protocol.h"
-#include "util/shm.h"
 #include "util/signal.h"
 
 static const struct zwp_input_method_v2_interface input_method_impl;
@@ -167,30 +164,14 @@ void wlr_input_method_keyboard_grab_v2_send_modifiers(
 static bool keyboard_grab_send_keymap(
 		struct wlr_input_method_keyboard_grab_v2 *keyboard_grab,
 		struct wlr_keyboard *keyboard) {
-	int keymap_fd = allocate_shm_file(keyboard->keymap_size);
-	if (keymap_fd < 0) {
-		wlr_log(WLR_ERROR, "creating a keymap file for %zu bytes failed",
-			keyboard->keymap_size);
+	if (keyboard->keymap_fd < 0) {
+		wlr_log(WLR_ERROR, "keyboard has no keymap file");
 		return false;
 	}
 
-	void *ptr = mmap(NULL, keyboard->keymap_size, PROT_READ | PROT_WRITE,
-		MAP_SHARED, keymap_fd, 0);
-	if (ptr == MAP_FAILED) {
-		wlr_log(WLR_ERROR, "failed to mmap() %zu bytes",
-			keyboard->keymap_size);
-		close(keymap_fd);
-		return false;
-	}
-
-	memcpy(ptr, keyboard->keymap_string, keyboard->keymap_size);
-	munmap(ptr, keyboard->keymap_size);
-
 	zwp_input_method_keyboard_grab_v2_send_keymap(keyboard_grab->resource,
-		WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keymap_fd,
+		WL_KEYBOARD_KEYMAP_FORMAT_XKB_V1, keyboard->keymap_fd,
 		keyboard->keymap_size);
-
-	close(keymap_fd);
 	return true;
 }
 
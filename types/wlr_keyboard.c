@@ -2,11 +2,13 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/interfaces/wlr_keyboard.h>
 #include <wlr/types/wlr_keyboard.h>
 #include <wlr/util/log.h>
 #include "types/wlr_keyboard.h"
+#include "util/shm.h"
 #include "util/signal.h"
 
 void keyboard_led_update(struct wlr_keyboard *keyboard) {
@@ -122,6 +124,8 @@ void wlr_keyboard_init(struct wlr_keyboard *kb,
 	// Sane defaults
 	kb->repeat_info.rate = 25;
 	kb->repeat_info.delay = 600;
+
+	kb->keymap_fd = -1;
 }
 
 void wlr_keyboard_destroy(struct wlr_keyboard *kb) {
@@ -132,6 +136,9 @@ void wlr_keyboard_destroy(struct wlr_keyboard *kb) {
 	xkb_state_unref(kb->xkb_state);
 	xkb_keymap_unref(kb->keymap);
 	free(kb->keymap_string);
+	if (kb->keymap_fd >= 0) {
+		close(kb->keymap_fd);
+	}
 	if (kb->impl && kb->impl->destroy) {
 		kb->impl->destroy(kb);
 	} else {
@@ -188,9 +195,27 @@ bool wlr_keyboard_set_keymap(struct wlr_keyboard *kb,
 		wlr_log(WLR_ERROR, "Failed to get string version of keymap");
 		goto err;
 	}
+	size_t keymap_size = strlen(tmp_keymap_string) + 1;
+
+	// The file is shared by all clients, keep it if the keymap is identical
+	if (kb->keymap_fd < 0 || kb->keymap_string == NULL ||
+			strcmp(kb->keymap_string, tmp_keymap_string) != 0) {
+		int keymap_fd =
+			create_readonly_shm_file(tmp_keymap_string, keymap_size);
+		if (keymap_fd < 0) {
+			wlr_log(WLR_ERROR, "creating a keymap file for %zu bytes failed",
+				keymap_size);
+			free(tmp_keymap_string);
+			goto err;
+		}
+		if (kb->keymap_fd >= 0) {
+			close(kb->keymap_fd);
+		}
+		kb->keymap_fd = keymap_fd;
+	}
 	free(kb->keymap_string);
 	kb->keymap_string = tmp_keymap_string;
-	kb->keymap_size = strlen(kb->keymap_string) + 1;
+	kb->keymap_size = keymap_size;
 
 	for (size_t i = 0; i < kb->num_keycodes; ++i) {
 		xkb_keycode_t keycode = kb->keycodes[i] + 8;
@@ -209,6 +234,10 @@ err:
 	kb->keymap = NULL;
 	free(kb->keymap_string);
 	kb->keymap_string = NULL;
+	if (kb->keymap_fd >= 0) {
+		close(kb->keymap_fd);
+		kb->keymap_fd = -1;
+	}
 	return false;
 }
 
@@ -64,6 +64,8 @@ static void layer_surface_handle_ack_configure(struct wl_client *client,
 		return;
 	}
 
+	wlr_surface_apply_held_commit(surface->surface);
+
 	// First find the ack'ed configure
 	bool found = false;
 	struct wlr_layer_surface_v1_configure *configure, *tmp;
@@ -102,6 +104,8 @@ static void layer_surface_handle_set_size(struct wl_client *client,
 	if (!surface) {
 		return;
 	}
+
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->client_pending.desired_width = width;
 	surface->client_pending.desired_height = height;
 }
@@ -123,6 +127,8 @@ static void layer_surface_handle_set_anchor(struct wl_client *client,
 	if (!surface) {
 		return;
 	}
+
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->client_pending.anchor = anchor;
 }
 
@@ -133,6 +139,8 @@ static void layer_surface_handle_set_exclusive_zone(struct wl_client *client,
 	if (!surface) {
 		return;
 	}
+
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->client_pending.exclusive_zone = zone;
 }
 
@@ -144,6 +152,8 @@ static void layer_surface_handle_set_margin(
 	if (!surface) {
 		return;
 	}
+
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->client_pending.margin.top = top;
 	surface->client_pending.margin.right = right;
 	surface->client_pending.margin.bottom = bottom;
@@ -159,6 +169,7 @@ static void layer_surface_handle_set_keyboard_interactivity(
 		return;
 	}
 
+	wlr_surface_apply_held_commit(surface->surface);
 	if (wl_resource_get_version(resource) < ZWLR_LAYER_SURFACE_V1_KEYBOARD_INTERACTIVITY_ON_DEMAND_SINCE_VERSION) {
 		surface->client_pending.keyboard_interactive = !!interactive;
 	} else {
@@ -203,6 +214,7 @@ static void layer_surface_set_layer(struct wl_client *client,
 				"Invalid layer %" PRIu32, layer);
 		return;
 	}
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->client_pending.layer = layer;
 }
 
@@ -238,6 +250,8 @@ static void layer_surface_unmap(struct wlr_layer_surface_v1 *surface) {
 }
 
 static void layer_surface_destroy(struct wlr_layer_surface_v1 *surface) {
+	// The held commit belongs to the layer surface being destroyed
+	wlr_surface_apply_held_commit(surface->surface);
 	if (surface->configured && surface->mapped) {
 		layer_surface_unmap(surface);
 	}
@@ -394,6 +408,7 @@ static void layer_surface_role_commit(struct wlr_surface *wlr_surface) {
 static const struct wlr_surface_role layer_surface_role = {
 	.name = "zwlr_layer_surface_v1",
 	.commit = layer_surface_role_commit,
+	.hold_commits = true,
 };
 
 static void handle_surface_destroyed(struct wl_listener *listener,
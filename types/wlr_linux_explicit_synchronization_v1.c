@@ -0,0 +1,470 @@
+#define _POSIX_C_SOURCE 200809L
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_linux_explicit_synchronization_v1.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/log.h>
+#include "linux-explicit-synchronization-unstable-v1-protocol.h"
+#include "util/signal.h"
+
+#define LINUX_EXPLICIT_SYNCHRONIZATION_V1_VERSION 1
+
+static const struct zwp_linux_explicit_synchronization_v1_interface
+	explicit_sync_impl;
+static const struct zwp_linux_surface_synchronization_v1_interface
+	surface_sync_impl;
+
+static void buffer_release_handle_resource_destroy(
+		struct wl_resource *resource) {
+	struct wlr_linux_buffer_release_v1 *release =
+		wl_resource_get_user_data(resource);
+	if (release->state != NULL) {
+		release->state->buffer_release = NULL;
+	}
+	if (release->buffer != NULL) {
+		wl_list_remove(&release->buffer_release.link);
+		wl_list_remove(&release->buffer_destroy.link);
+	}
+	if (release->fence_fd >= 0) {
+		close(release->fence_fd);
+	}
+	free(release);
+}
+
+static void buffer_release_send(struct wlr_linux_buffer_release_v1 *release) {
+	if (release->fence_fd >= 0) {
+		zwp_linux_buffer_release_v1_send_fenced_release(release->resource,
+			release->fence_fd);
+	} else {
+		zwp_linux_buffer_release_v1_send_immediate_release(release->resource);
+	}
+	wl_resource_destroy(release->resource);
+}
+
+static void buffer_release_handle_buffer_release(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_buffer_release_v1 *release =
+		wl_container_of(listener, release, buffer_release);
+	buffer_release_send(release);
+}
+
+static void buffer_release_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_buffer_release_v1 *release =
+		wl_container_of(listener, release, buffer_destroy);
+	buffer_release_send(release);
+}
+
+/**
+ * Send the release event once the buffer isn't used by any consumer anymore.
+ * The buffer may be NULL, in which case the event is sent immediately.
+ */
+static void buffer_release_wait(struct wlr_linux_buffer_release_v1 *release,
+		struct wlr_buffer *buffer) {
+	if (release->state != NULL) {
+		release->state->buffer_release = NULL;
+		release->state = NULL;
+	}
+
+	if (buffer == NULL || buffer->n_locks == 0) {
+		buffer_release_send(release);
+		return;
+	}
+
+	release->buffer = buffer;
+	release->buffer_release.notify = buffer_release_handle_buffer_release;
+	wl_signal_add(&buffer->events.release, &release->buffer_release);
+	release->buffer_destroy.notify = buffer_release_handle_buffer_destroy;
+	wl_signal_add(&buffer->events.destroy, &release->buffer_destroy);
+}
+
+static void state_init(struct wlr_linux_surface_synchronization_v1_state *state) {
+	state->acquire_fence_fd = -1;
+	state->buffer_release = NULL;
+}
+
+/**
+ * Reset the state. If the client asked for a release event, it's sent once
+ * the buffer is released.
+ */
+static void state_finish(struct wlr_linux_surface_synchronization_v1_state *state,
+		struct wlr_buffer *buffer) {
+	if (state->buffer_release != NULL) {
+		buffer_release_wait(state->buffer_release, buffer);
+	}
+	if (state->acquire_fence_fd >= 0) {
+		close(state->acquire_fence_fd);
+	}
+	state_init(state);
+}
+
+// Returns NULL if the surface's buffer has already been released
+static struct wlr_buffer *surface_get_buffer(struct wlr_surface *surface) {
+	if (surface->buffer == NULL || surface->buffer->resource_released) {
+		return NULL;
+	}
+	return &surface->buffer->base;
+}
+
+// Returns NULL if the surface synchronization is inert
+static struct wlr_linux_surface_synchronization_v1 *
+		surface_sync_from_resource(struct wl_resource *resource) {
+	assert(wl_resource_instance_of(resource,
+		&zwp_linux_surface_synchronization_v1_interface, &surface_sync_impl));
+	return wl_resource_get_user_data(resource);
+}
+
+static void surface_sync_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void surface_sync_handle_set_acquire_fence(struct wl_client *client,
+		struct wl_resource *resource, int32_t fd) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		surface_sync_from_resource(resource);
+	if (surface_sync == NULL) {
+		close(fd);
+		wl_resource_post_error(resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_SURFACE,
+			"set_acquire_fence sent after wl_surface has been destroyed");
+		return;
+	}
+
+	if (surface_sync->pending.acquire_fence_fd >= 0) {
+		close(fd);
+		wl_resource_post_error(resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_DUPLICATE_FENCE,
+			"An acquire fence has already been set for this commit");
+		return;
+	}
+
+	if (fcntl(fd, F_GETFD) < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+		close(fd);
+		wl_resource_post_error(resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_INVALID_FENCE,
+			"Invalid acquire fence FD");
+		return;
+	}
+
+	surface_sync->pending.acquire_fence_fd = fd;
+}
+
+static void surface_sync_handle_get_release(struct wl_client *client,
+		struct wl_resource *resource, uint32_t id) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		surface_sync_from_resource(resource);
+	if (surface_sync == NULL) {
+		wl_resource_post_error(resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_SURFACE,
+			"get_release sent after wl_surface has been destroyed");
+		return;
+	}
+
+	if (surface_sync->pending.buffer_release != NULL) {
+		wl_resource_post_error(resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_DUPLICATE_RELEASE,
+			"A buffer release has already been requested for this commit");
+		return;
+	}
+
+	struct wlr_linux_buffer_release_v1 *release = calloc(1, sizeof(*release));
+	if (release == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	release->resource = wl_resource_create(client,
+		&zwp_linux_buffer_release_v1_interface,
+		wl_resource_get_version(resource), id);
+	if (release->resource == NULL) {
+		wl_client_post_no_memory(client);
+		free(release);
+		return;
+	}
+	wl_resource_set_implementation(release->resource, NULL, release,
+		buffer_release_handle_resource_destroy);
+
+	release->fence_fd = -1;
+	release->state = &surface_sync->pending;
+	surface_sync->pending.buffer_release = release;
+}
+
+static const struct zwp_linux_surface_synchronization_v1_interface
+		surface_sync_impl = {
+	.destroy = surface_sync_handle_destroy,
+	.set_acquire_fence = surface_sync_handle_set_acquire_fence,
+	.get_release = surface_sync_handle_get_release,
+};
+
+static void surface_sync_destroy(
+		struct wlr_linux_surface_synchronization_v1 *surface_sync) {
+	if (surface_sync == NULL) {
+		return;
+	}
+	// The pending buffer has never been committed
+	state_finish(&surface_sync->pending, NULL);
+	state_finish(&surface_sync->current,
+		surface_get_buffer(surface_sync->surface));
+	wl_list_remove(&surface_sync->surface_destroy.link);
+	wl_list_remove(&surface_sync->surface_precommit.link);
+	wl_resource_set_user_data(surface_sync->resource, NULL);
+	free(surface_sync);
+}
+
+static void surface_sync_handle_resource_destroy(struct wl_resource *resource) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		surface_sync_from_resource(resource);
+	surface_sync_destroy(surface_sync);
+}
+
+static void surface_sync_handle_surface_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wl_container_of(listener, surface_sync, surface_destroy);
+	surface_sync_destroy(surface_sync);
+}
+
+static void surface_sync_handle_surface_precommit(struct wl_listener *listener,
+		void *data) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wl_container_of(listener, surface_sync, surface_precommit);
+	struct wlr_surface *surface = surface_sync->surface;
+	struct wlr_linux_surface_synchronization_v1_state *pending =
+		&surface_sync->pending;
+
+	bool has_fence = pending->acquire_fence_fd >= 0 ||
+		pending->buffer_release != NULL;
+	if (!(surface->pending.committed & WLR_SURFACE_STATE_BUFFER)) {
+		if (has_fence) {
+			wl_resource_post_error(surface_sync->resource,
+				ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_NO_BUFFER,
+				"Fence or release requested without a buffer attached");
+		}
+		return;
+	}
+
+	if (pending->acquire_fence_fd >= 0 &&
+			(surface->pending.buffer_resource == NULL ||
+			!wlr_dmabuf_v1_resource_is_buffer(
+				surface->pending.buffer_resource))) {
+		wl_resource_post_error(surface_sync->resource,
+			ZWP_LINUX_SURFACE_SYNCHRONIZATION_V1_ERROR_UNSUPPORTED_BUFFER,
+			"Acquire fences are only supported with DMA-BUF buffers");
+		return;
+	}
+
+	// The previous buffer is about to be replaced: release it once all
+	// consumers are done with it
+	struct wlr_linux_surface_synchronization_v1_state *current =
+		&surface_sync->current;
+	state_finish(current, surface_get_buffer(surface));
+
+	current->acquire_fence_fd = pending->acquire_fence_fd;
+	current->buffer_release = pending->buffer_release;
+	if (current->buffer_release != NULL) {
+		current->buffer_release->state = current;
+	}
+	state_init(pending);
+}
+
+static void explicit_sync_handle_destroy(struct wl_client *client,
+		struct wl_resource *resource) {
+	wl_resource_destroy(resource);
+}
+
+static void explicit_sync_handle_get_synchronization(struct wl_client *client,
+		struct wl_resource *resource, uint32_t id,
+		struct wl_resource *surface_resource) {
+	struct wlr_surface *surface = wlr_surface_from_resource(surface_resource);
+
+	if (wlr_linux_surface_synchronization_v1_from_surface(surface) != NULL) {
+		wl_resource_post_error(resource,
+			ZWP_LINUX_EXPLICIT_SYNCHRONIZATION_V1_ERROR_SYNCHRONIZATION_EXISTS,
+			"wl_surface already has a synchronization object");
+		return;
+	}
+
+	// Fences set from now on are for the next commit, not for a commit
+	// waiting for its buffer
+	wlr_surface_apply_held_commit(surface);
+
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		calloc(1, sizeof(*surface_sync));
+	if (surface_sync == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+
+	uint32_t version = wl_resource_get_version(resource);
+	surface_sync->resource = wl_resource_create(client,
+		&zwp_linux_surface_synchronization_v1_interface, version, id);
+	if (surface_sync->resource == NULL) {
+		wl_client_post_no_memory(client);
+		free(surface_sync);
+		return;
+	}
+	wl_resource_set_implementation(surface_sync->resource, &surface_sync_impl,
+		surface_sync, surface_sync_handle_resource_destroy);
+
+	surface_sync->surface = surface;
+	state_init(&surface_sync->pending);
+	state_init(&surface_sync->current);
+
+	surface_sync->surface_destroy.notify = surface_sync_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &surface_sync->surface_destroy);
+
+	surface_sync->surface_precommit.notify = surface_sync_handle_surface_precommit;
+	wl_signal_add(&surface->events.precommit, &surface_sync->surface_precommit);
+}
+
+static const struct zwp_linux_explicit_synchronization_v1_interface
+		explicit_sync_impl = {
+	.destroy = explicit_sync_handle_destroy,
+	.get_synchronization = explicit_sync_handle_get_synchronization,
+};
+
+struct wlr_linux_surface_synchronization_v1 *
+		wlr_linux_surface_synchronization_v1_from_surface(
+		struct wlr_surface *surface) {
+	struct wl_listener *listener = wl_signal_get(&surface->events.destroy,
+		surface_sync_handle_surface_destroy);
+	if (listener == NULL) {
+		return NULL;
+	}
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wl_container_of(listener, surface_sync, surface_destroy);
+	return surface_sync;
+}
+
+bool wlr_linux_explicit_synchronization_v1_wait_surface(
+		struct wlr_surface *surface, struct wlr_renderer *renderer) {
+	// Signalled fences don't need to be waited on
+	if (wlr_linux_explicit_synchronization_v1_surface_is_ready(surface)) {
+		return true;
+	}
+
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wlr_linux_surface_synchronization_v1_from_surface(surface);
+	int fd = surface_sync->current.acquire_fence_fd;
+	if (!wlr_renderer_wait_fence_fd(renderer, fd)) {
+		struct pollfd pollfd = { .fd = fd, .events = POLLIN };
+		int ret;
+		do {
+			ret = poll(&pollfd, 1, -1);
+		} while (ret < 0 && errno == EINTR);
+		if (ret < 0) {
+			wlr_log_errno(WLR_ERROR, "Failed to wait for acquire fence");
+			return false;
+		}
+	}
+
+	// The fence is kept until it's known to be signalled: the GPU wait is
+	// only queued, and other renderers or direct scan-out need it too
+	return true;
+}
+
+bool wlr_linux_explicit_synchronization_v1_surface_is_ready(
+		struct wlr_surface *surface) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wlr_linux_surface_synchronization_v1_from_surface(surface);
+	if (surface_sync == NULL || surface_sync->current.acquire_fence_fd < 0) {
+		return true;
+	}
+
+	int fd = surface_sync->current.acquire_fence_fd;
+	struct pollfd pollfd = { .fd = fd, .events = POLLIN };
+	int ret;
+	do {
+		ret = poll(&pollfd, 1, 0);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to poll acquire fence");
+		return false;
+	} else if (ret == 0) {
+		return false;
+	}
+
+	// Signalled fences don't need to be waited on anymore
+	close(fd);
+	surface_sync->current.acquire_fence_fd = -1;
+	return true;
+}
+
+void wlr_linux_explicit_synchronization_v1_signal_surface_release(
+		struct wlr_surface *surface, int fence_fd) {
+	struct wlr_linux_surface_synchronization_v1 *surface_sync =
+		wlr_linux_surface_synchronization_v1_from_surface(surface);
+	if (surface_sync == NULL || surface_sync->current.buffer_release == NULL) {
+		return;
+	}
+	struct wlr_linux_buffer_release_v1 *release =
+		surface_sync->current.buffer_release;
+
+	int dup_fd = fcntl(fence_fd, F_DUPFD_CLOEXEC, 0);
+	if (dup_fd < 0) {
+		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
+		return;
+	}
+
+	// Fences from the same renderer signal in order: the last one is enough
+	if (release->fence_fd >= 0) {
+		close(release->fence_fd);
+	}
+	release->fence_fd = dup_fd;
+}
+
+static void explicit_sync_bind(struct wl_client *client, void *data,
+		uint32_t version, uint32_t id) {
+	struct wlr_linux_explicit_synchronization_v1 *explicit_sync = data;
+
+	struct wl_resource *resource = wl_resource_create(client,
+		&zwp_linux_explicit_synchronization_v1_interface, version, id);
+	if (resource == NULL) {
+		wl_client_post_no_memory(client);
+		return;
+	}
+	wl_resource_set_implementation(resource, &explicit_sync_impl,
+		explicit_sync, NULL);
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_linux_explicit_synchronization_v1 *explicit_sync =
+		wl_container_of(listener, explicit_sync, display_destroy);
+	wlr_signal_emit_safe(&explicit_sync->events.destroy, NULL);
+	wl_list_remove(&explicit_sync->display_destroy.link);
+	wl_global_destroy(explicit_sync->global);
+	free(explicit_sync);
+}
+
+struct wlr_linux_explicit_synchronization_v1 *
+		wlr_linux_explicit_synchronization_v1_create(struct wl_display *display) {
+	struct wlr_linux_explicit_synchronization_v1 *explicit_sync =
+		calloc(1, sizeof(*explicit_sync));
+	if (explicit_sync == NULL) {
+		return NULL;
+	}
+
+	explicit_sync->global = wl_global_create(display,
+		&zwp_linux_explicit_synchronization_v1_interface,
+		LINUX_EXPLICIT_SYNCHRONIZATION_V1_VERSION, explicit_sync,
+		explicit_sync_bind);
+	if (explicit_sync->global == NULL) {
+		free(explicit_sync);
+		return NULL;
+	}
+
+	wl_signal_init(&explicit_sync->events.destroy);
+
+	explicit_sync->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &explicit_sync->display_destroy);
+
+	return explicit_sync;
+}
@@ -10,14 +10,17 @@
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_box.h>
+#include <wlr/types/wlr_linux_explicit_synchronization_v1.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_seat.h>
 #include <wlr/types/wlr_surface.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
 #include "util/global.h"
 #include "util/signal.h"
+#include "util/time.h"
 
 #define OUTPUT_VERSION 3
 
@@ -131,12 +134,31 @@ void wlr_output_destroy_global(struct wlr_output *output) {
 	output->global = NULL;
 }
 
+/**
+ * Drop the frame pacing state of a disabled output: no frame event is due, and
+ * the next presentation may have another phase.
+ */
+static void output_reset_frame_pacing(struct wlr_output *output) {
+	struct wlr_output_frame_pacing *pacing = &output->frame_pacing;
+	if (pacing->frame_delayed) {
+		wl_event_source_timer_update(pacing->timer, 0);
+		pacing->frame_delayed = false;
+		output->frame_pending = false;
+	}
+	pacing->last_present = (struct timespec){0};
+	pacing->refresh = 0;
+	pacing->frame_sent = (struct timespec){0};
+}
+
 void wlr_output_update_enabled(struct wlr_output *output, bool enabled) {
 	if (output->enabled == enabled) {
 		return;
 	}
 
 	output->enabled = enabled;
+	if (!enabled) {
+		output_reset_frame_pacing(output);
+	}
 	wlr_signal_emit_safe(&output->events.enable, output);
 }
 
@@ -362,6 +384,7 @@ void wlr_output_init(struct wlr_output *output, struct wlr_backend *backend,
 	output->present_timeout = wl_event_loop_add_timer(wl_display_get_event_loop(display),
 		wlr_output_present_timeout, output);
 	wl_list_init(&output->cursors);
+	wl_list_init(&output->layers);
 	wl_list_init(&output->resources);
 	wl_signal_init(&output->events.frame);
 	wl_signal_init(&output->events.damage);
@@ -393,6 +416,9 @@ void wlr_output_destroy(struct wlr_output *output) {
 	}
 
 	wl_event_source_remove(output->present_timeout);
+	if (output->frame_pacing.timer != NULL) {
+		wl_event_source_remove(output->frame_pacing.timer);
+	}
 	wl_list_remove(&output->display_destroy.link);
 	wlr_output_destroy_global(output);
 
@@ -405,6 +431,11 @@ void wlr_output_destroy(struct wlr_output *output) {
 		wlr_output_cursor_destroy(cursor);
 	}
 
+	struct wlr_output_layer *layer, *tmp_layer;
+	wl_list_for_each_safe(layer, tmp_layer, &output->layers, link) {
+		wlr_output_layer_destroy(layer);
+	}
+
 	if (output->idle_frame != NULL) {
 		wl_event_source_remove(output->idle_frame);
 	}
@@ -501,15 +532,32 @@ void wlr_output_set_damage(struct wlr_output *output,
 	output->pending.committed |= WLR_OUTPUT_STATE_DAMAGE;
 }
 
+void wlr_output_set_layers(struct wlr_output *output,
+		struct wlr_output_layer_state *layers, size_t layers_len) {
+	for (size_t i = 0; i < layers_len; i++) {
+		layers[i].accepted = false;
+	}
+	output->pending.layers = layers;
+	output->pending.layers_len = layers_len;
+	output->pending.committed |= WLR_OUTPUT_STATE_LAYERS;
+}
+
 static void output_state_clear_gamma_lut(struct wlr_output_state *state) {
 	free(state->gamma_lut);
 	state->gamma_lut = NULL;
 	state->committed &= ~WLR_OUTPUT_STATE_GAMMA_LUT;
 }
 
+static void output_state_clear_layers(struct wlr_output_state *state) {
+	state->layers = NULL;
+	state->layers_len = 0;
+	state->committed &= ~WLR_OUTPUT_STATE_LAYERS;
+}
+
 static void output_state_clear(struct wlr_output_state *state) {
 	output_state_clear_buffer(state);
 	output_state_clear_gamma_lut(state);
+	output_state_clear_layers(state);
 	pixman_region32_clear(&state->damage);
 	state->committed = 0;
 }
@@ -534,6 +582,17 @@ static void output_pending_resolution(struct wlr_output *output, int *width,
 	}
 }
 
+static bool output_has_software_cursor(struct wlr_output *output) {
+	struct wlr_output_cursor *cursor;
+	wl_list_for_each(cursor, &output->cursors, link) {
+		if (cursor->enabled && cursor->visible &&
+				cursor != output->hardware_cursor) {
+			return true;
+		}
+	}
+	return false;
+}
+
 static bool output_basic_test(struct wlr_output *output) {
 	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
 		if (output->frame_pending) {
@@ -549,14 +608,10 @@ static bool output_basic_test(struct wlr_output *output) {
 
 			// If the output has at least one software cursor, refuse to attach the
 			// buffer
-			struct wlr_output_cursor *cursor;
-			wl_list_for_each(cursor, &output->cursors, link) {
-				if (cursor->enabled && cursor->visible &&
-						cursor != output->hardware_cursor) {
-					wlr_log(WLR_DEBUG,
-						"Direct scan-out disabled by software cursor");
-					return false;
-				}
+			if (output_has_software_cursor(output)) {
+				wlr_log(WLR_DEBUG,
+					"Direct scan-out disabled by software cursor");
+				return false;
 			}
 
 			// If the size doesn't match, reject buffer (scaling is not
@@ -596,6 +651,25 @@ static bool output_basic_test(struct wlr_output *output) {
 	return true;
 }
 
+static void frame_pacing_record_render(struct wlr_output *output) {
+	struct wlr_output_frame_pacing *pacing = &output->frame_pacing;
+	if (!pacing->enabled ||
+			(pacing->frame_sent.tv_sec == 0 && pacing->frame_sent.tv_nsec == 0)) {
+		return;
+	}
+
+	struct timespec now;
+	clock_gettime(wlr_backend_get_presentation_clock(output->backend), &now);
+	pacing->render_nsec[pacing->render_nsec_next] =
+		timespec_to_nsec(&now) - timespec_to_nsec(&pacing->frame_sent);
+	pacing->render_nsec_next =
+		(pacing->render_nsec_next + 1) % WLR_OUTPUT_FRAME_PACING_HISTORY;
+	if (pacing->render_nsec_len < WLR_OUTPUT_FRAME_PACING_HISTORY) {
+		pacing->render_nsec_len++;
+	}
+	pacing->frame_sent = (struct timespec){0};
+}
+
 bool wlr_output_test(struct wlr_output *output) {
 	if (!output_basic_test(output)) {
 		return false;
@@ -615,6 +689,10 @@ bool wlr_output_commit(struct wlr_output *output) {
 		output->idle_frame = NULL;
 	}
 
+	if (output->pending.committed & WLR_OUTPUT_STATE_BUFFER) {
+		frame_pacing_record_render(output);
+	}
+
 	struct timespec now;
 	clock_gettime(CLOCK_MONOTONIC, &now);
 
@@ -708,11 +786,189 @@ void wlr_output_attach_buffer(struct wlr_output *output,
 	output->pending.buffer = wlr_buffer_lock(buffer);
 }
 
-void wlr_output_send_frame(struct wlr_output *output) {
+static enum wlr_output_scanout_status output_try_scanout_surface(
+		struct wlr_output *output, struct wlr_surface *surface) {
+	if (surface->buffer == NULL) {
+		return WLR_OUTPUT_SCANOUT_NO_BUFFER;
+	}
+
+	if (output->attach_render_locks > 0 ||
+			output_has_software_cursor(output)) {
+		return WLR_OUTPUT_SCANOUT_LOCKED;
+	}
+
+	// The buffer must already be laid out like the output's framebuffer
+	if (surface->current.transform != output->transform ||
+			surface->current.scale != output->scale) {
+		return WLR_OUTPUT_SCANOUT_TRANSFORM;
+	}
+
+	if (surface->current.viewport.has_src ||
+			surface->current.viewport.has_dst) {
+		return WLR_OUTPUT_SCANOUT_VIEWPORT;
+	}
+
+	int pending_width, pending_height;
+	output_pending_resolution(output, &pending_width, &pending_height);
+	struct wlr_buffer *buffer = &surface->buffer->base;
+	if (buffer->width != pending_width || buffer->height != pending_height) {
+		return WLR_OUTPUT_SCANOUT_SIZE;
+	}
+
+	// KMS would scan out the buffer while the client is still writing to it
+	if (!wlr_linux_explicit_synchronization_v1_surface_is_ready(surface)) {
+		return WLR_OUTPUT_SCANOUT_FENCE;
+	}
+
+	wlr_output_attach_buffer(output, buffer);
+	if (!wlr_output_test(output)) {
+		output_state_clear_buffer(&output->pending);
+		return WLR_OUTPUT_SCANOUT_REJECTED;
+	}
+
+	return WLR_OUTPUT_SCANOUT_OK;
+}
+
+enum wlr_output_scanout_status wlr_output_try_scanout_surface(
+		struct wlr_output *output, struct wlr_surface *surface) {
+	enum wlr_output_scanout_status status =
+		output_try_scanout_surface(output, surface);
+
+	struct wlr_output_scanout_stats *stats = &output->scanout_stats;
+	stats->attempts++;
+	stats->results[status]++;
+
+	if (status != WLR_OUTPUT_SCANOUT_OK) {
+		wlr_log(WLR_DEBUG, "Direct scan-out on %s failed: %s", output->name,
+			wlr_output_scanout_status_name(status));
+	}
+	return status;
+}
+
+const char *wlr_output_scanout_status_name(
+		enum wlr_output_scanout_status status) {
+	switch (status) {
+	case WLR_OUTPUT_SCANOUT_OK:
+		return "ok";
+	case WLR_OUTPUT_SCANOUT_NO_BUFFER:
+		return "no buffer";
+	case WLR_OUTPUT_SCANOUT_LOCKED:
+		return "locked";
+	case WLR_OUTPUT_SCANOUT_TRANSFORM:
+		return "transform mismatch";
+	case WLR_OUTPUT_SCANOUT_VIEWPORT:
+		return "viewport";
+	case WLR_OUTPUT_SCANOUT_FENCE:
+		return "acquire fence pending";
+	case WLR_OUTPUT_SCANOUT_SIZE:
+		return "size mismatch";
+	case WLR_OUTPUT_SCANOUT_REJECTED:
+		return "rejected by backend";
+	}
+	abort();
+}
+
+static void output_emit_frame(struct wlr_output *output) {
+	struct wlr_output_frame_pacing *pacing = &output->frame_pacing;
 	output->frame_pending = false;
+	pacing->frame_delayed = false;
+	if (pacing->enabled) {
+		clock_gettime(wlr_backend_get_presentation_clock(output->backend),
+			&pacing->frame_sent);
+	}
 	wlr_signal_emit_safe(&output->events.frame, output);
 }
 
+static int frame_pacing_handle_timer(void *data) {
+	struct wlr_output *output = data;
+	output_emit_frame(output);
+	return 0;
+}
+
+static int64_t frame_pacing_predict_render(
+		struct wlr_output_frame_pacing *pacing) {
+	// Be pessimistic: a missed vblank costs a whole refresh period
+	int64_t max = 0;
+	for (size_t i = 0; i < pacing->render_nsec_len; ++i) {
+		if (pacing->render_nsec[i] > max) {
+			max = pacing->render_nsec[i];
+		}
+	}
+	return max;
+}
+
+// Time left to render after the frame event, in addition to the prediction
+#define FRAME_PACING_MARGIN_NSEC 2000000 // 2ms
+
+/**
+ * Delay the frame event until the predicted render start time, if frame
+ * pacing is enabled. Returns false if the frame event should be sent now.
+ */
+static bool frame_pacing_delay_frame(struct wlr_output *output) {
+	struct wlr_output_frame_pacing *pacing = &output->frame_pacing;
+	if (!pacing->enabled || pacing->refresh <= 0 ||
+			pacing->render_nsec_len == 0 ||
+			output->present_mode != WLR_OUTPUT_PRESENT_MODE_NORMAL) {
+		return false;
+	}
+
+	struct timespec now_ts;
+	clock_gettime(wlr_backend_get_presentation_clock(output->backend),
+		&now_ts);
+	int64_t now = timespec_to_nsec(&now_ts);
+
+	// The next vblank we can hit
+	int64_t next_vblank = timespec_to_nsec(&pacing->last_present) +
+		pacing->refresh;
+	if (next_vblank <= now) {
+		next_vblank += ((now - next_vblank) / pacing->refresh + 1) *
+			pacing->refresh;
+	}
+
+	int64_t start = next_vblank - frame_pacing_predict_render(pacing) -
+		FRAME_PACING_MARGIN_NSEC;
+	// Event loop timers have a millisecond resolution
+	int64_t delay_ms = (start - now) / 1000000;
+	if (delay_ms <= 0) {
+		return false;
+	}
+
+	if (pacing->timer == NULL) {
+		struct wl_event_loop *ev = wl_display_get_event_loop(output->display);
+		pacing->timer =
+			wl_event_loop_add_timer(ev, frame_pacing_handle_timer, output);
+		if (pacing->timer == NULL) {
+			return false;
+		}
+	}
+	wl_event_source_timer_update(pacing->timer, delay_ms);
+	pacing->frame_delayed = true;
+	return true;
+}
+
+void wlr_output_send_frame(struct wlr_output *output) {
+	if (frame_pacing_delay_frame(output)) {
+		// frame_pending stays set until the delayed frame event is sent
+		return;
+	}
+	output_emit_frame(output);
+}
+
+void wlr_output_set_frame_pacing(struct wlr_output *output, bool enabled) {
+	struct wlr_output_frame_pacing *pacing = &output->frame_pacing;
+	if (pacing->enabled == enabled) {
+		return;
+	}
+	pacing->enabled = enabled;
+	pacing->render_nsec_len = pacing->render_nsec_next = 0;
+	pacing->frame_sent = (struct timespec){0};
+
+	if (!enabled && pacing->frame_delayed) {
+		wl_event_source_timer_update(pacing->timer, 0);
+		output_emit_frame(output);
+	}
+}
+
 void wlr_output_schedule_frame(struct wlr_output *output) {
 	// Make sure the compositor commits a new frame. This is necessary to make
 	// clients which ask for frame callbacks without submitting a new buffer
@@ -741,6 +997,13 @@ void wlr_output_send_present(struct wlr_output *output,
 
 	event->output = output;
 
+	// Discarded frames and backends without presentation feedback don't
+	// report a timestamp: only actual presentation times drive frame pacing
+	if (event->when != NULL) {
+		output->frame_pacing.last_present = *event->when;
+		output->frame_pacing.refresh = event->refresh;
+	}
+
 	struct timespec now;
 	if (event->when == NULL) {
 		clockid_t clock = wlr_backend_get_presentation_clock(output->backend);
@@ -0,0 +1,27 @@
+#include <stdlib.h>
+#include <wlr/types/wlr_output_layer.h>
+#include <wlr/util/log.h>
+#include "util/signal.h"
+
+struct wlr_output_layer *wlr_output_layer_create(struct wlr_output *output) {
+	struct wlr_output_layer *layer = calloc(1, sizeof(*layer));
+	if (layer == NULL) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+
+	wl_list_insert(output->layers.prev, &layer->link);
+	wl_signal_init(&layer->events.destroy);
+
+	return layer;
+}
+
+void wlr_output_layer_destroy(struct wlr_output_layer *layer) {
+	if (layer == NULL) {
+		return;
+	}
+
+	wlr_signal_emit_safe(&layer->events.destroy, layer);
+	wl_list_remove(&layer->link);
+	free(layer);
+}
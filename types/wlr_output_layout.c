@@ -1,15 +1,37 @@
 #include <assert.h>
 #include <float.h>
 #include <limits.h>
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/types/wlr_box.h>
 #include <wlr/types/wlr_output_layout.h>
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
 #include "util/signal.h"
 
+// The layout extents are split into a GRID_SIZE x GRID_SIZE grid for hit-tests
+#define GRID_SIZE 8
+
+struct wlr_output_layout_entry {
+	struct wlr_output_layout_output *l_output;
+	struct wlr_box box;
+	uint32_t commit_seq; // of the output when the box was computed
+};
+
 struct wlr_output_layout_state {
 	struct wlr_box _box; // should never be read directly, use the getter
+
+	// Index of the output boxes, in layout order. Rebuilt on the first query
+	// after output_layout_reconfigure or after any output commit.
+	bool index_dirty;
+	struct wlr_output_layout_entry *entries;
+	size_t entries_len;
+	struct wlr_box extents;
+	// Entries overlapping each grid cell, in layout order: cell i lists
+	// cell_entries[cell_start[i]] to cell_entries[cell_start[i + 1] - 1]
+	size_t cell_start[GRID_SIZE * GRID_SIZE + 1];
+	size_t *cell_entries;
 };
 
 struct wlr_output_layout_output_state {
@@ -35,6 +57,7 @@ struct wlr_output_layout *wlr_output_layout_create(void) {
 		free(layout);
 		return NULL;
 	}
+	layout->state->index_dirty = true;
 	wl_list_init(&layout->outputs);
 
 	wl_signal_init(&layout->events.add);
@@ -52,6 +75,7 @@ static void output_layout_output_destroy(
 	wl_list_remove(&l_output->state->commit.link);
 	wl_list_remove(&l_output->state->output_destroy.link);
 	wl_list_remove(&l_output->link);
+	l_output->state->layout->state->index_dirty = true;
 	free(l_output->state);
 	free(l_output);
 }
@@ -68,6 +92,8 @@ void wlr_output_layout_destroy(struct wlr_output_layout *layout) {
 		output_layout_output_destroy(l_output);
 	}
 
+	free(layout->state->entries);
+	free(layout->state->cell_entries);
 	free(layout->state);
 	free(layout);
 }
@@ -83,6 +109,156 @@ static struct wlr_box *output_layout_output_get_box(
 	return &l_output->state->_box;
 }
 
+static int grid_cell(int extent_pos, int extent_size, double pos) {
+	return floor((pos - extent_pos) * GRID_SIZE / extent_size);
+}
+
+static void grid_range(int extent_pos, int extent_size, int pos, int size,
+		int *first, int *last) {
+	// Rounding may put the far edge in the next cell, which is harmless
+	*first = grid_cell(extent_pos, extent_size, pos);
+	*last = grid_cell(extent_pos, extent_size, pos + size);
+	if (*first < 0) {
+		*first = 0;
+	}
+	if (*last >= GRID_SIZE) {
+		*last = GRID_SIZE - 1;
+	}
+}
+
+static void output_layout_rebuild_index(struct wlr_output_layout *layout) {
+	struct wlr_output_layout_state *state = layout->state;
+	state->index_dirty = false;
+	state->entries_len = 0;
+	state->extents = (struct wlr_box){0};
+	memset(state->cell_start, 0, sizeof(state->cell_start));
+
+	size_t len = wl_list_length(&layout->outputs);
+	struct wlr_output_layout_entry *entries =
+		realloc(state->entries, len * sizeof(*entries));
+	if (len > 0 && entries == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		state->index_dirty = true;
+		return;
+	}
+	state->entries = entries;
+
+	int min_x = INT_MAX, min_y = INT_MAX, max_x = INT_MIN, max_y = INT_MIN;
+	struct wlr_output_layout_output *l_output;
+	wl_list_for_each(l_output, &layout->outputs, link) {
+		struct wlr_output_layout_entry *entry = &entries[state->entries_len++];
+		entry->l_output = l_output;
+		entry->box = *output_layout_output_get_box(l_output);
+		entry->commit_seq = l_output->output->commit_seq;
+		if (wlr_box_empty(&entry->box)) {
+			continue;
+		}
+		if (entry->box.x < min_x) {
+			min_x = entry->box.x;
+		}
+		if (entry->box.y < min_y) {
+			min_y = entry->box.y;
+		}
+		if (entry->box.x + entry->box.width > max_x) {
+			max_x = entry->box.x + entry->box.width;
+		}
+		if (entry->box.y + entry->box.height > max_y) {
+			max_y = entry->box.y + entry->box.height;
+		}
+	}
+
+	if (min_x == INT_MAX) {
+		// no output can be hit
+		return;
+	}
+	state->extents = (struct wlr_box){
+		.x = min_x,
+		.y = min_y,
+		.width = max_x - min_x,
+		.height = max_y - min_y,
+	};
+
+	// Count the entries of each cell, then lay them out contiguously
+	size_t total = 0;
+	for (int pass = 0; pass < 2; pass++) {
+		size_t fill[GRID_SIZE * GRID_SIZE] = {0};
+		for (size_t i = 0; i < state->entries_len; i++) {
+			const struct wlr_box *box = &entries[i].box;
+			if (wlr_box_empty(box)) {
+				continue;
+			}
+			int x1, x2, y1, y2;
+			grid_range(state->extents.x, state->extents.width,
+				box->x, box->width, &x1, &x2);
+			grid_range(state->extents.y, state->extents.height,
+				box->y, box->height, &y1, &y2);
+			for (int y = y1; y <= y2; y++) {
+				for (int x = x1; x <= x2; x++) {
+					size_t cell = y * GRID_SIZE + x;
+					if (pass == 0) {
+						state->cell_start[cell + 1]++;
+					} else {
+						state->cell_entries[state->cell_start[cell] +
+							fill[cell]++] = i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0) {
+			for (size_t cell = 0; cell < GRID_SIZE * GRID_SIZE; cell++) {
+				state->cell_start[cell + 1] += state->cell_start[cell];
+			}
+			total = state->cell_start[GRID_SIZE * GRID_SIZE];
+			size_t *cell_entries = realloc(state->cell_entries,
+				total * sizeof(*cell_entries));
+			if (cell_entries == NULL) {
+				wlr_log(WLR_ERROR, "Allocation failed");
+				state->index_dirty = true;
+				state->entries_len = 0;
+				state->extents = (struct wlr_box){0};
+				memset(state->cell_start, 0, sizeof(state->cell_start));
+				return;
+			}
+			state->cell_entries = cell_entries;
+		}
+	}
+}
+
+static bool output_layout_index_is_stale(struct wlr_output_layout *layout) {
+	struct wlr_output_layout_state *state = layout->state;
+	if (state->index_dirty) {
+		return true;
+	}
+	// Commit handlers may query the layout before it gets the commit event
+	for (size_t i = 0; i < state->entries_len; i++) {
+		struct wlr_output_layout_entry *entry = &state->entries[i];
+		if (entry->commit_seq != entry->l_output->output->commit_seq) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static struct wlr_output_layout_state *output_layout_get_index(
+		struct wlr_output_layout *layout) {
+	if (output_layout_index_is_stale(layout)) {
+		output_layout_rebuild_index(layout);
+	}
+	return layout->state;
+}
+
+static struct wlr_output_layout_entry *output_layout_get_entry(
+		struct wlr_output_layout *layout, struct wlr_output *reference) {
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	for (size_t i = 0; i < state->entries_len; i++) {
+		if (state->entries[i].l_output->output == reference) {
+			return &state->entries[i];
+		}
+	}
+	return NULL;
+}
+
 /**
  * This must be called whenever the layout changes to reconfigure the auto
  * configured outputs and emit the `changed` event.
@@ -125,6 +301,8 @@ static void output_layout_reconfigure(struct wlr_output_layout *layout) {
 		max_x += box->width;
 	}
 
+	layout->state->index_dirty = true;
+
 	wlr_signal_emit_safe(&layout->events.change, layout);
 }
 
@@ -228,10 +406,9 @@ struct wlr_output_layout_output *wlr_output_layout_get(
 bool wlr_output_layout_contains_point(struct wlr_output_layout *layout,
 		struct wlr_output *reference, int lx, int ly) {
 	if (reference) {
-		struct wlr_output_layout_output *l_output =
-			wlr_output_layout_get(layout, reference);
-		struct wlr_box *box = output_layout_output_get_box(l_output);
-		return wlr_box_contains_point(box, lx, ly);
+		struct wlr_output_layout_entry *entry =
+			output_layout_get_entry(layout, reference);
+		return entry != NULL && wlr_box_contains_point(&entry->box, lx, ly);
 	} else {
 		return !!wlr_output_layout_output_at(layout, lx, ly);
 	}
@@ -242,34 +419,46 @@ bool wlr_output_layout_intersects(struct wlr_output_layout *layout,
 	struct wlr_box out_box;
 
 	if (reference == NULL) {
-		struct wlr_output_layout_output *l_output;
-		wl_list_for_each(l_output, &layout->outputs, link) {
-			struct wlr_box *output_box =
-				output_layout_output_get_box(l_output);
-			if (wlr_box_intersection(&out_box, output_box, target_lbox)) {
+		struct wlr_output_layout_state *state = output_layout_get_index(layout);
+		for (size_t i = 0; i < state->entries_len; i++) {
+			if (wlr_box_intersection(&out_box, &state->entries[i].box,
+					target_lbox)) {
 				return true;
 			}
 		}
 		return false;
 	} else {
-		struct wlr_output_layout_output *l_output =
-			wlr_output_layout_get(layout, reference);
-		if (!l_output) {
+		struct wlr_output_layout_entry *entry =
+			output_layout_get_entry(layout, reference);
+		if (!entry) {
 			return false;
 		}
 
-		struct wlr_box *output_box = output_layout_output_get_box(l_output);
-		return wlr_box_intersection(&out_box, output_box, target_lbox);
+		return wlr_box_intersection(&out_box, &entry->box, target_lbox);
 	}
 }
 
 struct wlr_output *wlr_output_layout_output_at(struct wlr_output_layout *layout,
 		double lx, double ly) {
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		struct wlr_box *box = output_layout_output_get_box(l_output);
-		if (wlr_box_contains_point(box, lx, ly)) {
-			return l_output->output;
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	if (!wlr_box_contains_point(&state->extents, lx, ly)) {
+		return NULL;
+	}
+
+	int x = grid_cell(state->extents.x, state->extents.width, lx);
+	int y = grid_cell(state->extents.y, state->extents.height, ly);
+	if (x < 0 || x >= GRID_SIZE || y < 0 || y >= GRID_SIZE) {
+		return NULL;
+	}
+
+	// Cell entries are in layout order, the first match wins
+	size_t cell = y * GRID_SIZE + x;
+	for (size_t i = state->cell_start[cell];
+			i < state->cell_start[cell + 1]; i++) {
+		struct wlr_output_layout_entry *entry =
+			&state->entries[state->cell_entries[i]];
+		if (wlr_box_contains_point(&entry->box, lx, ly)) {
+			return entry->l_output->output;
 		}
 	}
 	return NULL;
@@ -322,16 +511,27 @@ void wlr_output_layout_closest_point(struct wlr_output_layout *layout,
 		return;
 	}
 
+	// A point inside the layout is its own closest point
+	if (reference == NULL && wlr_output_layout_output_at(layout, lx, ly)) {
+		if (dest_lx) {
+			*dest_lx = lx;
+		}
+		if (dest_ly) {
+			*dest_ly = ly;
+		}
+		return;
+	}
+
 	double min_x = 0, min_y = 0, min_distance = DBL_MAX;
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		if (reference != NULL && reference != l_output->output) {
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	for (size_t i = 0; i < state->entries_len; i++) {
+		struct wlr_output_layout_entry *entry = &state->entries[i];
+		if (reference != NULL && reference != entry->l_output->output) {
 			continue;
 		}
 
 		double output_x, output_y, output_distance;
-		struct wlr_box *box = output_layout_output_get_box(l_output);
-		wlr_box_closest_point(box, lx, ly, &output_x, &output_y);
+		wlr_box_closest_point(&entry->box, lx, ly, &output_x, &output_y);
 
 		// calculate squared distance suitable for comparison
 		output_distance =
@@ -370,12 +570,13 @@ struct wlr_box *wlr_output_layout_get_box(
 		}
 	} else {
 		// layout extents
+		struct wlr_output_layout_state *state = output_layout_get_index(layout);
 		int min_x = 0, max_x = 0, min_y = 0, max_y = 0;
-		if (!wl_list_empty(&layout->outputs)) {
+		if (state->entries_len > 0) {
 			min_x = min_y = INT_MAX;
 			max_x = max_y = INT_MIN;
-			wl_list_for_each(l_output, &layout->outputs, link) {
-				struct wlr_box *box = output_layout_output_get_box(l_output);
+			for (size_t i = 0; i < state->entries_len; i++) {
+				struct wlr_box *box = &state->entries[i].box;
 				if (box->x < min_x) {
 					min_x = box->x;
 				}
@@ -456,12 +657,13 @@ static struct wlr_output *wlr_output_layout_output_in_direction(
 
 	double min_distance = (distance_method == NEAREST) ? DBL_MAX : DBL_MIN;
 	struct wlr_output *closest_output = NULL;
-	struct wlr_output_layout_output *l_output;
-	wl_list_for_each(l_output, &layout->outputs, link) {
-		if (reference != NULL && reference == l_output->output) {
+	struct wlr_output_layout_state *state = output_layout_get_index(layout);
+	for (size_t i = 0; i < state->entries_len; i++) {
+		struct wlr_output_layout_entry *entry = &state->entries[i];
+		if (reference != NULL && reference == entry->l_output->output) {
 			continue;
 		}
-		struct wlr_box *box = output_layout_output_get_box(l_output);
+		struct wlr_box *box = &entry->box;
 
 		bool match = false;
 		// test to make sure this output is in the given direction
@@ -483,8 +685,7 @@ static struct wlr_output *wlr_output_layout_output_in_direction(
 
 		// calculate distance from the given reference point
 		double x, y;
-		wlr_output_layout_closest_point(layout, l_output->output,
-			ref_lx, ref_ly, &x, &y);
+		wlr_box_closest_point(box, ref_lx, ref_ly, &x, &y);
 		double distance =
 			(x - ref_lx) * (x - ref_lx) + (y - ref_ly) * (y - ref_ly);
 
@@ -492,7 +693,7 @@ static struct wlr_output *wlr_output_layout_output_in_direction(
 				? distance < min_distance
 				: distance > min_distance) {
 			min_distance = distance;
-			closest_output = l_output->output;
+			closest_output = entry->l_output->output;
 		}
 	}
 	return closest_output;
@@ -8,6 +8,7 @@
 #include <wlr/types/wlr_pointer.h>
 #include <wlr/types/wlr_pointer_gestures_v1.h>
 #include <wlr/util/log.h>
+#include "types/wlr_seat.h"
 #include "util/signal.h"
 #include "pointer-gestures-unstable-v1-protocol.h"
 
@@ -52,6 +53,8 @@ void wlr_pointer_gestures_v1_send_swipe_begin(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 	uint32_t serial = wlr_seat_client_next_serial(
 		seat->pointer_state.focused_client);
@@ -79,6 +82,8 @@ void wlr_pointer_gestures_v1_send_swipe_update(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 
 	struct wl_resource *gesture;
@@ -103,6 +108,8 @@ void wlr_pointer_gestures_v1_send_swipe_end(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 	uint32_t serial = wlr_seat_client_next_serial(
 		seat->pointer_state.focused_client);
@@ -164,6 +171,8 @@ void wlr_pointer_gestures_v1_send_pinch_begin(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 	uint32_t serial = wlr_seat_client_next_serial(
 		seat->pointer_state.focused_client);
@@ -193,6 +202,8 @@ void wlr_pointer_gestures_v1_send_pinch_update(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 
 	struct wl_resource *gesture;
@@ -219,6 +230,8 @@ void wlr_pointer_gestures_v1_send_pinch_end(
 		return;
 	}
 
+	seat_pointer_flush(seat);
+
 	struct wl_client *focus_client = wl_resource_get_client(focus->resource);
 	uint32_t serial = wlr_seat_client_next_serial(
 		seat->pointer_state.focused_client);
@@ -8,6 +8,7 @@
 #include <wlr/types/wlr_seat.h>
 #include <wlr/util/log.h>
 #include "relative-pointer-unstable-v1-protocol.h"
+#include "types/wlr_seat.h"
 
 #define RELATIVE_POINTER_MANAGER_VERSION 1
 
@@ -43,6 +44,7 @@ static void relative_pointer_destroy(struct wlr_relative_pointer_v1 *relative_po
 	wl_list_remove(&relative_pointer->link);
 	wl_list_remove(&relative_pointer->seat_destroy.link);
 	wl_list_remove(&relative_pointer->pointer_destroy.link);
+	wl_list_remove(&relative_pointer->seat_pointer_flush.link);
 
 	wl_resource_set_user_data(relative_pointer->resource, NULL);
 	free(relative_pointer);
@@ -84,6 +86,40 @@ static void relative_pointer_handle_pointer_destroy(struct wl_listener *listener
 	relative_pointer_destroy(relative_pointer);
 }
 
+static void relative_pointer_send_motion(
+		struct wlr_relative_pointer_v1 *relative_pointer, uint64_t time_usec,
+		double dx, double dy, double dx_unaccel, double dy_unaccel) {
+	zwp_relative_pointer_v1_send_relative_motion(relative_pointer->resource,
+		(uint32_t)(time_usec >> 32), (uint32_t)time_usec,
+		wl_fixed_from_double(dx), wl_fixed_from_double(dy),
+		wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+	relative_pointer->seat->pointer_state.coalesce_stats.relative_motion_sent++;
+}
+
+static void relative_pointer_handle_seat_pointer_flush(
+		struct wl_listener *listener, void *data) {
+	struct wlr_relative_pointer_v1 *relative_pointer =
+		wl_container_of(listener, relative_pointer, seat_pointer_flush);
+	if (!relative_pointer->batch.pending) {
+		return;
+	}
+	relative_pointer->batch.pending = false;
+
+	// Focus changes send the coalesced frame first
+	struct wlr_seat_client *seat_client =
+		wlr_seat_client_from_pointer_resource(
+		relative_pointer->pointer_resource);
+	if (seat_client == NULL ||
+			seat_client != relative_pointer->seat->pointer_state.focused_client) {
+		return;
+	}
+
+	relative_pointer_send_motion(relative_pointer,
+		relative_pointer->batch.time_usec,
+		relative_pointer->batch.dx, relative_pointer->batch.dy,
+		relative_pointer->batch.dx_unaccel, relative_pointer->batch.dy_unaccel);
+}
+
 /**
  * relative_pointer_manager handler functions
  */
@@ -139,6 +175,11 @@ static void relative_pointer_manager_v1_handle_get_relative_pointer(struct wl_cl
 			&relative_pointer->pointer_destroy);
 	relative_pointer->pointer_destroy.notify = relative_pointer_handle_pointer_destroy;
 
+	wl_signal_add(&relative_pointer->seat->pointer_state.batch.flush,
+			&relative_pointer->seat_pointer_flush);
+	relative_pointer->seat_pointer_flush.notify =
+		relative_pointer_handle_seat_pointer_flush;
+
 	wlr_signal_emit_safe(&manager->events.new_relative_pointer,
 		relative_pointer);
 
@@ -226,6 +267,8 @@ void wlr_relative_pointer_manager_v1_send_relative_motion(
 		return;
 	}
 
+	bool coalesce = seat_pointer_coalesce_relative_motion(seat);
+
 	struct wlr_relative_pointer_v1 *pointer;
 	wl_list_for_each(pointer, &manager->relative_pointers, link) {
 		struct wlr_seat_client *seat_client =
@@ -234,9 +277,24 @@ void wlr_relative_pointer_manager_v1_send_relative_motion(
 			continue;
 		}
 
-		zwp_relative_pointer_v1_send_relative_motion(pointer->resource,
-			(uint32_t)(time_usec >> 32), (uint32_t)time_usec,
-			wl_fixed_from_double(dx), wl_fixed_from_double(dy),
-			wl_fixed_from_double(dx_unaccel), wl_fixed_from_double(dy_unaccel));
+		if (!coalesce) {
+			relative_pointer_send_motion(pointer, time_usec, dx, dy,
+				dx_unaccel, dy_unaccel);
+			continue;
+		}
+
+		// Deltas add up, the latest timestamp wins
+		if (pointer->batch.pending) {
+			seat->pointer_state.coalesce_stats.relative_motion_coalesced++;
+		} else {
+			pointer->batch.pending = true;
+			pointer->batch.dx = pointer->batch.dy = 0;
+			pointer->batch.dx_unaccel = pointer->batch.dy_unaccel = 0;
+		}
+		pointer->batch.time_usec = time_usec;
+		pointer->batch.dx += dx;
+		pointer->batch.dy += dy;
+		pointer->batch.dx_unaccel += dx_unaccel;
+		pointer->batch.dy_unaccel += dy_unaccel;
 	}
 }
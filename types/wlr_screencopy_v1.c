@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <drm_fourcc.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_output.h>
@@ -20,6 +21,13 @@ struct screencopy_damage {
 	struct wl_listener output_precommit;
 	struct wl_listener output_destroy;
 	uint32_t last_commit_seq;
+
+	// The shm buffer the last damage-tracked frame was copied into. If the
+	// client re-uses it for the same region, only the damaged part needs to
+	// be read back: the rest of the buffer is still up-to-date.
+	struct wl_resource *last_buffer;
+	struct wlr_box last_box;
+	struct wl_listener last_buffer_destroy;
 };
 
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
@@ -71,7 +79,40 @@ static void screencopy_damage_handle_output_precommit(
 	screencopy_damage_accumulate(damage);
 }
 
+static void screencopy_damage_set_last_buffer(
+		struct screencopy_damage *damage, struct wl_resource *buffer,
+		const struct wlr_box *box);
+
+static void screencopy_damage_handle_last_buffer_destroy(
+		struct wl_listener *listener, void *data) {
+	struct screencopy_damage *damage =
+		wl_container_of(listener, damage, last_buffer_destroy);
+	screencopy_damage_set_last_buffer(damage, NULL, NULL);
+}
+
+static void screencopy_damage_set_last_buffer(
+		struct screencopy_damage *damage, struct wl_resource *buffer,
+		const struct wlr_box *box) {
+	if (buffer != NULL && damage->last_buffer == buffer) {
+		damage->last_box = *box;
+		return;
+	}
+
+	wl_list_remove(&damage->last_buffer_destroy.link);
+	wl_list_init(&damage->last_buffer_destroy.link);
+	damage->last_buffer = buffer;
+	if (buffer == NULL) {
+		return;
+	}
+
+	damage->last_box = *box;
+	damage->last_buffer_destroy.notify =
+		screencopy_damage_handle_last_buffer_destroy;
+	wl_resource_add_destroy_listener(buffer, &damage->last_buffer_destroy);
+}
+
 static void screencopy_damage_destroy(struct screencopy_damage *damage) {
+	wl_list_remove(&damage->last_buffer_destroy.link);
 	wl_list_remove(&damage->output_destroy.link);
 	wl_list_remove(&damage->output_precommit.link);
 	wl_list_remove(&damage->link);
@@ -108,6 +149,8 @@ static struct screencopy_damage *screencopy_damage_create(
 	wl_signal_add(&output->events.destroy, &damage->output_destroy);
 	damage->output_destroy.notify = screencopy_damage_handle_output_destroy;
 
+	wl_list_init(&damage->last_buffer_destroy.link);
+
 	return damage;
 }
 
@@ -151,6 +194,11 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 			wlr_output_lock_software_cursors(frame->output, false);
 		}
 	}
+	if (frame->readback != NULL) {
+		wlr_renderer_readback_cancel(frame->readback);
+	}
+	pixman_region32_fini(&frame->readback_region);
+	pixman_region32_fini(&frame->readback_damage);
 	wl_list_remove(&frame->link);
 	wl_list_remove(&frame->output_precommit.link);
 	wl_list_remove(&frame->output_commit.link);
@@ -163,6 +211,20 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	free(frame);
 }
 
+static void frame_send_damage_region(struct wlr_screencopy_frame_v1 *frame,
+		struct pixman_region32 *region) {
+	// TODO: send fine-grained damage events
+	struct pixman_box32 *damage_box = pixman_region32_extents(region);
+
+	int damage_x = damage_box->x1;
+	int damage_y = damage_box->y1;
+	int damage_width = damage_box->x2 - damage_box->x1;
+	int damage_height = damage_box->y2 - damage_box->y1;
+
+	zwlr_screencopy_frame_v1_send_damage(frame->resource,
+		damage_x, damage_y, damage_width, damage_height);
+}
+
 static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame) {
 	if (!frame->with_damage) {
 		return;
@@ -174,18 +236,7 @@ static void frame_send_damage(struct wlr_screencopy_frame_v1 *frame) {
 		return;
 	}
 
-	// TODO: send fine-grained damage events
-	struct pixman_box32 *damage_box =
-		pixman_region32_extents(&damage->damage);
-
-	int damage_x = damage_box->x1;
-	int damage_y = damage_box->y1;
-	int damage_width = damage_box->x2 - damage_box->x1;
-	int damage_height = damage_box->y2 - damage_box->y1;
-
-	zwlr_screencopy_frame_v1_send_damage(frame->resource,
-		damage_x, damage_y, damage_width, damage_height);
-
+	frame_send_damage_region(frame, &damage->damage);
 	pixman_region32_clear(&damage->damage);
 }
 
@@ -198,6 +249,95 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
+static bool frame_read_pixels(struct wlr_screencopy_frame_v1 *frame,
+		struct wlr_renderer *renderer, uint32_t drm_format, uint32_t *flags,
+		int32_t stride, void *data) {
+	struct wlr_box *box = &frame->box;
+
+	bool ok = true;
+	int rects_len;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&frame->readback_region, &rects_len);
+	for (int i = 0; i < rects_len && ok; ++i) {
+		pixman_box32_t *rect = &rects[i];
+		ok = wlr_renderer_read_pixels(renderer, drm_format, flags, stride,
+			rect->x2 - rect->x1, rect->y2 - rect->y1, rect->x1, rect->y1,
+			rect->x1 - box->x, rect->y1 - box->y, data);
+	}
+	return ok;
+}
+
+static void frame_finish_shm_copy(struct wlr_screencopy_frame_v1 *frame,
+		bool ok, uint32_t renderer_flags) {
+	struct screencopy_damage *damage = NULL;
+	if (frame->with_damage) {
+		damage = screencopy_damage_find(frame->client, frame->output);
+	}
+	if (damage != NULL) {
+		// On failure, the buffer contents are undefined and the damage
+		// still needs to be reported by the next frame
+		screencopy_damage_set_last_buffer(damage,
+			ok ? frame->buffer_resource : NULL, &frame->box);
+		if (!ok) {
+			pixman_region32_union(&damage->damage, &damage->damage,
+				&frame->readback_damage);
+		}
+	}
+
+	if (!ok) {
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+		frame_destroy(frame);
+		return;
+	}
+
+	uint32_t flags = renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT ?
+		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
+	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
+	if (damage != NULL) {
+		frame_send_damage_region(frame, &frame->readback_damage);
+	}
+	frame_send_ready(frame, &frame->readback_when);
+	frame_destroy(frame);
+}
+
+static void frame_handle_readback_done(const void *data, uint32_t src_stride,
+		uint32_t renderer_flags, void *user_data) {
+	struct wlr_screencopy_frame_v1 *frame = user_data;
+	frame->readback = NULL;
+
+	if (data == NULL) {
+		frame_finish_shm_copy(frame, false, 0);
+		return;
+	}
+
+	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
+	struct wlr_box *box = &frame->box;
+	pixman_box32_t *extents = pixman_region32_extents(&frame->readback_region);
+	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
+	int bytes_per_pixel = src_stride / (extents->x2 - extents->x1);
+
+	wl_shm_buffer_begin_access(shm_buffer);
+	unsigned char *dst = wl_shm_buffer_get_data(shm_buffer);
+	const unsigned char *src = data;
+	int rects_len;
+	pixman_box32_t *rects =
+		pixman_region32_rectangles(&frame->readback_region, &rects_len);
+	for (int i = 0; i < rects_len; ++i) {
+		pixman_box32_t *rect = &rects[i];
+		size_t len = (rect->x2 - rect->x1) * bytes_per_pixel;
+		for (int y = rect->y1; y < rect->y2; ++y) {
+			memcpy(dst + (y - box->y) * stride +
+					(rect->x1 - box->x) * bytes_per_pixel,
+				src + (y - extents->y1) * src_stride +
+					(rect->x1 - extents->x1) * bytes_per_pixel,
+				len);
+		}
+	}
+	wl_shm_buffer_end_access(shm_buffer);
+
+	frame_finish_shm_copy(frame, true, renderer_flags);
+}
+
 static void frame_handle_output_precommit(struct wl_listener *listener,
 		void *_data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -216,9 +356,9 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 		return;
 	}
 
+	struct screencopy_damage *damage = NULL;
 	if (frame->with_damage) {
-		struct screencopy_damage *damage =
-			screencopy_damage_get_or_create(frame->client, output);
+		damage = screencopy_damage_get_or_create(frame->client, output);
 		if (damage) {
 			screencopy_damage_accumulate(damage);
 			if (!pixman_region32_not_empty(&damage->damage)) {
@@ -230,34 +370,55 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 	wl_list_remove(&frame->output_precommit.link);
 	wl_list_init(&frame->output_precommit.link);
 
-	int x = frame->box.x;
-	int y = frame->box.y;
-
+	struct wlr_box *box = &frame->box;
 	enum wl_shm_format wl_shm_format = wl_shm_buffer_get_format(shm_buffer);
 	uint32_t drm_format = convert_wl_shm_format_to_drm(wl_shm_format);
-	int32_t width = wl_shm_buffer_get_width(shm_buffer);
-	int32_t height = wl_shm_buffer_get_height(shm_buffer);
 	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
 
+	// If the client hands back the buffer it received the previous frame in,
+	// the undamaged part of it is still valid
+	bool partial = damage != NULL &&
+		damage->last_buffer == frame->buffer_resource &&
+		memcmp(&damage->last_box, box, sizeof(struct wlr_box)) == 0;
+	if (partial) {
+		pixman_region32_intersect_rect(&frame->readback_region,
+			&damage->damage, box->x, box->y, box->width, box->height);
+	} else {
+		pixman_region32_union_rect(&frame->readback_region,
+			&frame->readback_region, box->x, box->y, box->width, box->height);
+	}
+	frame->readback_when = *event->when;
+
+	// The damage accumulated so far is what this frame is made of, later
+	// commits accumulate damage for the next frame
+	if (damage != NULL) {
+		pixman_region32_copy(&frame->readback_damage, &damage->damage);
+		pixman_region32_clear(&damage->damage);
+	}
+
+	if (pixman_region32_not_empty(&frame->readback_region)) {
+		pixman_box32_t *extents =
+			pixman_region32_extents(&frame->readback_region);
+		frame->readback = wlr_renderer_read_pixels_async(renderer, drm_format,
+			extents->x2 - extents->x1, extents->y2 - extents->y1,
+			extents->x1, extents->y1, frame_handle_readback_done, frame);
+		if (frame->readback != NULL) {
+			if (damage != NULL) {
+				// Until the copy completes, the buffer contents are stale
+				screencopy_damage_set_last_buffer(damage, NULL, NULL);
+			}
+			return;
+		}
+	}
+
 	wl_shm_buffer_begin_access(shm_buffer);
 	void *data = wl_shm_buffer_get_data(shm_buffer);
 	uint32_t renderer_flags = 0;
-	bool ok = wlr_renderer_read_pixels(renderer, drm_format, &renderer_flags,
-		stride, width, height, x, y, 0, 0, data);
-	uint32_t flags = renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT ?
-		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
+	bool ok = frame_read_pixels(frame, renderer, drm_format, &renderer_flags,
+		stride, data);
 	wl_shm_buffer_end_access(shm_buffer);
 
-	if (!ok) {
-		zwlr_screencopy_frame_v1_send_failed(frame->resource);
-		frame_destroy(frame);
-		return;
-	}
-
-	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
-	frame_send_damage(frame);
-	frame_send_ready(frame, event->when);
-	frame_destroy(frame);
+	frame_finish_shm_copy(frame, ok, renderer_flags);
 }
 
 static void frame_handle_output_commit(struct wl_listener *listener,
@@ -289,19 +450,12 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 	wl_list_remove(&frame->output_commit.link);
 	wl_list_init(&frame->output_commit.link);
 
-	// TODO: add support for copying regions with DMA-BUFs
-	if (frame->box.x != 0 || frame->box.y != 0 ||
-			output->width != frame->box.width ||
-			output->height != frame->box.height) {
-		zwlr_screencopy_frame_v1_send_failed(frame->resource);
-		frame_destroy(frame);
-		return;
-	}
-
+	// frame->box is already in buffer-local coordinates, with the output
+	// transform and scale applied
 	struct wlr_dmabuf_attributes attr = { 0 };
 	bool ok = wlr_output_export_dmabuf(output, &attr);
-	ok = ok && wlr_renderer_blit_dmabuf(renderer,
-		&dma_buffer->attributes, &attr);
+	ok = ok && wlr_renderer_blit_dmabuf_region(renderer,
+		&dma_buffer->attributes, &attr, &frame->box);
 	uint32_t flags = dma_buffer->attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT ?
 		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
 	wlr_dmabuf_attributes_finish(&attr);
@@ -430,6 +584,7 @@ static void frame_handle_copy(struct wl_client *wl_client,
 		return;
 	}
 
+	frame->buffer_resource = buffer_resource;
 	frame->shm_buffer = shm_buffer;
 	frame->dma_buffer = dma_buffer;
 
@@ -545,6 +700,8 @@ static void capture_output(struct wl_client *wl_client,
 	wl_list_init(&frame->output_enable.link);
 	wl_list_init(&frame->output_destroy.link);
 	wl_list_init(&frame->buffer_destroy.link);
+	pixman_region32_init(&frame->readback_region);
+	pixman_region32_init(&frame->readback_damage);
 
 	if (output == NULL || !output->enabled) {
 		goto error;
@@ -1,9 +1,15 @@
+#define _POSIX_C_SOURCE 200809L
 #include <assert.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wlr/render/interface.h>
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_compositor.h>
+#include <wlr/types/wlr_linux_dmabuf_v1.h>
+#include <wlr/types/wlr_linux_explicit_synchronization_v1.h>
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/types/wlr_region.h>
 #include <wlr/types/wlr_surface.h>
@@ -410,6 +416,8 @@ static void surface_commit_pending(struct wlr_surface *surface) {
 		surface->role->precommit(surface);
 	}
 
+	wlr_signal_emit_safe(&surface->events.precommit, surface);
+
 	bool invalid_buffer = surface->pending.committed & WLR_SURFACE_STATE_BUFFER;
 
 	surface->sx += surface->pending.dx;
@@ -508,10 +516,7 @@ static void subsurface_commit(struct wlr_subsurface *subsurface) {
 	}
 }
 
-static void surface_commit(struct wl_client *client,
-		struct wl_resource *resource) {
-	struct wlr_surface *surface = wlr_surface_from_resource(resource);
-
+static void surface_commit_state(struct wlr_surface *surface) {
 	struct wlr_subsurface *subsurface = wlr_surface_is_subsurface(surface) ?
 		wlr_subsurface_from_wlr_surface(surface) : NULL;
 	if (subsurface != NULL) {
@@ -525,6 +530,179 @@ static void surface_commit(struct wl_client *client,
 	}
 }
 
+/**
+ * Returns a plane FD of the buffer which still has GPU work pending on it,
+ * or -1 if the buffer can be sampled without stalling. Only dmabufs carry
+ * implicit fences: a dmabuf FD becomes readable once all writes are done.
+ */
+static int buffer_get_busy_fd(struct wl_resource *buffer_resource) {
+	if (buffer_resource == NULL ||
+			!wlr_dmabuf_v1_resource_is_buffer(buffer_resource)) {
+		return -1;
+	}
+	struct wlr_dmabuf_v1_buffer *dmabuf =
+		wlr_dmabuf_v1_buffer_from_buffer_resource(buffer_resource);
+	for (int i = 0; i < dmabuf->attributes.n_planes; i++) {
+		struct pollfd pfd = {
+			.fd = dmabuf->attributes.fd[i],
+			.events = POLLIN,
+		};
+		if (poll(&pfd, 1, 0) == 0) {
+			return pfd.fd;
+		}
+	}
+	return -1;
+}
+
+static void surface_state_init(struct wlr_surface_state *state);
+static void surface_state_finish(struct wlr_surface_state *state);
+
+static void surface_remove_held_source(struct wlr_surface *surface) {
+	if (surface->held_source == NULL) {
+		return;
+	}
+	wl_event_source_remove(surface->held_source);
+	close(surface->held_fd);
+	surface->held_source = NULL;
+	surface->held_fd = -1;
+}
+
+static void surface_apply_held(struct wlr_surface *surface) {
+	surface_remove_held_source(surface);
+
+	// Put the held commit in place of the pending state, without losing
+	// what the client has already sent for its next commit
+	struct wlr_surface_state next;
+	surface_state_init(&next);
+	surface_state_move(&next, &surface->pending);
+	surface_state_move(&surface->pending, &surface->held);
+
+	surface_commit_state(surface);
+
+	surface_state_move(&surface->pending, &next);
+	surface_state_finish(&next);
+}
+
+static int surface_handle_held_ready(int fd, uint32_t mask, void *data);
+
+/**
+ * Hold the commit in surface->held until its buffer is ready. Returns false
+ * if the buffer is already ready and the commit can be applied right away.
+ */
+static bool surface_arm_held(struct wlr_surface *surface) {
+	surface_remove_held_source(surface);
+
+	int busy_fd = buffer_get_busy_fd(surface->held.buffer_resource);
+	if (busy_fd < 0) {
+		return false;
+	}
+
+	// Poll a duplicate: the dmabuf closes its FDs when the client destroys
+	// the wl_buffer, which may happen while the commit is held
+	int fd = fcntl(busy_fd, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "fcntl(F_DUPFD_CLOEXEC) failed");
+		return false;
+	}
+
+	struct wl_display *display =
+		wl_client_get_display(wl_resource_get_client(surface->resource));
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	surface->held_source = wl_event_loop_add_fd(loop, fd, WL_EVENT_READABLE,
+		surface_handle_held_ready, surface);
+	if (surface->held_source == NULL) {
+		wlr_log(WLR_ERROR, "Failed to add held buffer FD to event loop");
+		close(fd);
+		return false;
+	}
+	surface->held_fd = fd;
+	return true;
+}
+
+static int surface_handle_held_ready(int fd, uint32_t mask, void *data) {
+	struct wlr_surface *surface = data;
+	// Another plane may still be busy
+	if (!surface_arm_held(surface)) {
+		surface_apply_held(surface);
+	}
+	return 0;
+}
+
+void wlr_surface_apply_held_commit(struct wlr_surface *surface) {
+	if (surface->held_source != NULL) {
+		surface_apply_held(surface);
+	}
+}
+
+/**
+ * Squash the pending state on top of the held commit. The held buffer is
+ * dropped if the client attached a new one: it has never been used, so it
+ * can be released right away. Buffer offsets are relative to the previous
+ * commit, so they add up.
+ */
+static void surface_merge_held(struct wlr_surface *surface) {
+	struct wlr_surface_state *held = &surface->held;
+	struct wlr_surface_state *pending = &surface->pending;
+
+	if ((pending->committed & WLR_SURFACE_STATE_BUFFER) &&
+			held->buffer_resource != NULL &&
+			held->buffer_resource != pending->buffer_resource) {
+		wl_buffer_send_release(held->buffer_resource);
+	}
+
+	// Damage accumulates across the squashed commits
+	if (held->committed & WLR_SURFACE_STATE_SURFACE_DAMAGE) {
+		pixman_region32_union(&pending->surface_damage,
+			&pending->surface_damage, &held->surface_damage);
+		pending->committed |= WLR_SURFACE_STATE_SURFACE_DAMAGE;
+	}
+	if (held->committed & WLR_SURFACE_STATE_BUFFER_DAMAGE) {
+		pixman_region32_union(&pending->buffer_damage,
+			&pending->buffer_damage, &held->buffer_damage);
+		pending->committed |= WLR_SURFACE_STATE_BUFFER_DAMAGE;
+	}
+
+	int32_t dx = held->dx + pending->dx;
+	int32_t dy = held->dy + pending->dy;
+	surface_state_move(held, pending);
+	held->dx = dx;
+	held->dy = dy;
+}
+
+static void surface_commit(struct wl_client *client,
+		struct wl_resource *resource) {
+	struct wlr_surface *surface = wlr_surface_from_resource(resource);
+
+	// Commits must be applied in order: if one is already waiting for its
+	// buffer, this one waits with it and the newest buffer wins
+	if (surface->held_source != NULL) {
+		surface_merge_held(surface);
+		if (!surface_arm_held(surface)) {
+			surface_apply_held(surface);
+		}
+		return;
+	}
+
+	// Don't apply a commit whose buffer is still being rendered to by the
+	// GPU: sampling it would stall the compositor's next output frame. The
+	// previous buffer stays on screen until the new one is ready.
+	// Only roles which keep their own state in order allow this, and
+	// clients using explicit synchronization hand out an acquire fence
+	// which the renderer waits on instead.
+	if (surface->role != NULL && surface->role->hold_commits &&
+			wlr_linux_surface_synchronization_v1_from_surface(surface) == NULL &&
+			(surface->pending.committed & WLR_SURFACE_STATE_BUFFER) &&
+			buffer_get_busy_fd(surface->pending.buffer_resource) >= 0) {
+		surface_state_move(&surface->held, &surface->pending);
+		if (surface_arm_held(surface)) {
+			return;
+		}
+		surface_state_move(&surface->pending, &surface->held);
+	}
+
+	surface_commit_state(surface);
+}
+
 static void surface_set_buffer_transform(struct wl_client *client,
 		struct wl_resource *resource, int32_t transform) {
 	if (transform < WL_OUTPUT_TRANSFORM_NORMAL ||
@@ -647,6 +825,18 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 		surface_output_destroy(surface_output);
 	}
 
+	// A held commit is dropped along with the surface, roles can't apply it
+	// while being destroyed. Its buffer will never be used, hand it back to
+	// the client unless it's also the one currently displayed.
+	if (surface->held_source != NULL) {
+		struct wl_resource *held_buffer = surface->held.buffer_resource;
+		if (held_buffer != NULL && (surface->buffer == NULL ||
+				surface->buffer->resource != held_buffer)) {
+			wl_buffer_send_release(held_buffer);
+		}
+		surface_remove_held_source(surface);
+	}
+
 	wlr_signal_emit_safe(&surface->events.destroy, surface);
 
 	wl_list_remove(wl_resource_get_link(surface->resource));
@@ -655,6 +845,7 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	surface_state_finish(&surface->pending);
 	surface_state_finish(&surface->current);
 	surface_state_finish(&surface->previous);
+	surface_state_finish(&surface->held);
 	pixman_region32_fini(&surface->buffer_damage);
 	pixman_region32_fini(&surface->opaque_region);
 	pixman_region32_fini(&surface->input_region);
@@ -698,7 +889,10 @@ struct wlr_surface *wlr_surface_create(struct wl_client *client,
 	surface_state_init(&surface->current);
 	surface_state_init(&surface->pending);
 	surface_state_init(&surface->previous);
+	surface_state_init(&surface->held);
+	surface->held_fd = -1;
 
+	wl_signal_init(&surface->events.precommit);
 	wl_signal_init(&surface->events.commit);
 	wl_signal_init(&surface->events.destroy);
 	wl_signal_init(&surface->events.new_subsurface);
@@ -107,6 +107,8 @@ static void xdg_surface_handle_ack_configure(struct wl_client *client,
 		return;
 	}
 
+	wlr_surface_apply_held_commit(surface->surface);
+
 	// First find the ack'ed configure
 	bool found = false;
 	struct wlr_xdg_surface_configure *configure, *tmp;
@@ -285,6 +287,7 @@ static void xdg_surface_handle_set_window_geometry(struct wl_client *client,
 		return;
 	}
 
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->has_next_geometry = true;
 	surface->next_geometry.height = height;
 	surface->next_geometry.width = width;
@@ -474,6 +477,8 @@ struct wlr_xdg_surface *create_xdg_surface(
 
 void reset_xdg_surface(struct wlr_xdg_surface *xdg_surface) {
 	if (xdg_surface->role != WLR_XDG_SURFACE_ROLE_NONE) {
+		// The held commit belongs to the role object being destroyed
+		wlr_surface_apply_held_commit(xdg_surface->surface);
 		unmap_xdg_surface(xdg_surface);
 	}
 
@@ -359,6 +359,7 @@ static void xdg_toplevel_handle_set_max_size(struct wl_client *client,
 		struct wl_resource *resource, int32_t width, int32_t height) {
 	struct wlr_xdg_surface *surface =
 		wlr_xdg_surface_from_toplevel_resource(resource);
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->toplevel->client_pending.max_width = width;
 	surface->toplevel->client_pending.max_height = height;
 }
@@ -367,6 +368,7 @@ static void xdg_toplevel_handle_set_min_size(struct wl_client *client,
 		struct wl_resource *resource, int32_t width, int32_t height) {
 	struct wlr_xdg_surface *surface =
 		wlr_xdg_surface_from_toplevel_resource(resource);
+	wlr_surface_apply_held_commit(surface->surface);
 	surface->toplevel->client_pending.min_width = width;
 	surface->toplevel->client_pending.min_height = height;
 }
@@ -487,6 +489,7 @@ const struct wlr_surface_role xdg_toplevel_surface_role = {
 	.name = "xdg_toplevel",
 	.commit = handle_xdg_surface_commit,
 	.precommit = handle_xdg_surface_precommit,
+	.hold_commits = true,
 };
 
 void create_xdg_toplevel(struct wlr_xdg_surface *xdg_surface,
@@ -1,6 +1,7 @@
-#define _POSIX_C_SOURCE 200112L
+#define _GNU_SOURCE
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <time.h>
@@ -53,3 +54,64 @@ int allocate_shm_file(size_t size) {
 
 	return fd;
 }
+
+static bool write_all(int fd, const void *data, size_t size) {
+	const char *p = data;
+	while (size > 0) {
+		ssize_t n = write(fd, p, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+		p += n;
+		size -= n;
+	}
+	return true;
+}
+
+int create_readonly_shm_file(const void *data, size_t size) {
+#if HAS_MEMFD_CREATE
+	int fd = memfd_create("wlroots-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd >= 0) {
+		// Seal the file so that it can safely be handed out to any number of
+		// clients: none of them can modify the contents seen by the others
+		if (!write_all(fd, data, size) || fcntl(fd, F_ADD_SEALS,
+				F_SEAL_SEAL | F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) < 0) {
+			close(fd);
+			return -1;
+		}
+		return fd;
+	}
+	// Fall back to shm_open, e.g. if the kernel lacks memfd support
+#endif
+
+	int retries = 100;
+	do {
+		char name[] = "/wlroots-XXXXXX";
+		randname(name + strlen(name) - 6);
+
+		--retries;
+		int rw_fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (rw_fd < 0) {
+			continue;
+		}
+
+		// The read-only FD needs to be opened before the name is unlinked
+		int ro_fd = shm_open(name, O_RDONLY, 0);
+		shm_unlink(name);
+		if (ro_fd < 0 || !write_all(rw_fd, data, size)) {
+			if (ro_fd >= 0) {
+				close(ro_fd);
+			}
+			close(rw_fd);
+			return -1;
+		}
+
+		close(rw_fd);
+		return ro_fd;
+	} while (retries > 0 && errno == EEXIST);
+
+	return -1;
+}
@@ -25,6 +25,7 @@
 
 #define _POSIX_C_SOURCE 200809L
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -126,25 +127,54 @@ static void load_default_theme(struct wlr_xcursor_theme *theme) {
 	theme->cursor_count = i;
 }
 
-static struct wlr_xcursor *xcursor_create_from_xcursor_images(
-		XcursorImages *images, struct wlr_xcursor_theme *theme) {
-	struct wlr_xcursor *cursor;
+/**
+ * Decoded images are shared by all themes loading the same file at the same
+ * size, e.g. by several cursor managers, by scales picking the same images or
+ * by cursor names which are symlinks to the same file.
+ */
+struct xcursor_shared {
+	struct xcursor_file_id id;
+	struct wlr_xcursor_image **images;
+	unsigned int image_count;
+	uint32_t total_delay;
+	int refs;
+	struct xcursor_shared *next;
+};
+
+static struct xcursor_shared *shared_cursors = NULL;
+
+/**
+ * A cursor of a theme, named after the name it was looked up with.
+ */
+struct xcursor_named {
+	struct wlr_xcursor base;
+	struct xcursor_shared *shared;
+};
+
+struct xcursor_theme {
+	struct wlr_xcursor_theme base;
+	bool builtin; // the cursors are owned by the theme
+
+	// Names of cursors the theme doesn't provide
+	char **missing;
+	size_t missing_len;
+};
+
+static struct xcursor_theme *xcursor_theme_from_base(
+		struct wlr_xcursor_theme *theme) {
+	return (struct xcursor_theme *)theme;
+}
+
+static bool xcursor_shared_init_images(struct xcursor_shared *shared,
+		XcursorImages *images) {
 	struct wlr_xcursor_image *image;
 	int i, size;
 
-	cursor = malloc(sizeof(*cursor));
-	if (!cursor) {
-		return NULL;
-	}
-
-	cursor->images = malloc(images->nimage * sizeof(cursor->images[0]));
-	if (!cursor->images) {
-		free(cursor);
-		return NULL;
+	shared->images = malloc(images->nimage * sizeof(shared->images[0]));
+	if (!shared->images) {
+		return false;
 	}
-
-	cursor->name = strdup(images->name);
-	cursor->total_delay = 0;
+	shared->total_delay = 0;
 
 	for (i = 0; i < images->nimage; i++) {
 		image = malloc(sizeof(*image));
@@ -169,55 +199,236 @@ static struct wlr_xcursor *xcursor_create_from_xcursor_images(
 
 		/* copy pixels to shm pool */
 		memcpy(image->buffer, images->images[i]->pixels, size);
-		cursor->total_delay += image->delay;
-		cursor->images[i] = image;
+		shared->total_delay += image->delay;
+		shared->images[i] = image;
 	}
-	cursor->image_count = i;
+	shared->image_count = i;
 
-	if (cursor->image_count == 0) {
-		free(cursor->name);
-		free(cursor->images);
-		free(cursor);
-		return NULL;
+	if (shared->image_count == 0) {
+		free(shared->images);
+		return false;
 	}
 
-	return cursor;
+	return true;
 }
 
-static void load_callback(XcursorImages *images, void *data) {
-	struct wlr_xcursor_theme *theme = data;
-	struct wlr_xcursor *cursor;
-
-	if (wlr_xcursor_theme_get_cursor(theme, images->name)) {
-		XcursorImagesDestroy(images);
+static void xcursor_shared_unref(struct xcursor_shared *shared) {
+	if (--shared->refs > 0) {
 		return;
 	}
 
-	cursor = xcursor_create_from_xcursor_images(images, theme);
+	struct xcursor_shared **link = &shared_cursors;
+	while (*link != shared) {
+		link = &(*link)->next;
+	}
+	*link = shared->next;
 
-	if (cursor) {
-		struct wlr_xcursor **cursors;
-		theme->cursor_count++;
-		cursors =
-			realloc(theme->cursors,
-				theme->cursor_count * sizeof(theme->cursors[0]));
+	for (size_t i = 0; i < shared->image_count; i++) {
+		free(shared->images[i]->buffer);
+		free(shared->images[i]);
+	}
+	free(shared->images);
+	free(shared);
+}
 
-		if (cursors == NULL) {
-			theme->cursor_count--;
-			free(cursor);
-		} else {
-			theme->cursors = cursors;
-			theme->cursors[theme->cursor_count - 1] = cursor;
+static struct xcursor_shared *xcursor_shared_lookup(
+		const struct xcursor_file_id *id) {
+	for (struct xcursor_shared *shared = shared_cursors; shared != NULL;
+			shared = shared->next) {
+		if (shared->id.dev == id->dev && shared->id.ino == id->ino &&
+				shared->id.size == id->size) {
+			return shared;
 		}
 	}
+	return NULL;
+}
 
+static struct xcursor_shared *xcursor_shared_find(
+		const struct xcursor_file_id *id) {
+	struct xcursor_shared *shared = xcursor_shared_lookup(id);
+	if (shared != NULL) {
+		shared->refs++;
+	}
+	return shared;
+}
+
+static struct xcursor_shared *xcursor_shared_create(
+		const struct xcursor_file_id *id, XcursorImages *images) {
+	struct xcursor_shared *shared = calloc(1, sizeof(*shared));
+	if (shared == NULL) {
+		return NULL;
+	}
+	if (!xcursor_shared_init_images(shared, images)) {
+		free(shared);
+		return NULL;
+	}
+
+	shared->id = *id;
+	shared->refs = 1;
+	shared->next = shared_cursors;
+	shared_cursors = shared;
+	return shared;
+}
+
+static struct xcursor_shared *xcursor_load_shared(const char *path, int size) {
+	struct xcursor_file *file = xcursor_file_open(path);
+	if (file == NULL) {
+		return NULL;
+	}
+
+	// Only the table of contents has been read so far
+	struct xcursor_file_id id;
+	xcursor_file_get_id(file, size, &id);
+	struct xcursor_shared *shared = xcursor_shared_find(&id);
+	if (shared != NULL) {
+		xcursor_file_close(file);
+		return shared;
+	}
+
+	XcursorImages *images = xcursor_file_load_images(file, size);
+	xcursor_file_close(file);
+	if (images == NULL) {
+		return NULL;
+	}
+
+	shared = xcursor_shared_create(&id, images);
 	XcursorImagesDestroy(images);
+	return shared;
 }
 
-struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
-	struct wlr_xcursor_theme *theme;
+static void xcursor_named_destroy(struct wlr_xcursor *cursor) {
+	struct xcursor_named *named = (struct xcursor_named *)cursor;
+	xcursor_shared_unref(named->shared);
+	free(named->base.name);
+	free(named);
+}
 
-	theme = malloc(sizeof(*theme));
+/**
+ * Add a cursor to the theme, taking over the reference to the shared images.
+ */
+static struct wlr_xcursor *theme_add_cursor(struct xcursor_theme *theme,
+		const char *name, struct xcursor_shared *shared) {
+	struct xcursor_named *named = calloc(1, sizeof(*named));
+	if (named == NULL) {
+		goto error_shared;
+	}
+	named->base.name = strdup(name);
+	if (named->base.name == NULL) {
+		goto error_named;
+	}
+	named->base.images = shared->images;
+	named->base.image_count = shared->image_count;
+	named->base.total_delay = shared->total_delay;
+	named->shared = shared;
+
+	struct wlr_xcursor **cursors = realloc(theme->base.cursors,
+		(theme->base.cursor_count + 1) * sizeof(theme->base.cursors[0]));
+	if (cursors == NULL) {
+		goto error_name;
+	}
+	theme->base.cursors = cursors;
+	theme->base.cursors[theme->base.cursor_count++] = &named->base;
+
+	struct wlr_xcursor_image *image = shared->images[0];
+	wlr_log(WLR_DEBUG, "Loaded cursor %s from theme '%s' (%u images) "
+		"%" PRIu32 "x%" PRIu32 "+%" PRIu32 ",%" PRIu32,
+		name, theme->base.name, shared->image_count,
+		image->width, image->height, image->hotspot_x, image->hotspot_y);
+	return &named->base;
+
+error_name:
+	free(named->base.name);
+error_named:
+	free(named);
+error_shared:
+	xcursor_shared_unref(shared);
+	return NULL;
+}
+
+static struct wlr_xcursor *theme_find_cursor(struct xcursor_theme *theme,
+		const char *name) {
+	for (unsigned int i = 0; i < theme->base.cursor_count; i++) {
+		if (strcmp(name, theme->base.cursors[i]->name) == 0) {
+			return theme->base.cursors[i];
+		}
+	}
+	return NULL;
+}
+
+static struct wlr_xcursor *theme_load_cursor(struct xcursor_theme *theme,
+		const char *name) {
+	char *path = XcursorLibraryFindFile(name, theme->base.name);
+	if (path == NULL) {
+		return NULL;
+	}
+	struct xcursor_shared *shared =
+		xcursor_load_shared(path, theme->base.size);
+	free(path);
+	if (shared == NULL) {
+		return NULL;
+	}
+	return theme_add_cursor(theme, name, shared);
+}
+
+static bool theme_is_missing(struct xcursor_theme *theme, const char *name) {
+	for (size_t i = 0; i < theme->missing_len; i++) {
+		if (strcmp(theme->missing[i], name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void theme_add_missing(struct xcursor_theme *theme, const char *name) {
+	char **missing = realloc(theme->missing,
+		(theme->missing_len + 1) * sizeof(theme->missing[0]));
+	if (missing == NULL) {
+		return;
+	}
+	theme->missing = missing;
+	char *dup = strdup(name);
+	if (dup != NULL) {
+		theme->missing[theme->missing_len++] = dup;
+	}
+}
+
+static bool preload_want_cursor(const char *name, void *data) {
+	struct xcursor_theme *theme = data;
+	return theme_find_cursor(theme, name) == NULL &&
+		!theme_is_missing(theme, name);
+}
+
+static bool preload_want_images(const struct xcursor_file_id *id,
+		void *data) {
+	return xcursor_shared_lookup(id) == NULL;
+}
+
+static void preload_load(const char *name, XcursorImages *images,
+		const struct xcursor_file_id *id, void *data) {
+	struct xcursor_theme *theme = data;
+
+	// Images aren't decoded again if they are in the cache already
+	struct xcursor_shared *shared = xcursor_shared_find(id);
+	if (shared == NULL && images != NULL) {
+		shared = xcursor_shared_create(id, images);
+	}
+	if (shared != NULL) {
+		theme_add_cursor(theme, name, shared);
+	}
+
+	if (images != NULL) {
+		XcursorImagesDestroy(images);
+	}
+}
+
+static const struct xcursor_load_callbacks preload_callbacks = {
+	.want_cursor = preload_want_cursor,
+	.want_images = preload_want_images,
+	.load = preload_load,
+};
+
+struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
+	struct xcursor_theme *theme = calloc(1, sizeof(*theme));
 	if (!theme) {
 		return NULL;
 	}
@@ -226,60 +437,75 @@ struct wlr_xcursor_theme *wlr_xcursor_theme_load(const char *name, int size) {
 		name = "default";
 	}
 
-	theme->name = strdup(name);
-	if (!theme->name) {
+	theme->base.name = strdup(name);
+	if (!theme->base.name) {
 		goto out_error_name;
 	}
-	theme->size = size;
-	theme->cursor_count = 0;
-	theme->cursors = NULL;
-
-	xcursor_load_theme(name, size, load_callback, theme);
-
-	if (theme->cursor_count == 0) {
-		load_default_theme(theme);
+	theme->base.size = size;
+	theme->base.cursor_count = 0;
+	theme->base.cursors = NULL;
+
+	// Cursors are loaded on first use, only check that there are some
+	if (!xcursor_theme_has_cursors(name)) {
+		theme->builtin = true;
+		load_default_theme(&theme->base);
 	}
 
-	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s', available cursors:",
-			theme->name);
-	for (size_t i = 0; i < theme->cursor_count; ++i) {
-		struct wlr_xcursor *c = theme->cursors[i];
-		struct wlr_xcursor_image *i = c->images[0];
-		wlr_log(WLR_DEBUG, "%s (%u images) %" PRIu32 "x%" PRIu32 "+%" PRIu32 ",%" PRIu32,
-				c->name, c->image_count,
-				i->width, i->height, i->hotspot_x, i->hotspot_y);
-	}
+	wlr_log(WLR_DEBUG, "Loaded cursor theme '%s'%s", theme->base.name,
+		theme->builtin ? " (built-in)" : "");
 
-	return theme;
+	return &theme->base;
 
 out_error_name:
 	free(theme);
 	return NULL;
 }
 
-void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *theme) {
-	unsigned int i;
+void wlr_xcursor_theme_destroy(struct wlr_xcursor_theme *wlr_theme) {
+	struct xcursor_theme *theme = xcursor_theme_from_base(wlr_theme);
 
-	for (i = 0; i < theme->cursor_count; i++) {
-		xcursor_destroy(theme->cursors[i]);
+	for (unsigned int i = 0; i < theme->base.cursor_count; i++) {
+		if (theme->builtin) {
+			xcursor_destroy(theme->base.cursors[i]);
+		} else {
+			xcursor_named_destroy(theme->base.cursors[i]);
+		}
+	}
+	for (size_t i = 0; i < theme->missing_len; i++) {
+		free(theme->missing[i]);
 	}
 
-	free(theme->name);
-	free(theme->cursors);
+	free(theme->missing);
+	free(theme->base.name);
+	free(theme->base.cursors);
 	free(theme);
 }
 
-struct wlr_xcursor *wlr_xcursor_theme_get_cursor(struct wlr_xcursor_theme *theme,
-		const char *name) {
-	unsigned int i;
+struct wlr_xcursor *wlr_xcursor_theme_get_cursor(
+		struct wlr_xcursor_theme *wlr_theme, const char *name) {
+	struct xcursor_theme *theme = xcursor_theme_from_base(wlr_theme);
 
-	for (i = 0; i < theme->cursor_count; i++) {
-		if (strcmp(name, theme->cursors[i]->name) == 0) {
-			return theme->cursors[i];
-		}
+	struct wlr_xcursor *cursor = theme_find_cursor(theme, name);
+	if (cursor != NULL || theme->builtin || theme_is_missing(theme, name)) {
+		return cursor;
 	}
 
-	return NULL;
+	cursor = theme_load_cursor(theme, name);
+	if (cursor == NULL) {
+		// Don't look for it on disk again
+		theme_add_missing(theme, name);
+	}
+	return cursor;
+}
+
+void wlr_xcursor_theme_preload(struct wlr_xcursor_theme *wlr_theme) {
+	struct xcursor_theme *theme = xcursor_theme_from_base(wlr_theme);
+	if (theme->builtin) {
+		return;
+	}
+
+	xcursor_load_theme(theme->base.name, theme->base.size,
+		&preload_callbacks, theme);
 }
 
 static int xcursor_frame_and_duration(struct wlr_xcursor *cursor,
@@ -25,9 +25,14 @@
 
 #define _DEFAULT_SOURCE
 #include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "xcursor/xcursor.h"
 
 /*
@@ -507,47 +512,45 @@ _XcursorReadImage (XcursorFile		*file,
     image->xhot = head.xhot;
     image->yhot = head.yhot;
     image->delay = head.delay;
+    /* read all pixels at once, they are stored as little-endian CARD32s */
     n = image->width * image->height;
     p = image->pixels;
+    if ((*file->read) (file, (unsigned char *) p, n * 4) != n * 4)
+    {
+	XcursorImageDestroy (image);
+	return NULL;
+    }
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
     while (n--)
     {
-	if (!_XcursorReadUInt (file, p))
-	{
-	    XcursorImageDestroy (image);
-	    return NULL;
-	}
+	unsigned char *bytes = (unsigned char *) p;
+	*p = ((XcursorUInt)(bytes[0]) << 0) |
+	     ((XcursorUInt)(bytes[1]) << 8) |
+	     ((XcursorUInt)(bytes[2]) << 16) |
+	     ((XcursorUInt)(bytes[3]) << 24);
 	p++;
     }
+#endif
     return image;
 }
 
 static XcursorImages *
-XcursorXcFileLoadImages (XcursorFile *file, int size)
+_XcursorLoadImagesFromHeader (XcursorFile	*file,
+			      XcursorFileHeader	*fileHeader,
+			      int		size)
 {
-    XcursorFileHeader	*fileHeader;
     XcursorDim		bestSize;
     int			nsize;
     XcursorImages	*images;
     int			n;
     int			toc;
 
-    if (!file || size < 0)
-	return NULL;
-    fileHeader = _XcursorReadFileHeader (file);
-    if (!fileHeader)
-	return NULL;
     bestSize = _XcursorFindBestSize (fileHeader, (XcursorDim) size, &nsize);
     if (!bestSize)
-    {
-        _XcursorFileHeaderDestroy (fileHeader);
 	return NULL;
-    }
     images = XcursorImagesCreate (nsize);
     if (!images)
-    {
-        _XcursorFileHeaderDestroy (fileHeader);
 	return NULL;
-    }
     for (n = 0; n < nsize; n++)
     {
 	toc = _XcursorFindImageToc (fileHeader, bestSize, n);
@@ -559,7 +562,6 @@ XcursorXcFileLoadImages (XcursorFile *file, int size)
 	    break;
 	images->nimage++;
     }
-    _XcursorFileHeaderDestroy (fileHeader);
     if (images->nimage != nsize)
     {
 	XcursorImagesDestroy (images);
@@ -568,46 +570,134 @@ XcursorXcFileLoadImages (XcursorFile *file, int size)
     return images;
 }
 
+/*
+ * Cursor files mapped into memory, parsed without any further syscall
+ */
+
+struct xcursor_file {
+	const unsigned char *data;
+	size_t size;
+	size_t pos;
+	dev_t dev;
+	ino_t ino;
+	XcursorFile file;
+	XcursorFileHeader *header;
+};
+
 static int
-_XcursorStdioFileRead (XcursorFile *file, unsigned char *buf, int len)
+mapped_file_read(XcursorFile *file, unsigned char *buf, int len)
 {
-    FILE    *f = file->closure;
-    return fread (buf, 1, len, f);
+	struct xcursor_file *mapped = file->closure;
+	size_t avail = mapped->size - mapped->pos;
+	if (len < 0)
+		return 0;
+	if ((size_t)len > avail)
+		len = avail;
+	memcpy(buf, mapped->data + mapped->pos, len);
+	mapped->pos += len;
+	return len;
 }
 
 static int
-_XcursorStdioFileWrite (XcursorFile *file, unsigned char *buf, int len)
+mapped_file_write(XcursorFile *file, unsigned char *buf, int len)
 {
-    FILE    *f = file->closure;
-    return fwrite (buf, 1, len, f);
+	return 0;
 }
 
 static int
-_XcursorStdioFileSeek (XcursorFile *file, long offset, int whence)
+mapped_file_seek(XcursorFile *file, long offset, int whence)
 {
-    FILE    *f = file->closure;
-    return fseek (f, offset, whence);
+	struct xcursor_file *mapped = file->closure;
+	long base;
+
+	switch (whence) {
+	case SEEK_SET:
+		base = 0;
+		break;
+	case SEEK_CUR:
+		base = mapped->pos;
+		break;
+	case SEEK_END:
+		base = mapped->size;
+		break;
+	default:
+		return EOF;
+	}
+	if (offset < -base || (size_t)(base + offset) > mapped->size)
+		return EOF;
+	mapped->pos = base + offset;
+	return 0;
 }
 
-static void
-_XcursorStdioFileInitialize (FILE *stdfile, XcursorFile *file)
+struct xcursor_file *
+xcursor_file_open(const char *path)
+{
+	struct xcursor_file *mapped;
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return NULL;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return NULL;
+
+	mapped = calloc(1, sizeof(*mapped));
+	if (!mapped) {
+		munmap(data, st.st_size);
+		return NULL;
+	}
+	mapped->data = data;
+	mapped->size = st.st_size;
+	mapped->dev = st.st_dev;
+	mapped->ino = st.st_ino;
+	mapped->file.closure = mapped;
+	mapped->file.read = mapped_file_read;
+	mapped->file.write = mapped_file_write;
+	mapped->file.seek = mapped_file_seek;
+
+	mapped->header = _XcursorReadFileHeader(&mapped->file);
+	if (!mapped->header) {
+		xcursor_file_close(mapped);
+		return NULL;
+	}
+	return mapped;
+}
+
+void
+xcursor_file_close(struct xcursor_file *file)
 {
-    file->closure = stdfile;
-    file->read = _XcursorStdioFileRead;
-    file->write = _XcursorStdioFileWrite;
-    file->seek = _XcursorStdioFileSeek;
+	if (file->header)
+		_XcursorFileHeaderDestroy(file->header);
+	munmap((void *)file->data, file->size);
+	free(file);
 }
 
-static XcursorImages *
-XcursorFileLoadImages (FILE *file, int size)
+void
+xcursor_file_get_id(struct xcursor_file *file, int size,
+		    struct xcursor_file_id *id)
 {
-    XcursorFile	f;
+	int nsize;
 
-    if (!file)
-        return NULL;
+	id->dev = file->dev;
+	id->ino = file->ino;
+	id->size = size < 0 ? 0 :
+		_XcursorFindBestSize(file->header, (XcursorDim) size, &nsize);
+}
 
-    _XcursorStdioFileInitialize (file, &f);
-    return XcursorXcFileLoadImages (&f, size);
+XcursorImages *
+xcursor_file_load_images(struct xcursor_file *file, int size)
+{
+	if (size < 0)
+		return NULL;
+	return _XcursorLoadImagesFromHeader(&file->file, file->header, size);
 }
 
 /*
@@ -794,10 +884,10 @@ _XcursorThemeInherits (const char *full)
     return result;
 }
 
-static FILE *
+static char *
 XcursorScanTheme (const char *theme, const char *name)
 {
-    FILE	*f = NULL;
+    char	*f = NULL;
     char	*full;
     char	*dir;
     const char  *path;
@@ -820,8 +910,10 @@ XcursorScanTheme (const char *theme, const char *name)
 	    full = _XcursorBuildFullname (dir, "cursors", name);
 	    if (full)
 	    {
-		f = fopen (full, "r");
-		free (full);
+		if (access (full, R_OK) == 0)
+		    f = full;
+		else
+		    free (full);
 	    }
 	    if (!f && !inherits)
 	    {
@@ -850,120 +942,243 @@ XcursorScanTheme (const char *theme, const char *name)
     return f;
 }
 
-XcursorImages *
-XcursorLibraryLoadImages (const char *file, const char *theme, int size)
+char *
+XcursorLibraryFindFile (const char *file, const char *theme)
 {
-    FILE	    *f = NULL;
-    XcursorImages   *images = NULL;
+    char	    *f = NULL;
 
-    if (!file)
+    /* names are looked up in the themes' cursors directories */
+    if (!file || strchr (file, '/'))
         return NULL;
 
     if (theme)
 	f = XcursorScanTheme (theme, file);
     if (!f)
 	f = XcursorScanTheme ("default", file);
+    return f;
+}
+
+XcursorImages *
+XcursorLibraryLoadImages (const char *file, const char *theme, int size)
+{
+    char	    *full;
+    struct xcursor_file *f;
+    XcursorImages   *images = NULL;
+
+    full = XcursorLibraryFindFile (file, theme);
+    if (!full)
+	return NULL;
+    f = xcursor_file_open (full);
+    free (full);
     if (f)
     {
-	images = XcursorFileLoadImages (f, size);
+	images = xcursor_file_load_images (f, size);
 	if (images)
 	    XcursorImagesSetName (images, file);
-	fclose (f);
+	xcursor_file_close (f);
     }
     return images;
 }
 
-static void
-load_all_cursors_from_dir(const char *path, int size,
-			  void (*load_callback)(XcursorImages *, void *),
-			  void *user_data)
+static bool
+dir_has_cursors(const char *path)
 {
-	FILE *f;
 	DIR *dir = opendir(path);
 	struct dirent *ent;
-	char *full;
-	XcursorImages *images;
+	bool found = false;
 
 	if (!dir)
-		return;
+		return false;
 
-	for(ent = readdir(dir); ent; ent = readdir(dir)) {
+	for (ent = readdir(dir); ent && !found; ent = readdir(dir)) {
+		if (ent->d_name[0] == '.')
+			continue;
 #ifdef _DIRENT_HAVE_D_TYPE
 		if (ent->d_type != DT_UNKNOWN &&
 		    (ent->d_type != DT_REG && ent->d_type != DT_LNK))
 			continue;
 #endif
-
-		full = _XcursorBuildFullname(path, "", ent->d_name);
-		if (!full)
-			continue;
-
-		f = fopen(full, "r");
-		if (!f) {
-			free(full);
-			continue;
-		}
-
-		images = XcursorFileLoadImages(f, size);
-
-		if (images) {
-			XcursorImagesSetName(images, ent->d_name);
-			load_callback(images, user_data);
-		}
-
-		fclose (f);
-		free(full);
+		found = true;
 	}
 
 	closedir(dir);
+	return found;
 }
 
-/** Load all the cursor of a theme
+/** Check whether a theme provides any cursor
  *
- * This function loads all the cursor images of a given theme and its
- * inherited themes. Each cursor is loaded into an XcursorImages object
- * which is passed to the caller's load callback. If a cursor appears
- * more than once across all the inherited themes, the load callback
- * will be called multiple times, with possibly different XcursorImages
- * object which have the same name. The user is expected to destroy the
- * XcursorImages objects passed to the callback with
- * XcursorImagesDestroy().
+ * This function looks for cursor files in the directories of a given
+ * theme and its inherited themes, without loading any of them.
  *
- * \param theme The name of theme that should be loaded
- * \param size The desired size of the cursor images
- * \param load_callback A callback function that will be called
- * for each cursor loaded. The first parameter is the XcursorImages
- * object representing the loaded cursor and the second is a pointer
- * to data provided by the user.
- * \param user_data The data that should be passed to the load callback
+ * \param theme The name of theme that should be checked
  */
-void
-xcursor_load_theme(const char *theme, int size,
-		    void (*load_callback)(XcursorImages *, void *),
-		    void *user_data)
+bool
+xcursor_theme_has_cursors(const char *theme)
 {
 	char *full, *dir;
 	char *inherits = NULL;
 	const char *path, *i;
+	bool found = false;
 
 	if (!theme)
 		theme = "default";
 
 	for (path = XcursorLibraryPath();
-	     path;
+	     path && !found;
 	     path = _XcursorNextPath(path)) {
 		dir = _XcursorBuildThemeDir(path, theme);
 		if (!dir)
 			continue;
 
 		full = _XcursorBuildFullname(dir, "cursors", "");
-
 		if (full) {
-			load_all_cursors_from_dir(full, size, load_callback,
-						  user_data);
+			found = dir_has_cursors(full);
 			free(full);
 		}
 
+		if (!found && !inherits) {
+			full = _XcursorBuildFullname(dir, "", "index.theme");
+			if (full) {
+				inherits = _XcursorThemeInherits(full);
+				free(full);
+			}
+		}
+
+		free(dir);
+	}
+
+	for (i = inherits; i && !found; i = _XcursorNextPath(i)) {
+		if (strcmp(i, theme) != 0)
+			found = xcursor_theme_has_cursors(i);
+	}
+
+	if (inherits)
+		free(inherits);
+	return found;
+}
+
+/*
+ * Cursor files of a theme, decoded by a pool of worker threads
+ */
+
+#define LOAD_MAX_THREADS 8
+
+struct load_job {
+	char *path;
+	char *name;
+	struct xcursor_file *file;
+	struct xcursor_file_id id;
+	XcursorImages *images;
+	bool opened;
+	bool decode;
+	bool done;
+};
+
+struct load_queue {
+	struct load_job *jobs;
+	size_t len, cap;
+	int size;
+	void (*run)(struct load_job *job, int size);
+
+	pthread_mutex_t lock;
+	pthread_cond_t done_cond;
+	size_t next; // first job no one has picked up yet
+};
+
+static bool
+queue_has_name(struct load_queue *queue, const char *name)
+{
+	for (size_t i = 0; i < queue->len; i++) {
+		if (strcmp(queue->jobs[i].name, name) == 0)
+			return true;
+	}
+	return false;
+}
+
+/* Whether a job before the given one decodes the same images */
+static bool
+queue_has_decode(struct load_queue *queue, size_t end,
+		 const struct xcursor_file_id *id)
+{
+	for (size_t i = 0; i < end; i++) {
+		struct load_job *job = &queue->jobs[i];
+		if (job->decode && job->id.dev == id->dev &&
+		    job->id.ino == id->ino && job->id.size == id->size)
+			return true;
+	}
+	return false;
+}
+
+static void
+queue_add_dir(struct load_queue *queue, const char *theme_dir)
+{
+	char *path = _XcursorBuildFullname(theme_dir, "cursors", "");
+	DIR *dir;
+	struct dirent *ent;
+
+	if (!path)
+		return;
+	dir = opendir(path);
+	free(path);
+	if (!dir)
+		return;
+
+	for (ent = readdir(dir); ent; ent = readdir(dir)) {
+		struct load_job *job;
+
+		if (ent->d_name[0] == '.')
+			continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+		if (ent->d_type != DT_UNKNOWN &&
+		    (ent->d_type != DT_REG && ent->d_type != DT_LNK))
+			continue;
+#endif
+		// Earlier themes and search path entries take precedence
+		if (queue_has_name(queue, ent->d_name))
+			continue;
+
+		if (queue->len == queue->cap) {
+			size_t cap = queue->cap ? queue->cap * 2 : 64;
+			struct load_job *jobs =
+				realloc(queue->jobs, cap * sizeof(*jobs));
+			if (!jobs)
+				break;
+			queue->jobs = jobs;
+			queue->cap = cap;
+		}
+
+		job = &queue->jobs[queue->len];
+		*job = (struct load_job){0};
+		job->path = _XcursorBuildFullname(theme_dir, "cursors",
+						  ent->d_name);
+		job->name = strdup(ent->d_name);
+		if (!job->path || !job->name) {
+			free(job->path);
+			free(job->name);
+			continue;
+		}
+		queue->len++;
+	}
+
+	closedir(dir);
+}
+
+static void
+queue_add_theme(struct load_queue *queue, const char *theme)
+{
+	char *full, *dir;
+	char *inherits = NULL;
+	const char *path, *i;
+
+	for (path = XcursorLibraryPath();
+	     path;
+	     path = _XcursorNextPath(path)) {
+		dir = _XcursorBuildThemeDir(path, theme);
+		if (!dir)
+			continue;
+
+		queue_add_dir(queue, dir);
+
 		if (!inherits) {
 			full = _XcursorBuildFullname(dir, "", "index.theme");
 			if (full) {
@@ -975,9 +1190,203 @@ xcursor_load_theme(const char *theme, int size,
 		free(dir);
 	}
 
-	for (i = inherits; i; i = _XcursorNextPath(i))
-		xcursor_load_theme(i, size, load_callback, user_data);
+	for (i = inherits; i; i = _XcursorNextPath(i)) {
+		if (strcmp(i, theme) != 0)
+			queue_add_theme(queue, i);
+	}
 
 	if (inherits)
 		free(inherits);
 }
+
+static void
+load_job_open(struct load_job *job, int size)
+{
+	job->file = xcursor_file_open(job->path);
+	if (!job->file)
+		return;
+	xcursor_file_get_id(job->file, size, &job->id);
+	job->opened = true;
+}
+
+static void
+load_job_decode(struct load_job *job, int size)
+{
+	if (!job->file)
+		return;
+	if (job->decode) {
+		job->images = xcursor_file_load_images(job->file, size);
+		if (job->images)
+			XcursorImagesSetName(job->images, job->name);
+	}
+	xcursor_file_close(job->file);
+	job->file = NULL;
+}
+
+/* Must be called with the queue locked, returns with the queue locked */
+static void
+queue_run_next(struct load_queue *queue)
+{
+	struct load_job *job = &queue->jobs[queue->next++];
+
+	pthread_mutex_unlock(&queue->lock);
+	queue->run(job, queue->size);
+	pthread_mutex_lock(&queue->lock);
+
+	job->done = true;
+	pthread_cond_broadcast(&queue->done_cond);
+}
+
+static void *
+load_worker_run(void *data)
+{
+	struct load_queue *queue = data;
+
+	pthread_mutex_lock(&queue->lock);
+	while (queue->next < queue->len)
+		queue_run_next(queue);
+	pthread_mutex_unlock(&queue->lock);
+	return NULL;
+}
+
+static size_t
+load_thread_count(size_t njobs)
+{
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t n = ncpus > 0 ? (size_t)ncpus : 1;
+
+	if (n > LOAD_MAX_THREADS)
+		n = LOAD_MAX_THREADS;
+	// The calling thread decodes files as well
+	if (n > njobs)
+		n = njobs;
+	return n > 0 ? n - 1 : 0;
+}
+
+static size_t
+queue_start_workers(struct load_queue *queue, size_t njobs,
+		    pthread_t *threads)
+{
+	size_t n = load_thread_count(njobs), nthreads = 0;
+
+	for (size_t i = 0; i < n; i++) {
+		if (pthread_create(&threads[nthreads], NULL, load_worker_run,
+				   queue) != 0)
+			break;
+		nthreads++;
+	}
+	return nthreads;
+}
+
+/** Load all the cursor of a theme
+ *
+ * This function loads all the cursor images of a given theme and its
+ * inherited themes. Only the first file found for each cursor name is
+ * loaded, following the precedence of the search path and of inherited
+ * themes. The calling thread lists the cursor directories, then a pool
+ * of worker threads opens the files and reads their table of contents,
+ * and eventually decodes the images the caller still needs. All the
+ * callbacks are called on the calling thread, and the load callback is
+ * called in order of precedence. The user is expected to destroy the
+ * XcursorImages objects passed to the load callback with
+ * XcursorImagesDestroy().
+ *
+ * \param theme The name of theme that should be loaded
+ * \param size The desired size of the cursor images
+ * \param callbacks The callbacks filtering and receiving the cursors
+ * \param user_data The data that should be passed to the callbacks
+ */
+void
+xcursor_load_theme(const char *theme, int size,
+		    const struct xcursor_load_callbacks *callbacks,
+		    void *user_data)
+{
+	struct load_queue queue = { .size = size };
+	pthread_t threads[LOAD_MAX_THREADS];
+	size_t nthreads, ndecode = 0, len = 0, i;
+
+	if (!theme)
+		theme = "default";
+
+	queue_add_theme(&queue, theme);
+
+	// Names are only dropped now, so that they still hide the files of
+	// lower precedence
+	for (i = 0; i < queue.len; i++) {
+		struct load_job *job = &queue.jobs[i];
+		if (!callbacks->want_cursor(job->name, user_data)) {
+			free(job->path);
+			free(job->name);
+			continue;
+		}
+		queue.jobs[len++] = *job;
+	}
+	queue.len = len;
+	if (queue.len == 0) {
+		free(queue.jobs);
+		return;
+	}
+
+	pthread_mutex_init(&queue.lock, NULL);
+	pthread_cond_init(&queue.done_cond, NULL);
+
+	// Read the table of contents of all the files, to know which images
+	// each of them would be decoded to
+	queue.run = load_job_open;
+	nthreads = queue_start_workers(&queue, queue.len, threads);
+	pthread_mutex_lock(&queue.lock);
+	while (queue.next < queue.len)
+		queue_run_next(&queue);
+	pthread_mutex_unlock(&queue.lock);
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	// Only decode images the caller doesn't have yet, once per file
+	for (i = 0; i < queue.len; i++) {
+		struct load_job *job = &queue.jobs[i];
+		job->done = false;
+		if (!job->opened)
+			continue;
+		job->decode = callbacks->want_images(&job->id, user_data) &&
+			!queue_has_decode(&queue, i, &job->id);
+		if (job->decode)
+			ndecode++;
+	}
+
+	queue.run = load_job_decode;
+	queue.next = 0;
+	nthreads = queue_start_workers(&queue, ndecode, threads);
+
+	pthread_mutex_lock(&queue.lock);
+	for (i = 0; i < queue.len; i++) {
+		struct load_job *job = &queue.jobs[i];
+
+		// Rather than waiting for the workers to get to this job, decode
+		// it, or whatever comes first, ourselves
+		while (!job->done) {
+			if (queue.next < queue.len)
+				queue_run_next(&queue);
+			else
+				pthread_cond_wait(&queue.done_cond, &queue.lock);
+		}
+
+		if (job->opened && (job->images || !job->decode)) {
+			pthread_mutex_unlock(&queue.lock);
+			callbacks->load(job->name, job->images, &job->id,
+					user_data);
+			pthread_mutex_lock(&queue.lock);
+		}
+	}
+	pthread_mutex_unlock(&queue.lock);
+
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (i = 0; i < queue.len; i++) {
+		free(queue.jobs[i].path);
+		free(queue.jobs[i].name);
+	}
+	free(queue.jobs);
+	pthread_cond_destroy(&queue.done_cond);
+	pthread_mutex_destroy(&queue.lock);
+}